@@ -6,14 +6,220 @@ import numpy as np
 import os
 import hashlib
 import random
-from PIL import Image
-from scipy.interpolate import RegularGridInterpolator
+import fcntl
+import contextlib
+import glob
+import psutil
 
-def hash_params(angles, sinoparams, imgparams):
+def hash_params(angles, sinoparams, imgparams, on_the_fly=False, sysmatrix_precision='uint8'):
     hash_input = str(sinoparams) + str(imgparams) + str(np.around(angles, decimals=6))
+    # On-the-fly matrices are stored in a different file than precomputed ones
+    if on_the_fly:
+        hash_input += 'on_the_fly'
+    # uint8 matrices keep the hash they had before the precision was selectable
+    if sysmatrix_precision != 'uint8':
+        hash_input += sysmatrix_precision
     hash_val = hashlib.sha512(hash_input.encode()).hexdigest()
     return hash_val
 
+
+def sysmatrix_views_key(sinoparams, imgparams, on_the_fly=False, sysmatrix_precision='uint8'):
+    """Hash of everything that determines a system matrix except its views.
+
+    System matrices with the same key differ only in their view angles, so the matrix for a subset of the views
+    of another one can be copied from it, see find_sysmatrix_superset().
+    """
+    sinoparams = {key: value for key, value in sinoparams.items() if key != 'N_beta'}
+    hash_input = str(sinoparams) + str(imgparams) + str(on_the_fly) + sysmatrix_precision
+    return hashlib.sha512(hash_input.encode()).hexdigest()
+
+
+def match_views(angles, superset_angles, tolerance=1e-6):
+    """Find each view of angles among superset_angles, up to multiples of 2 pi.
+
+    Returns:
+        ndarray: view_index with angles[i] = superset_angles[view_index[i]] within tolerance, or None if a view is missing.
+    """
+    if len(superset_angles) == 0:
+        return None
+    two_pi = 2 * np.pi
+    superset = np.mod(np.asarray(superset_angles, dtype=np.float64), two_pi)
+    wrapped = np.mod(np.asarray(angles, dtype=np.float64), two_pi)
+
+    # Nearest view on the circle is one of the two neighbors in sorted order
+    order = np.argsort(superset)
+    pos = np.searchsorted(superset[order], wrapped)
+    lower = order[(pos - 1) % len(order)]
+    upper = order[pos % len(order)]
+    dist_lower = np.abs(np.mod(wrapped - superset[lower] + np.pi, two_pi) - np.pi)
+    dist_upper = np.abs(np.mod(wrapped - superset[upper] + np.pi, two_pi) - np.pi)
+    if not np.all(np.minimum(dist_lower, dist_upper) <= tolerance):
+        return None
+    return np.where(dist_lower <= dist_upper, lower, upper)
+
+
+def write_sysmatrix_views(sysmatrix_fname, angles, views_key):
+    """Record the view angles and views key of a system matrix file next to it, for find_sysmatrix_superset()."""
+    views_fname = sysmatrix_fname + '.views.npz'
+    views_fname_tmp = views_fname + '_pid' + str(os.getpid())
+    with open(views_fname_tmp, 'wb') as views_file:
+        np.savez(views_file, angles=np.asarray(angles, dtype=np.float64), views_key=views_key)
+    os.replace(views_fname_tmp, views_fname)
+
+
+def find_sysmatrix_superset(lib_path, angles, views_key):
+    """Find a cached system matrix with the given views key whose views include all views in angles.
+
+    Returns:
+        tuple: (sysmatrix_fname, superset_angles, view_index) as in match_views(), or None if there is no such matrix.
+    """
+    for views_fname in glob.glob(os.path.join(lib_path, 'sysmatrix', '*.sysmatrix.views.npz')):
+        sysmatrix_fname = views_fname[:-len('.views.npz')]
+        try:
+            with np.load(views_fname) as views:
+                if str(views['views_key']) != views_key:
+                    continue
+                superset_angles = views['angles']
+        except (OSError, ValueError, KeyError):
+            continue
+        if not os.path.exists(sysmatrix_fname):
+            continue
+        view_index = match_views(angles, superset_angles)
+        if view_index is not None:
+            return sysmatrix_fname, superset_angles, view_index
+    return None
+
+
+def sysmatrix_memory_budget():
+    """Return the memory budget in bytes for a precomputed system matrix.
+
+    The budget is read from the environment variable ``MBIRCONE_SYSMATRIX_MEMORY_BUDGET`` (in bytes, e.g. ``64e9``).
+    If it is not set, half of the physical memory is used.
+    """
+    budget = os.environ.get('MBIRCONE_SYSMATRIX_MEMORY_BUDGET')
+    if budget is not None:
+        return float(budget)
+    return psutil.virtual_memory().total / 2
+
+
+def sysmatrix_cache_budget():
+    """Return the budget in bytes of the on-disk system matrix cache, or None if the cache is not limited.
+
+    The budget is read from the environment variable ``MBIRCONE_SYSMATRIX_CACHE_BUDGET`` (in bytes, e.g. ``200e9``).
+    """
+    budget = os.environ.get('MBIRCONE_SYSMATRIX_CACHE_BUDGET')
+    if budget is not None:
+        return float(budget)
+    return None
+
+
+def recon_context_memory_budget():
+    """Return the memory budget in bytes for the reconstruction contexts that mace4D keeps between ADMM iterations.
+
+    The budget is read from the environment variable ``MBIRCONE_RECON_CONTEXT_MEMORY_BUDGET`` (in bytes, e.g. ``64e9``).
+    If it is not set, half of the available memory is used.
+    """
+    budget = os.environ.get('MBIRCONE_RECON_CONTEXT_MEMORY_BUDGET')
+    if budget is not None:
+        return float(budget)
+    return psutil.virtual_memory().available / 2
+
+
+def estimate_recon_context_size(sino_shape, image_shape, constant_weights=False):
+    """Estimate the size in bytes of a float32 reconstruction context, without its system matrix.
+
+    The context holds a copy of the weights unless they are constant, the error sinogram, and four images:
+    the reconstruction, its value at the last error sinogram update, the proximal map input and the theta2 cache.
+    The system matrix is memory mapped and shared by the contexts with the same geometry, so it is not included.
+    """
+    num_sino = float(np.prod(sino_shape))
+    num_image = float(np.prod(image_shape))
+    return 4 * num_sino * (1 if constant_weights else 2) + 4 * 4 * num_image
+
+
+def evict_sysmatrix_cache(lib_path, budget, keep=()):
+    """Delete the least recently used system matrices in lib_path until the cache takes at most budget bytes.
+
+    The last use of a matrix is the modification time of its file, which get_sysmatrix_fname_cy() updates on every hit.
+    Matrices in keep, matrices locked because some process uses or builds them, and temporary files of matrices
+    being built are not deleted.
+
+    Returns:
+        float: Size in bytes of the cache afterwards.
+    """
+    entries = []
+    for sysmatrix_fname in glob.glob(os.path.join(lib_path, 'sysmatrix', '*.sysmatrix')):
+        if '_pid' in os.path.basename(sysmatrix_fname):  # being written, see _gen_sysmatrix_fname_tmp()
+            continue
+        try:
+            stat = os.stat(sysmatrix_fname)
+        except FileNotFoundError:
+            continue
+        entries.append((stat.st_mtime, stat.st_size, sysmatrix_fname))
+
+    keep = {os.path.abspath(fname) for fname in keep}
+    cache_size = sum(size for _, size, _ in entries)
+    for _, size, sysmatrix_fname in sorted(entries):
+        if cache_size <= budget:
+            break
+        if os.path.abspath(sysmatrix_fname) in keep:
+            continue
+        try:
+            lock_file = _open_sysmatrix_lock(sysmatrix_fname, fcntl.LOCK_EX | fcntl.LOCK_NB)
+        except BlockingIOError:
+            continue
+        with lock_file:
+            # The views file goes first, so find_sysmatrix_superset() never returns a deleted matrix
+            for fname in (sysmatrix_fname + '.views.npz', sysmatrix_fname, sysmatrix_fname + '.lock'):
+                try:
+                    os.remove(fname)
+                except FileNotFoundError:
+                    pass
+        cache_size -= size
+    return cache_size
+
+
+def estimate_sysmatrix_size(angles, sinoparams, imgparams, sysmatrix_precision='uint8'):
+    """Estimate the size in bytes of the precomputed B matrix and its column descriptors.
+
+    The footprint height is bounded with the largest magnification of a voxel in the image grid,
+    so the estimate is an upper bound. C is much smaller and is not included.
+    """
+    N_x, N_y, N_beta = imgparams['N_x'], imgparams['N_y'], sinoparams['N_beta']
+    Delta_xy = imgparams['Delta_xy']
+
+    # Distance from the source to the voxel closest to it
+    r = np.sqrt(2) / 2 * max(N_x, N_y) * Delta_xy + abs(sinoparams['u_r'])
+    dist_source_voxel = max(-sinoparams['u_s'] - r, Delta_xy)
+    magnification = (sinoparams['u_d0'] - sinoparams['u_s']) / dist_source_voxel
+    i_vstride_max = min(sinoparams['N_dv'], int(np.ceil(magnification * np.sqrt(2) * Delta_xy / sinoparams['Delta_dv'])) + 2)
+
+    # Views 90 degrees apart share one stored footprint on a centered square grid, see computeViewSymmetry() in C
+    N_beta_stored = N_beta
+    is_centered = abs(imgparams['x_0'] + N_x * Delta_xy / 2) <= 1e-3 * Delta_xy and abs(imgparams['y_0'] + N_y * Delta_xy / 2) <= 1e-3 * Delta_xy
+    if N_beta % 4 == 0 and N_beta > 0 and N_x == N_y and is_centered:
+        diff = np.asarray(angles[N_beta // 4:], dtype=np.float64) - np.asarray(angles[:N_beta - N_beta // 4], dtype=np.float64)
+        diff = np.mod(diff + np.pi, 2 * np.pi) - np.pi
+        tolerance = 0.01 / N_x
+        if np.all(np.abs(diff - np.pi / 2) <= tolerance) or np.all(np.abs(diff + np.pi / 2) <= tolerance):
+            N_beta_stored = N_beta // 4
+
+    # B is 1, 2 or 4 bytes per entry, each view of a column has a descriptor of 4 indices {i_vstart, i_vstride, j_u, B offset}
+    # of the narrowest type that holds all of them, see chooseDescriptorType() in C
+    sizeof_B = np.dtype(sysmatrix_precision).itemsize
+    N_u = 4 * np.sqrt(2) * max(N_x, N_y)  # AMATRIX_RHO = 4 samples per voxel across the rotated grid
+    sizeof_descriptor = 4 * _index_type_size(max(sinoparams['N_dv'], N_u, N_beta_stored * i_vstride_max))
+    return N_x * N_y * N_beta_stored * (i_vstride_max * sizeof_B + sizeof_descriptor)
+
+
+def _index_type_size(max_value):
+    """Size in bytes of the narrowest unsigned index type holding max_value."""
+    if max_value <= np.iinfo(np.uint8).max:
+        return 1
+    if max_value <= np.iinfo(np.uint16).max:
+        return 2
+    return 4
+
 def _gen_sysmatrix_fname(lib_path, sysmatrix_name='object'):
     os.makedirs(os.path.join(lib_path, 'sysmatrix'), exist_ok=True)
 
@@ -29,9 +235,49 @@ def _gen_sysmatrix_fname_tmp(lib_path, sysmatrix_name='object'):
 
     return sysmatrix_fname_tmp
 
+def _open_sysmatrix_lock(sysmatrix_fname, operation):
+    """Open the lock file of the system matrix file name sysmatrix_fname and flock it with operation.
+
+    evict_sysmatrix_cache() deletes the lock file together with the matrix, so a lock that was granted on a lock file
+    deleted in the meantime is dropped and taken again on the current one.
+
+    Returns:
+        file: Open lock file, closing it releases the lock.
+    """
+    lock_fname = sysmatrix_fname + '.lock'
+    while True:
+        lock_file = open(lock_fname, 'a')
+        try:
+            fcntl.flock(lock_file, operation)
+            lock_stat = os.fstat(lock_file.fileno())
+            fname_stat = os.stat(lock_fname)
+            if (lock_stat.st_dev, lock_stat.st_ino) == (fname_stat.st_dev, fname_stat.st_ino):
+                return lock_file
+        except FileNotFoundError:
+            pass
+        except BaseException:
+            lock_file.close()
+            raise
+        lock_file.close()
+
+
+@contextlib.contextmanager
+def _sysmatrix_build_lock(sysmatrix_fname):
+    """Hold an exclusive lock on the system matrix file name sysmatrix_fname while the matrix is built.
+
+    Processes on a node that need the same matrix wait for the first one to build it, and then all of them
+    map the finished file read-only and share one copy of it through the page cache.
+    """
+    with _open_sysmatrix_lock(sysmatrix_fname, fcntl.LOCK_EX):
+        yield
+
+
 def recon_resize_2D(recon, output_shape):
     """Resizes a reconstruction by performing 2D resizing along the slices dimension
 
+    Each slice is box averaged if it shrinks along both axes, and bilinearly interpolated otherwise,
+    by the OpenMP resizing kernel of the C extension.
+
     Args:
         recon (ndarray): 3D numpy array containing reconstruction with shape (slices, rows, cols)
         output_shape (tuple): (num_rows, num_cols) shape of resized output
@@ -39,34 +285,58 @@ def recon_resize_2D(recon, output_shape):
     Returns:
         ndarray: 3D numpy array containing interpolated reconstruction with shape (num_slices, num_rows, num_cols).
     """
+    # Imported here since interface_cy_c imports this module
+    import mbircone.interface_cy_c as ci
 
-    recon_resized = np.empty((recon.shape[0],output_shape[0],output_shape[1]), dtype=recon.dtype)
-    for i in range(recon.shape[0]):
-        PIL_image = Image.fromarray(recon[i])
-        PIL_image_resized = PIL_image.resize((output_shape[1],output_shape[0]), resample=Image.Resampling.BILINEAR)
-        recon_resized[i] = np.array(PIL_image_resized)
-
-    return recon_resized
+    return ci.resize_image_cy(recon, (recon.shape[0], output_shape[0], output_shape[1]))
 
 def recon_resize_3D(recon, output_shape):
-    """Resizes a reconstruction by performing 2D resizing along the slices dimension
+    """Resizes a reconstruction by performing 3D resizing
+
+    The reconstruction is box averaged if it shrinks along every axis, and trilinearly interpolated otherwise,
+    with the first and last voxels of the input and output grids aligned along each axis.
+    The resizing is done by an OpenMP kernel of the C extension, without coordinate grids.
 
     Args:
         recon (ndarray): 3D numpy array containing reconstruction with shape (slices, rows, cols)
-        output_shape (tuple): (num_rows, num_cols) shape of resized output
+        output_shape (tuple): (num_slices, num_rows, num_cols) shape of resized output
 
     Returns:
         ndarray: 3D numpy array containing interpolated reconstruction with shape (num_slices, num_rows, num_cols).
     """
+    # Imported here since interface_cy_c imports this module
+    import mbircone.interface_cy_c as ci
+
+    return ci.resize_image_cy(recon, output_shape)
+
+
+def bin_sinoparams_2x(angles, sinoparams, bin_views=True):
+    """Returns the view angles and sinogram parameters of a sinogram binned with binSino2x() in multires3DCone.c.
+
+    Args:
+        angles (ndarray): 1D view angles array in radians
+        sinoparams (dict): Sinogram parameters of the sinogram
+        bin_views (bool, optional): [Default=True] If true, pairs of consecutive views are also binned
+
+    Returns:
+        2-element tuple containing
+
+        - **angles_lr** (*ndarray*): View angles of the binned sinogram
+        - **sinoparams_lr** (*dict*): Sinogram parameters of the binned sinogram
+    """
+    angles_lr = np.asarray(angles, dtype=np.float64)
+    num_views = len(angles_lr)
+    if bin_views and num_views > 1:
+        num_pairs = num_views // 2
+        # Midpoint of each pair, taking the shorter way around the circle
+        diff = np.angle(np.exp(1j * (angles_lr[1:2*num_pairs:2] - angles_lr[:2*num_pairs:2])))
+        angles_lr = np.concatenate((angles_lr[:2*num_pairs:2] + diff / 2, angles_lr[2*num_pairs:]))
+
+    sinoparams_lr = sinoparams.copy()
+    sinoparams_lr['N_beta'] = len(angles_lr)
+    sinoparams_lr['N_dw'] = sinoparams['N_dw'] // 2
+    sinoparams_lr['N_dv'] = sinoparams['N_dv'] // 2
+    sinoparams_lr['Delta_dw'] = 2 * sinoparams['Delta_dw']
+    sinoparams_lr['Delta_dv'] = 2 * sinoparams['Delta_dv']
 
-    Nz_in, Nx_in, Ny_in = recon.shape
-    Nz_out, Nx_out, Ny_out = output_shape
-    # define interp function from the input image
-    zz_in, xx_in, yy_in = np.linspace(0, Nz_in-1, Nz_in), np.linspace(0, Nx_in-1, Nx_in), np.linspace(0, Ny_in-1, Ny_in)
-    interp = RegularGridInterpolator((zz_in, xx_in, yy_in), recon)
-    # define output image grid
-    zz_out, xx_out, yy_out = np.linspace(0, Nz_in-1, Nz_out), np.linspace(0, Nx_in-1, Nx_out), np.linspace(0, Ny_in-1, Ny_out)
-    Z_out, X_out, Y_out = np.meshgrid(zz_out, xx_out, yy_out, indexing='ij')
-    # interpolation
-    recon_interp = interp((Z_out, X_out, Y_out))
-    return recon_interp
+    return angles_lr, sinoparams_lr
@@ -1,12 +1,14 @@
 import math
 from psutil import cpu_count
 import shutil
+import contextlib
 import numpy as np
 import os
 import hashlib
 import mbircone.interface_cy_c as ci
 import random
 import warnings
+import multiprocessing
 import mbircone._utils as _utils
 
 __lib_path = os.path.join(os.path.expanduser('~'), '.cache', 'mbircone')
@@ -85,6 +87,15 @@ def calc_weights(sino, weight_type):
     return weights
 
 
+def _default_weights(sino, weight_type):
+    """Weights used when none are supplied. Same as ``calc_weights``, except that 'unweighted' gives a read-only
+    broadcast scalar, which the C code uses as a constant weight without storing a weight sinogram.
+    """
+    if weight_type == 'unweighted':
+        return np.broadcast_to(np.single(1.0), sino.shape)
+    return calc_weights(sino, weight_type)
+
+
 def auto_max_resolutions(init_image) :
     """Compute the automatic value of ``max_resolutions`` for use in MBIR reconstruction.
 
@@ -308,12 +319,14 @@ def compute_img_params(sinoparams, delta_pixel_image=None, ror_radius=None):
     imgparams['Delta_xy'] = delta_pixel_image
     imgparams['Delta_z'] = delta_pixel_image
 
-    imgparams['x_0'] = -(r + imgparams['Delta_xy'] / 2)
-    imgparams['y_0'] = imgparams['x_0']
-
     imgparams['N_x'] = 2 * math.ceil(r / imgparams['Delta_xy']) + 1
     imgparams['N_y'] = imgparams['N_x']
 
+    # Center the grid on the axis of rotation, so that the center voxel is at (0,0)
+    # and the system matrix can use the symmetry between views 90 degrees apart.
+    imgparams['x_0'] = -imgparams['N_x'] * imgparams['Delta_xy'] / 2
+    imgparams['y_0'] = imgparams['x_0']
+
     ## Computation of z_0 and N_z
 
     x_1 = imgparams['x_0'] + imgparams['N_x'] * imgparams['Delta_xy']
@@ -460,97 +473,27 @@ def extract_roi_from_ror(image, boundary_size):
            img_cols_boundary_size:-img_cols_boundary_size]
 
 
-def recon(sino, angles, dist_source_detector, magnification,
-          channel_offset=0.0, row_offset=0.0, rotation_offset=0.0,
-          delta_pixel_detector=1.0, delta_pixel_image=None, ror_radius=None,
-          init_image=0.0, prox_image=None, max_resolutions=None,
-          sigma_y=None, snr_db=40.0, weights=None, weight_type='unweighted',
-          positivity=True, p=1.2, q=2.0, T=1.0, num_neighbors=6,
-          sharpness=0.0, sigma_x=None, sigma_p=None, max_iterations=100, stop_threshold=0.02,
-          num_threads=None, NHICD=False, verbose=1, lib_path=__lib_path):
-    """Compute 3D cone beam MBIR reconstruction
-    
-    Args:
-        sino (ndarray): 3D sinogram array with shape (num_views, num_det_rows, num_det_channels)
-        angles (ndarray): 1D view angles array in radians.
-        dist_source_detector (float): Distance between the X-ray source and the detector in units of ALU
-        magnification (float): Magnification of the cone-beam geometry defined as (source to detector distance)/(source to center-of-rotation distance).
-        
-        channel_offset (float, optional): [Default=0.0] Distance in :math:`ALU` from center of detector to the source-detector line along a row.
-        row_offset (float, optional): [Default=0.0] Distance in :math:`ALU` from center of detector to the source-detector line along a column.
-        rotation_offset (float, optional): [Default=0.0] Distance in :math:`ALU` from source-detector line to axis of rotation in the object space.
-            This is normally set to zero.
-        
-        delta_pixel_detector (float, optional): [Default=1.0] Scalar value of detector pixel spacing in :math:`ALU`.
-        delta_pixel_image (float, optional): [Default=None] Scalar value of image pixel spacing in :math:`ALU`.
-            If None, automatically set to delta_pixel_detector/magnification  
-        ror_radius (float, optional): [Default=None] Scalar value of radius of reconstruction in :math:`ALU`.
-            If None, automatically set with compute_img_params.
-            Pixels outside the radius ror_radius in the :math:`(x,y)` plane are disregarded in the reconstruction.
-        
-        init_image (ndarray, optional): [Default=0.0] Initial value of reconstruction image, specified by either a scalar value or a 3D numpy array with shape (num_img_slices,num_img_rows,num_img_cols)
-        prox_image (ndarray, optional): [Default=None] 3D proximal map input image. 3D numpy array with shape (num_img_slices,num_img_rows,num_img_cols)
-        max_resolutions (int, optional): [Default=None] Integer >=0 that specifies the maximum number of grid
-            resolutions used to solve MBIR reconstruction problem.
-            If None, automatically set with auto_max_resolutions to 0 if inital image is provided and 2 otherwise.        
-        
-        sigma_y (float, optional): [Default=None] Scalar value of noise standard deviation parameter.
-            If None, automatically set with auto_sigma_y.
-        snr_db (float, optional): [Default=40.0] Scalar value that controls assumed signal-to-noise ratio of the data in dB.
-            Ignored if sigma_y is not None.
-        weights (ndarray, optional): [Default=None] 3D weights array with same shape as sino.
-        weight_type (string, optional): [Default='unweighted'] Type of noise model used for data.
-            If the ``weights`` array is not supplied, then the function ``cone3D.calc_weights`` is used to set weights using specified ``weight_type`` parameter.
-            
-                - Option "unweighted" corresponds to unweighted reconstruction;
-                - Option "transmission" is the correct weighting for transmission CT with constant dosage;
-                - Option "transmission_root" is commonly used with transmission CT data to improve image homogeneity;
-                - Option "emission" is appropriate for emission CT data.
+def _compute_recon_params(sino, dist_source_detector, magnification,
+                          channel_offset=0.0, row_offset=0.0, rotation_offset=0.0,
+                          delta_pixel_detector=1.0, delta_pixel_image=None, ror_radius=None,
+                          prox_mode=False,
+                          sigma_y=None, snr_db=40.0, weights=None, weight_type='unweighted',
+                          positivity=True, p=1.2, q=2.0, T=1.0, num_neighbors=6,
+                          sharpness=0.0, sigma_x=None, sigma_p=None, max_iterations=100, stop_threshold=0.02,
+                          NHICD=False, verbose=1,
+                          weight_precision='float32', error_sino_precision='float32', check_precision=False,
+                          zipline_mode=2, theta2_cache_mode=1):
+    """Compute the parameter dictionaries passed to the Cython interface by ``recon``.
+
+    Arguments are the same as for ``recon``, except that ``prox_mode`` (bool) replaces ``prox_image``.
 
-        positivity (bool, optional): [Default=True] Boolean value that determines if positivity constraint is enforced. 
-            The positivity parameter defaults to True; however, it should be changed to False when used in applications that can generate negative image values.
-        p (float, optional): [Default=1.2] Scalar value in range :math:`[1,2]` that specifies the qGGMRF shape parameter.
-        q (float, optional): [Default=2.0] Scalar value in range :math:`[p,1]` that specifies the qGGMRF shape parameter.
-        T (float, optional): [Default=1.0] Scalar value :math:`>0` that specifies the qGGMRF threshold parameter.
-        num_neighbors (int, optional): [Default=6] Possible values are {26,18,6}.
-            Number of neightbors in the qggmrf neighborhood. Higher number of neighbors result in a better regularization but a slower reconstruction.
-        sharpness (float, optional): [Default=0.0]
-            Scalar value that controls level of sharpness in the reconstruction
-            ``sharpness=0.0`` is neutral; ``sharpness>0`` increases sharpness; ``sharpness<0`` reduces sharpness.
-            Ignored if ``sigma_x`` is not None in qGGMRF mode, or if ``sigma_p`` is not None in proximal map mode.
-        sigma_x (float, optional): [Default=None] Scalar value :math:`>0` that specifies the qGGMRF scale parameter.
-            Ignored if prox_image is not None.
-            If None and prox_image is also None, automatically set with auto_sigma_x. Regularization should be controled with the ``sharpness`` parameter, but ``sigma_x`` can be set directly by expert users.
-        sigma_p (float, optional): [Default=None] Scalar value :math:`>0` that specifies the proximal map parameter.
-            Ignored if prox_image is None.
-            If None and proximal image is not None, automatically set with auto_sigma_p. Regularization should be controled with the ``sharpness`` parameter, but ``sigma_p`` can be set directly by expert users.
-        max_iterations (int, optional): [Default=100] Integer valued specifying the maximum number of iterations.
-        stop_threshold (float, optional): [Default=0.02] Scalar valued stopping threshold in percent.
-            If stop_threshold=0.0, then run max iterations.
-        num_threads (int, optional): [Default=None] Number of compute threads requested when executed.
-            If None, num_threads is set to the number of cores in the system
-        NHICD (bool, optional): [Default=False] If true, uses Non-homogeneous ICD updates
-        verbose (int, optional): [Default=1] Possible values are {0,1,2}, where 0 is quiet, 1 prints minimal reconstruction progress information, and 2 prints the full information.
-        lib_path (str, optional): [Default=~/.cache/mbircone] Path to directory containing library of forward projection matrices.
     Returns:
-        3D numpy array: 3D reconstruction with shape (num_img_slices, num_img_rows, num_img_cols) in units of :math:`ALU^{-1}`.
+        4-element tuple containing:
+        - **sinoparams** (*dict*): Sinogram parameters.
+        - **imgparams** (*dict*): Image parameters.
+        - **reconparams** (*dict*): Reconstruction parameters.
+        - **weights** (*ndarray*): Sinogram weights actually used.
     """
-
-    # Internally set
-    # NHICD_ThresholdAllVoxels_ErrorPercent=80, NHICD_percentage=15, NHICD_random=20, 
-    # zipLineMode=2, N_G=2, numVoxelsPerZiplineMax=200
-
-    if num_threads is None:
-        num_threads = cpu_count(logical=False)
-
-    os.environ['OMP_NUM_THREADS'] = str(num_threads)
-    os.environ['OMP_DYNAMIC'] = 'true'
-    
-    # Set automatic value of max_resolutions
-    if max_resolutions is None :
-        max_resolutions = auto_max_resolutions(init_image)
-    print('max_resolution = ', max_resolutions)
-
     if delta_pixel_image is None:
         delta_pixel_image = delta_pixel_detector / magnification
 
@@ -570,7 +513,7 @@ def recon(sino, angles, dist_source_detector, magnification,
         weights = None
     # Set automatic values for weights
     if weights is None:
-        weights = calc_weights(sino, weight_type)
+        weights = _default_weights(sino, weight_type)
 
     # Set automatic value of sigma_y
     if sigma_y is None:
@@ -629,7 +572,9 @@ def recon(sino, angles, dist_source_detector, magnification,
     reconparams['relativeChangePercentile'] = 99.9
 
     # Zipline
-    reconparams['zipLineMode'] = 2
+    if zipline_mode not in (0, 1, 2, 4):
+        raise ValueError("zipline_mode must be one of [0, 1, 2, 4], got %r" % (zipline_mode,))
+    reconparams['zipLineMode'] = zipline_mode
     reconparams['N_G'] = 2
     reconparams['numVoxelsPerZiplineMax'] = 200
     reconparams['numVoxelsPerZipline'] = 200
@@ -645,7 +590,17 @@ def recon(sino, angles, dist_source_detector, magnification,
     else:
         reconparams['NHICD_Mode'] = 'off'
 
-    if prox_image is None:
+    # Theta2 cache (0: off, 1: filled on first visit of each voxel, 2: precomputed in parallel)
+    if theta2_cache_mode not in (0, 1, 2):
+        raise ValueError("theta2_cache_mode must be one of [0, 1, 2], got %r" % (theta2_cache_mode,))
+    reconparams['theta2CacheMode'] = theta2_cache_mode
+
+    # Storage of the weights and error sinogram (accumulation is always in float32)
+    reconparams['weight_precision'] = weight_precision
+    reconparams['error_sino_precision'] = error_sino_precision
+    reconparams['isCheckSinoPrecision'] = int(check_precision)
+
+    if not prox_mode:
         reconparams['prox_mode'] = False
         reconparams['sigma_lambda'] = 1
     else:
@@ -654,18 +609,195 @@ def recon(sino, angles, dist_source_detector, magnification,
             sigma_p = auto_sigma_p(sino, magnification, delta_pixel_detector, sharpness)
         reconparams['sigma_lambda'] = sigma_p
 
+    return sinoparams, imgparams, reconparams, weights
+
+
+def recon(sino, angles, dist_source_detector, magnification,
+          channel_offset=0.0, row_offset=0.0, rotation_offset=0.0,
+          delta_pixel_detector=1.0, delta_pixel_image=None, ror_radius=None,
+          init_image=0.0, prox_image=None, max_resolutions=None,
+          sigma_y=None, snr_db=40.0, weights=None, weight_type='unweighted',
+          positivity=True, p=1.2, q=2.0, T=1.0, num_neighbors=6,
+          sharpness=0.0, sigma_x=None, sigma_p=None, max_iterations=100, stop_threshold=0.02,
+          num_threads=None, NHICD=False, verbose=1, lib_path=__lib_path, sysmatrix_precision='uint8',
+          weight_precision='float32', error_sino_precision='float32', check_precision=False,
+          zipline_mode=2, theta2_cache_mode=1):
+    """Compute 3D cone beam MBIR reconstruction
+    
+    Args:
+        sino (ndarray): 3D sinogram array with shape (num_views, num_det_rows, num_det_channels)
+        angles (ndarray): 1D view angles array in radians.
+        dist_source_detector (float): Distance between the X-ray source and the detector in units of ALU
+        magnification (float): Magnification of the cone-beam geometry defined as (source to detector distance)/(source to center-of-rotation distance).
+        
+        channel_offset (float, optional): [Default=0.0] Distance in :math:`ALU` from center of detector to the source-detector line along a row.
+        row_offset (float, optional): [Default=0.0] Distance in :math:`ALU` from center of detector to the source-detector line along a column.
+        rotation_offset (float, optional): [Default=0.0] Distance in :math:`ALU` from source-detector line to axis of rotation in the object space.
+            This is normally set to zero.
+        
+        delta_pixel_detector (float, optional): [Default=1.0] Scalar value of detector pixel spacing in :math:`ALU`.
+        delta_pixel_image (float, optional): [Default=None] Scalar value of image pixel spacing in :math:`ALU`.
+            If None, automatically set to delta_pixel_detector/magnification  
+        ror_radius (float, optional): [Default=None] Scalar value of radius of reconstruction in :math:`ALU`.
+            If None, automatically set with compute_img_params.
+            Pixels outside the radius ror_radius in the :math:`(x,y)` plane are disregarded in the reconstruction.
+        
+        init_image (ndarray, optional): [Default=0.0] Initial value of reconstruction image, specified by either a scalar value, a 3D numpy array with shape (num_img_slices,num_img_rows,num_img_cols),
+            or the string 'fdk' to start from a filtered backprojection (FDK) reconstruction of ``sino``.
+        prox_image (ndarray, optional): [Default=None] 3D proximal map input image. 3D numpy array with shape (num_img_slices,num_img_rows,num_img_cols)
+        max_resolutions (int, optional): [Default=None] Integer >=0 that specifies the maximum number of grid
+            resolutions used to solve MBIR reconstruction problem.
+            If None, automatically set with auto_max_resolutions to 0 if inital image is provided and 2 otherwise.        
+        
+        sigma_y (float, optional): [Default=None] Scalar value of noise standard deviation parameter.
+            If None, automatically set with auto_sigma_y.
+        snr_db (float, optional): [Default=40.0] Scalar value that controls assumed signal-to-noise ratio of the data in dB.
+            Ignored if sigma_y is not None.
+        weights (ndarray, optional): [Default=None] 3D weights array with same shape as sino.
+        weight_type (string, optional): [Default='unweighted'] Type of noise model used for data.
+            If the ``weights`` array is not supplied, then the function ``cone3D.calc_weights`` is used to set weights using specified ``weight_type`` parameter.
+            
+                - Option "unweighted" corresponds to unweighted reconstruction;
+                - Option "transmission" is the correct weighting for transmission CT with constant dosage;
+                - Option "transmission_root" is commonly used with transmission CT data to improve image homogeneity;
+                - Option "emission" is appropriate for emission CT data.
+
+        positivity (bool, optional): [Default=True] Boolean value that determines if positivity constraint is enforced. 
+            The positivity parameter defaults to True; however, it should be changed to False when used in applications that can generate negative image values.
+        p (float, optional): [Default=1.2] Scalar value in range :math:`[1,2]` that specifies the qGGMRF shape parameter.
+        q (float, optional): [Default=2.0] Scalar value in range :math:`[p,1]` that specifies the qGGMRF shape parameter.
+        T (float, optional): [Default=1.0] Scalar value :math:`>0` that specifies the qGGMRF threshold parameter.
+        num_neighbors (int, optional): [Default=6] Possible values are {26,18,6}.
+            Number of neightbors in the qggmrf neighborhood. Higher number of neighbors result in a better regularization but a slower reconstruction.
+        sharpness (float, optional): [Default=0.0]
+            Scalar value that controls level of sharpness in the reconstruction
+            ``sharpness=0.0`` is neutral; ``sharpness>0`` increases sharpness; ``sharpness<0`` reduces sharpness.
+            Ignored if ``sigma_x`` is not None in qGGMRF mode, or if ``sigma_p`` is not None in proximal map mode.
+        sigma_x (float, optional): [Default=None] Scalar value :math:`>0` that specifies the qGGMRF scale parameter.
+            Ignored if prox_image is not None.
+            If None and prox_image is also None, automatically set with auto_sigma_x. Regularization should be controled with the ``sharpness`` parameter, but ``sigma_x`` can be set directly by expert users.
+        sigma_p (float, optional): [Default=None] Scalar value :math:`>0` that specifies the proximal map parameter.
+            Ignored if prox_image is None.
+            If None and proximal image is not None, automatically set with auto_sigma_p. Regularization should be controled with the ``sharpness`` parameter, but ``sigma_p`` can be set directly by expert users.
+        max_iterations (int, optional): [Default=100] Integer valued specifying the maximum number of iterations.
+        stop_threshold (float, optional): [Default=0.02] Scalar valued stopping threshold in percent.
+            If stop_threshold=0.0, then run max iterations.
+        num_threads (int, optional): [Default=None] Number of compute threads requested when executed.
+            If None, num_threads is set to the number of cores in the system
+        NHICD (bool, optional): [Default=False] If true, uses Non-homogeneous ICD updates
+        verbose (int, optional): [Default=1] Possible values are {0,1,2}, where 0 is quiet, 1 prints minimal reconstruction progress information, and 2 prints the full information.
+        lib_path (str, optional): [Default=~/.cache/mbircone] Path to directory containing library of forward projection matrices.
+        sysmatrix_precision (str, optional): [Default='uint8'] Possible values are {'uint8', 'uint16', 'float32'}.
+            Data type of the stored system matrix coefficients. 'uint16' and 'float32' are more accurate but need 2 or 4 times the memory for the matrix.
+        weight_precision (str, optional): [Default='float32'] Possible values are {'float32', 'float16', 'uint8'}.
+            Data type of the stored sinogram weights. 'float16' and 'uint8' are scaled per view and need 1/2 or 1/4 of the memory.
+        error_sino_precision (str, optional): [Default='float32'] Possible values are {'float32', 'float16', 'bfloat16'}.
+            Data type of the stored error sinogram. The voxel updates always accumulate in float32; 'float16' and 'bfloat16' halve
+            the memory and bandwidth of the error sinogram at the cost of rounding, 'bfloat16' being the coarser of the two.
+        check_precision (bool, optional): [Default=False] If true, print the relative error of the compact weights and
+            error sinogram against float32. The error sinogram check costs one extra forward projection per resolution.
+        zipline_mode (int, optional): [Default=2] Order of the ICD voxel updates. Possible values are {0, 1, 2, 4}.
+
+                - 0 updates single voxels in random order;
+                - 1 updates ziplines (groups of voxels along z) of each column with a fixed group spacing;
+                - 2 updates randomized ziplines of each column, with the columns in random order;
+                - 4 is as 2, but updates several columns at the same time, one per thread.
+
+        theta2_cache_mode (int, optional): [Default=1] Caching of the voxel-wise second derivative of the forward term. Possible values are {0, 1, 2}.
+            0 recomputes it on every update, 1 computes it on the first update of each voxel, 2 precomputes it for all voxels in parallel before the first iteration.
+    Returns:
+        3D numpy array: 3D reconstruction with shape (num_img_slices, num_img_rows, num_img_cols) in units of :math:`ALU^{-1}`.
+    """
+
+    # Internally set
+    # NHICD_ThresholdAllVoxels_ErrorPercent=80, NHICD_percentage=15, NHICD_random=20, 
+    # N_G=2, numVoxelsPerZiplineMax=200
+
+    if num_threads is None:
+        num_threads = cpu_count(logical=False)
+
+    os.environ['OMP_NUM_THREADS'] = str(num_threads)
+    os.environ['OMP_DYNAMIC'] = 'true'
+    
+    sinoparams, imgparams, reconparams, weights = _compute_recon_params(sino, dist_source_detector, magnification,
+                                                                        channel_offset=channel_offset, row_offset=row_offset, rotation_offset=rotation_offset,
+                                                                        delta_pixel_detector=delta_pixel_detector, delta_pixel_image=delta_pixel_image, ror_radius=ror_radius,
+                                                                        prox_mode=(prox_image is not None),
+                                                                        sigma_y=sigma_y, snr_db=snr_db, weights=weights, weight_type=weight_type,
+                                                                        positivity=positivity, p=p, q=q, T=T, num_neighbors=num_neighbors,
+                                                                        sharpness=sharpness, sigma_x=sigma_x, sigma_p=sigma_p,
+                                                                        max_iterations=max_iterations, stop_threshold=stop_threshold,
+                                                                        NHICD=NHICD, verbose=verbose,
+                                                                        weight_precision=weight_precision, error_sino_precision=error_sino_precision,
+                                                                        check_precision=check_precision,
+                                                                        zipline_mode=zipline_mode, theta2_cache_mode=theta2_cache_mode)
+
+    if isinstance(init_image, str) and (init_image == 'fdk'):
+        init_image = ci.fdk_cy(sino, angles, sinoparams, imgparams, lib_path, sysmatrix_precision=sysmatrix_precision,
+                               verbose=verbose, num_threads=num_threads)
+        if positivity:
+            init_image = np.maximum(init_image, 0)
+
+    # Set automatic value of max_resolutions
+    if max_resolutions is None :
+        max_resolutions = auto_max_resolutions(init_image)
+    print('max_resolution = ', max_resolutions)
+
     x = ci.recon_cy(sino, angles, weights, init_image, prox_image,
                     sinoparams, imgparams, reconparams, max_resolutions,
-                    num_threads, lib_path)
+                    num_threads, lib_path, sysmatrix_precision=sysmatrix_precision)
     return x
 
 
+def _create_recon_context(sino, angles, dist_source_detector, magnification,
+                          channel_offset=0.0, row_offset=0.0, rotation_offset=0.0,
+                          delta_pixel_detector=1.0, delta_pixel_image=None, ror_radius=None,
+                          prox_mode=True,
+                          sigma_y=None, snr_db=40.0, weights=None, weight_type='unweighted',
+                          positivity=True, p=1.2, q=2.0, T=1.0, num_neighbors=6,
+                          sharpness=0.0, sigma_x=None, sigma_p=None, max_iterations=100, stop_threshold=0.02,
+                          num_threads=None, NHICD=False, verbose=1, lib_path=__lib_path, sysmatrix_precision='uint8',
+                          weight_precision='float32', error_sino_precision='float32', check_precision=False,
+                          zipline_mode=2, theta2_cache_mode=1):
+    """Create a reconstruction context for repeated single-resolution reconstructions of the same sinogram.
+
+    The system matrix, sinogram, weights and error sinogram stay resident between calls, which avoids the setup
+    cost of ``recon`` when it is called many times, e.g. for the proximal map in MACE.
+    Arguments are the same as for ``recon``, except that ``prox_mode`` (bool) replaces ``prox_image``.
+
+    Returns:
+        Context object. ``context.recon(init_image, prox_image)`` returns the reconstruction with shape
+        (num_img_slices, num_img_rows, num_img_cols), as ``recon`` would with ``max_resolutions=0``.
+    """
+    if num_threads is None:
+        num_threads = cpu_count(logical=False)
+
+    os.environ['OMP_NUM_THREADS'] = str(num_threads)
+    os.environ['OMP_DYNAMIC'] = 'true'
+
+    sinoparams, imgparams, reconparams, weights = _compute_recon_params(sino, dist_source_detector, magnification,
+                                                                        channel_offset=channel_offset, row_offset=row_offset, rotation_offset=rotation_offset,
+                                                                        delta_pixel_detector=delta_pixel_detector, delta_pixel_image=delta_pixel_image, ror_radius=ror_radius,
+                                                                        prox_mode=prox_mode,
+                                                                        sigma_y=sigma_y, snr_db=snr_db, weights=weights, weight_type=weight_type,
+                                                                        positivity=positivity, p=p, q=q, T=T, num_neighbors=num_neighbors,
+                                                                        sharpness=sharpness, sigma_x=sigma_x, sigma_p=sigma_p,
+                                                                        max_iterations=max_iterations, stop_threshold=stop_threshold,
+                                                                        NHICD=NHICD, verbose=verbose,
+                                                                        weight_precision=weight_precision, error_sino_precision=error_sino_precision,
+                                                                        check_precision=check_precision,
+                                                                        zipline_mode=zipline_mode, theta2_cache_mode=theta2_cache_mode)
+
+    return ci.ReconContext_cy(sino, angles, weights, sinoparams, imgparams, reconparams, num_threads, lib_path,
+                              sysmatrix_precision=sysmatrix_precision)
+
+
 def project(image, angles,
             num_det_rows, num_det_channels,
             dist_source_detector, magnification,
             channel_offset=0.0, row_offset=0.0, rotation_offset=0.0,
             delta_pixel_detector=1.0, delta_pixel_image=None, ror_radius=None,
-            num_threads=None, verbose=1, lib_path=__lib_path):
+            num_threads=None, verbose=1, lib_path=__lib_path, sysmatrix_precision='uint8'):
     """Compute 3D cone beam forward-projection.
     
     Args:
@@ -696,6 +828,8 @@ def project(image, angles,
             If None, num_threads is set to the number of cores in the system
         verbose (int, optional): [Default=1] Possible values are {0,1,2}, where 0 is quiet, 1 prints minimal reconstruction progress information, and 2 prints the full information.
         lib_path (str, optional): [Default=~/.cache/mbircone] Path to directory containing library of forward projection matrices.
+        sysmatrix_precision (str, optional): [Default='uint8'] Possible values are {'uint8', 'uint16', 'float32'}.
+            Data type of the stored system matrix coefficients. 'uint16' and 'float32' are more accurate but need 2 or 4 times the memory for the matrix.
     Returns:
         ndarray: 3D numpy array containing sinogram with shape (num_views, num_det_rows, num_det_channels).
     """
@@ -725,22 +859,157 @@ def project(image, angles,
         'Image size of %s is incorrect! With the specified geometric parameters, expected image should have shape %s, use function `cone3D.compute_img_size` to compute the correct image size.' \
         %  ((num_img_slices, num_img_rows, num_img_cols), (imgparams['N_z'], imgparams['N_x'], imgparams['N_y']))
 
-    hash_val = _utils.hash_params(angles, sinoparams, imgparams)
-    sysmatrix_fname = _utils._gen_sysmatrix_fname(lib_path=lib_path, sysmatrix_name=hash_val[:__namelen_sysmatrix])
+    # The system matrix stays locked against cache eviction until the projection is done
+    with contextlib.ExitStack() as sysmatrix_locks:
+        sysmatrix_fname = ci.get_sysmatrix_fname_cy(angles, sinoparams, imgparams, lib_path, sysmatrix_precision=sysmatrix_precision,
+                                                    verbose=verbose, num_threads=num_threads, sysmatrix_locks=sysmatrix_locks)
 
-    if os.path.exists(sysmatrix_fname):
-        os.utime(sysmatrix_fname)  # update file modified time
-    else:
-        sysmatrix_fname_tmp = _utils._gen_sysmatrix_fname_tmp(lib_path=lib_path, sysmatrix_name=hash_val[:__namelen_sysmatrix])
-        ci.AmatrixComputeToFile_cy(angles, sinoparams, imgparams, sysmatrix_fname_tmp, verbose=verbose)
-        os.rename(sysmatrix_fname_tmp, sysmatrix_fname)
-
-    # Collect settings to pass to C
-    settings = dict()
-    settings['imgparams'] = imgparams
-    settings['sinoparams'] = sinoparams
-    settings['sysmatrix_fname'] = sysmatrix_fname
-    settings['num_threads'] = num_threads
-
-    proj = ci.project(image, settings)
+        # Collect settings to pass to C
+        settings = dict()
+        settings['imgparams'] = imgparams
+        settings['sinoparams'] = sinoparams
+        settings['sysmatrix_fname'] = sysmatrix_fname
+        settings['num_threads'] = num_threads
+
+        proj = ci.project(image, settings)
     return proj
+
+
+def backproject(sino, angles, dist_source_detector, magnification,
+                channel_offset=0.0, row_offset=0.0, rotation_offset=0.0,
+                delta_pixel_detector=1.0, delta_pixel_image=None, ror_radius=None,
+                mode='backprojection', num_threads=None, verbose=1, lib_path=__lib_path, sysmatrix_precision='uint8'):
+    """Compute 3D cone beam back-projection, i.e. the adjoint :math:`A^T` of ``project``.
+
+    Args:
+        sino (ndarray):
+            3D numpy array of sinogram data with shape (num_views, num_det_rows, num_det_channels).
+        angles (ndarray): 1D view angles array in radians.
+
+        dist_source_detector (float): Distance between the X-ray source and the detector in units of ALU
+        magnification (float): Magnification of the cone-beam geometry defined as (source to detector distance)/(source to center-of-rotation distance).
+
+        channel_offset (float, optional): [Default=0.0] Distance in :math:`ALU` from center of detector to the source-detector line along a row.
+        row_offset (float, optional): [Default=0.0] Distance in :math:`ALU` from center of detector to the source-detector line along a column.
+        rotation_offset (float, optional): [Default=0.0] Distance in :math:`ALU` from source-detector line to axis of rotation in the object space.
+            This is normally set to zero.
+
+        delta_pixel_detector (float, optional): [Default=1.0] Scalar value of detector pixel spacing in :math:`ALU`.
+        delta_pixel_image (float, optional): [Default=None] Scalar value of image pixel spacing in :math:`ALU`.
+            If None, automatically set to delta_pixel_detector/magnification
+        ror_radius (float, optional): [Default=None] Scalar value of radius of reconstruction in :math:`ALU`.
+            If None, automatically set with compute_img_params.
+            Pixels outside the radius ror_radius in the :math:`(x,y)` plane are set to zero.
+
+        mode (str, optional): [Default='backprojection'] Possible values are {'backprojection', 'kappa', 'entropy'}.
+            'backprojection' computes :math:`A^T y`, 'kappa' computes :math:`(A \\odot A)^T y`,
+            and 'entropy' computes, for each voxel, the entropy in bits of the distribution :math:`A_{ij} y_i` over the sinogram entries.
+        num_threads (int, optional): [Default=None] Number of compute threads requested when executed.
+            If None, num_threads is set to the number of cores in the system
+        verbose (int, optional): [Default=1] Possible values are {0,1,2}, where 0 is quiet, 1 prints minimal reconstruction progress information, and 2 prints the full information.
+        lib_path (str, optional): [Default=~/.cache/mbircone] Path to directory containing library of forward projection matrices.
+        sysmatrix_precision (str, optional): [Default='uint8'] Possible values are {'uint8', 'uint16', 'float32'}.
+            Data type of the stored system matrix coefficients. 'uint16' and 'float32' are more accurate but need 2 or 4 times the memory for the matrix.
+    Returns:
+        ndarray: 3D numpy array containing the back-projection with shape (num_img_slices, num_img_rows, num_img_cols).
+    """
+
+    modes = {'backprojection': 0, 'entropy': 1, 'kappa': 2}
+    if mode not in modes:
+        raise ValueError("mode must be one of %s, got '%s'" % (list(modes.keys()), mode))
+
+    if num_threads is None:
+        num_threads = cpu_count(logical=False)
+
+    os.environ['OMP_NUM_THREADS'] = str(num_threads)
+    os.environ['OMP_DYNAMIC'] = 'true'
+
+    if delta_pixel_image is None:
+        delta_pixel_image = delta_pixel_detector / magnification
+
+    (num_views, num_det_rows, num_det_channels) = sino.shape
+
+    sinoparams = compute_sino_params(dist_source_detector, magnification,
+                                     num_views=num_views, num_det_rows=num_det_rows, num_det_channels=num_det_channels,
+                                     channel_offset=channel_offset, row_offset=row_offset,
+                                     rotation_offset=rotation_offset,
+                                     delta_pixel_detector=delta_pixel_detector)
+
+    imgparams = compute_img_params(sinoparams, delta_pixel_image=delta_pixel_image, ror_radius=ror_radius)
+
+    # The system matrix stays locked against cache eviction until the back projection is done
+    with contextlib.ExitStack() as sysmatrix_locks:
+        # Collect settings to pass to C
+        settings = dict()
+        settings['imgparams'] = imgparams
+        settings['sinoparams'] = sinoparams
+        settings['sysmatrix_fname'] = ci.get_sysmatrix_fname_cy(angles, sinoparams, imgparams, lib_path, sysmatrix_precision=sysmatrix_precision,
+                                                                verbose=verbose, num_threads=num_threads, sysmatrix_locks=sysmatrix_locks)
+        settings['num_threads'] = num_threads
+        settings['mode'] = modes[mode]
+
+        return ci.backproject(sino, settings)
+
+
+def manage_sysmatrix_cache(budget=None, lib_path=__lib_path):
+    """Delete the least recently used system matrices in the cache until it takes at most budget bytes.
+
+    Matrices are also evicted automatically whenever a new one is added, if the environment variable
+    ``MBIRCONE_SYSMATRIX_CACHE_BUDGET`` is set (in bytes, e.g. ``200e9``).
+
+    Args:
+        budget (float, optional): [Default=None] Size of the cache in bytes.
+            If None, the value of ``MBIRCONE_SYSMATRIX_CACHE_BUDGET`` is used, and nothing is deleted if it is not set.
+        lib_path (str, optional): [Default=~/.cache/mbircone] Path to directory containing library of forward projection matrices.
+
+    Returns:
+        float: Size in bytes of the system matrix cache afterwards.
+    """
+    if budget is None:
+        budget = _utils.sysmatrix_cache_budget()
+    if budget is None:
+        budget = np.inf
+    return _utils.evict_sysmatrix_cache(lib_path, budget)
+
+
+def _prewarm_sysmatrix_worker(geometries, num_threads, verbose, lib_path, sysmatrix_precision):
+    os.environ['OMP_NUM_THREADS'] = str(num_threads)
+    for geometry in geometries:
+        geometry = dict(geometry)
+        angles = geometry.pop('angles')
+        delta_pixel_image = geometry.pop('delta_pixel_image', None)
+        ror_radius = geometry.pop('ror_radius', None)
+        sinoparams = compute_sino_params(num_views=len(angles), **geometry)
+        if delta_pixel_image is None:
+            delta_pixel_image = sinoparams['Delta_dv'] / geometry['magnification']
+        imgparams = compute_img_params(sinoparams, delta_pixel_image=delta_pixel_image, ror_radius=ror_radius)
+        ci.get_sysmatrix_fname_cy(angles, sinoparams, imgparams, lib_path, sysmatrix_precision=sysmatrix_precision,
+                                  verbose=verbose, num_threads=num_threads)
+
+
+def prewarm_sysmatrix(geometries, num_threads=1, verbose=0, lib_path=__lib_path, sysmatrix_precision='uint8'):
+    """Compute the system matrices of upcoming scans in a background process, while the current job runs.
+
+    A later call of project, backproject or recon with the same geometry finds the matrix in the cache.
+    If it needs the matrix before the background process has finished it, it waits for it instead of computing it again.
+    Only the full resolution matrix of recon is computed; the coarser multiresolution levels are computed when they are used.
+
+    Args:
+        geometries (list of dict): Geometry of each scan as keyword arguments of project without image:
+            angles, num_det_rows, num_det_channels, dist_source_detector, magnification and optionally
+            channel_offset, row_offset, rotation_offset, delta_pixel_detector, delta_pixel_image and ror_radius.
+        num_threads (int, optional): [Default=1] Number of compute threads of the background process.
+        verbose (int, optional): [Default=0] Possible values are {0,1,2}, where 0 is quiet.
+        lib_path (str, optional): [Default=~/.cache/mbircone] Path to directory containing library of forward projection matrices.
+        sysmatrix_precision (str, optional): [Default='uint8'] Possible values are {'uint8', 'uint16', 'float32'}.
+            Data type of the stored system matrix coefficients.
+
+    Returns:
+        multiprocessing.Process: The started background process. Call its join() method to wait until all matrices are computed.
+            If this process exits first, it waits for the background process at exit.
+    """
+    # A spawned process does not inherit the OpenMP thread pool of this one
+    process = multiprocessing.get_context('spawn').Process(target=_prewarm_sysmatrix_worker,
+                                                           args=(list(geometries), num_threads, verbose, lib_path, sysmatrix_precision))
+    process.start()
+    return process
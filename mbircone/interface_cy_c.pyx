@@ -1,17 +1,33 @@
 
 import numpy as np
 import os
+import contextlib
+import fcntl
 import ctypes           # Import python package required to use cython
 cimport cython          # Import cython package
 cimport numpy as cnp    # Import specialized cython support for numpy
 cimport openmp
 from libc.string cimport memset,strcpy
+from libc.stdlib cimport malloc,free
 import mbircone._utils as _utils
 
+cnp.import_array()
+
 __namelen_sysmatrix = 20
+# Coefficient types of the system matrix, see COEFF_TYPE_* in MBIRModularUtilities3D.h
+__sysmatrix_precision_types = {'uint8': 0, 'uint16': 1, 'float32': 2}
+__weight_precision_types = {'uint8': 0, 'float32': 2, 'float16': 3}
+__error_sino_precision_types = {'float32': 2, 'float16': 3, 'bfloat16': 4}
+# Axes of the python arrays that index the C arrays image[N_x][N_y][N_z] and sino[N_beta][N_dv][N_dw]
+_IMAGE_AXES = (2, 1, 0)
+_SINO_AXES = (0, 2, 1)
 
 # Import c data structure
 cdef extern from "./src/MBIRModularUtilities3D.h":
+
+    struct FloatArray3DView:
+        float *data
+        long int stride[3]
      
     struct SinoParams:
     
@@ -89,7 +105,7 @@ cdef extern from "./src/MBIRModularUtilities3D.h":
          # Zipline Stuff
 
         int N_G;                # Number of groups for group ICD 
-        int zipLineMode;                # Zipline mode: (0: off, 1: conventional Zipline, 2: randomized Zipline) 
+        int zipLineMode;                # Zipline mode: (0: off, 1: conventional Zipline, 2: randomized Zipline, 4: randomized Zipline over several columns in parallel) 
         int numVoxelsPerZiplineMax;
         int numVoxelsPerZipline;
         int numZiplines;
@@ -111,20 +127,61 @@ cdef extern from "./src/MBIRModularUtilities3D.h":
         int verbosity;
         int isComputeCost;
 
+        # Theta2 cache
+        int theta2CacheMode;
+
+        # Sinogram storage
+        int weightType;                 # Stored weights: (0: uint8, 2: float32, 3: float16)
+        int errorSinoType;              # Stored error sinogram: (2: float32, 3: float16, 4: bfloat16)
+        int isCheckSinoPrecision;       # Report the error of the compact weights and error sinogram against float32
+
 
 # Import a c function to compute A matrix.
-cdef extern from "./src/interface.h":
+# The functions only use their arguments and the calling thread's OpenMP settings, so they are called without the GIL.
+cdef extern from "./src/interface.h" nogil:
     void AmatrixComputeToFile(float *angles, SinoParams c_sinoparams, ImageParams c_imgparams, 
+        char *Amatrix_fname, char isOnTheFly, int B_type, int C_type, char verbose);
+
+    void AmatrixSubsetToFile(char *superset_fname, long int *viewIndex,
+        SinoParams supersetSinoParams, SinoParams sinoParams, ImageParams imgParams,
         char *Amatrix_fname, char verbose);
 
-    void recon(float *x, float *sino, float *wght, float *proxmap_input,
+    void recon(FloatArray3DView x, FloatArray3DView x_init, FloatArray3DView sino, FloatArray3DView wght,
+    FloatArray3DView proxmap_input,
     SinoParams c_sinoparams, ImageParams c_imgparams, ReconParams c_reconparams,
     char *Amatrix_fname);
 
-    void forwardProject(float *y, float *x, 
+    void multiresRecon(FloatArray3DView x, FloatArray3DView x_init, FloatArray3DView y, FloatArray3DView wght,
+    FloatArray3DView proxmap_input,
+    int numLevels, SinoParams *sinoParams, ImageParams *imgParams, ReconParams *reconParams,
+    char *binViews, char **Amatrix_fnames)
+
+    void forwardProject(FloatArray3DView y, FloatArray3DView x, 
     SinoParams sinoParams, ImageParams imgparams, 
     char *Amatrix_fname)
 
+    void backProject(FloatArray3DView x, FloatArray3DView y, 
+    SinoParams sinoParams, ImageParams imgparams, 
+    char *Amatrix_fname, char mode)
+
+    void fdkRecon(FloatArray3DView x, FloatArray3DView y, 
+    SinoParams sinoParams, ImageParams imgparams, 
+    char *Amatrix_fname)
+
+    struct ReconContext:
+        pass
+
+    ReconContext *createReconContext(FloatArray3DView y, FloatArray3DView wght,
+    SinoParams sinoParams, ImageParams imgParams, ReconParams reconParams,
+    char *Amatrix_fname)
+
+    void reconWithContext(ReconContext *ctx, FloatArray3DView x, FloatArray3DView x_init, FloatArray3DView proxmap_input)
+
+    void destroyReconContext(ReconContext *ctx)
+
+    void resizeImage(FloatArray3DView out, FloatArray3DView image,
+    long int N_0_out, long int N_1_out, long int N_2_out, long int N_0_in, long int N_1_in, long int N_2_in)
+
 
 cdef convert_py2c_SinoParams3D(SinoParams* c_sinoparams, sinoparams):
     
@@ -200,7 +257,7 @@ cdef map_py2c_reconparams(ReconParams* c_reconparams,
          # Zipline Stuff
 
         c_reconparams.N_G = reconparams['N_G']                # Number of groups for group ICD
-        c_reconparams.zipLineMode = reconparams['zipLineMode']                # Zipline mode: (0: off, 1: conventional Zipline, 2: randomized Zipline)
+        c_reconparams.zipLineMode = reconparams['zipLineMode']                # Zipline mode: (0: off, 1: conventional Zipline, 2: randomized Zipline, 4: randomized Zipline over several columns in parallel)
         c_reconparams.numVoxelsPerZiplineMax = reconparams['numVoxelsPerZiplineMax']
         c_reconparams.numVoxelsPerZipline = reconparams['numVoxelsPerZipline']
         c_reconparams.numZiplines = reconparams['numZiplines']
@@ -227,6 +284,63 @@ cdef map_py2c_reconparams(ReconParams* c_reconparams,
         c_reconparams.verbosity = reconparams['verbosity']
         c_reconparams.isComputeCost = reconparams['isComputeCost']
 
+        # Theta2 cache
+        c_reconparams.theta2CacheMode = reconparams['theta2CacheMode']
+
+        # Sinogram storage
+        if reconparams['weight_precision'] not in __weight_precision_types:
+            raise ValueError(f"weight_precision must be one of {list(__weight_precision_types)}, got {reconparams['weight_precision']!r}.")
+        if reconparams['error_sino_precision'] not in __error_sino_precision_types:
+            raise ValueError(f"error_sino_precision must be one of {list(__error_sino_precision_types)}, got {reconparams['error_sino_precision']!r}.")
+        c_reconparams.weightType = __weight_precision_types[reconparams['weight_precision']]
+        c_reconparams.errorSinoType = __error_sino_precision_types[reconparams['error_sino_precision']]
+        c_reconparams.isCheckSinoPrecision = reconparams['isCheckSinoPrecision']
+
+
+
+cdef inline void set_num_threads(int num_threads) nogil:
+    """Set the number of OpenMP threads for the C calls of the calling thread. num_threads <= 0 keeps the current number.
+
+    The OpenMP thread count is a per thread setting, so calls from different Python threads can use different counts.
+    """
+    if num_threads > 0:
+        openmp.omp_set_num_threads(num_threads)
+
+
+def as_float_array(arr, shape, name):
+    """Return arr as a float32 array of the given shape that float_array_view() can pass to C, copying only if needed.
+
+    A scalar gives a read-only array with all elements equal to it, without allocating the array.
+    C sees such broadcast arrays as constant, which for the weights avoids storing a weight sinogram.
+    """
+    if np.isscalar(arr):
+        return np.broadcast_to(np.single(arr), shape)
+    arr = np.asarray(arr, dtype=np.single)
+    if arr.shape != tuple(shape):
+        raise ValueError(f'{name} must have shape {tuple(shape)}, got {arr.shape}.')
+    if not arr.flags['ALIGNED']:
+        arr = np.ascontiguousarray(arr)
+    return arr
+
+
+cdef FloatArray3DView float_array_view(arr, axes):
+    """View of the float32 array arr as the C array indexed by its axes in the order axes, see struct FloatArray3DView.
+
+    None gives a view with data NULL. arr must stay alive while the view is used.
+    """
+    cdef FloatArray3DView view
+    cdef cnp.ndarray c_arr
+    cdef int i
+    view.data = NULL
+    for i in range(3):
+        view.stride[i] = 0
+    if arr is None:
+        return view
+    c_arr = arr
+    view.data = <float *> cnp.PyArray_DATA(c_arr)
+    for i in range(3):
+        view.stride[i] = c_arr.strides[axes[i]] // c_arr.itemsize
+    return view
 
 
 def string_to_char_array(input_str):
@@ -248,7 +362,8 @@ def string_to_char_array(input_str):
     return output_char_array
 
 
-def AmatrixComputeToFile_cy(angles, sinoparams, imgparams, Amatrix_fname, verbose=1):
+def AmatrixComputeToFile_cy(angles, sinoparams, imgparams, Amatrix_fname, on_the_fly=False, sysmatrix_precision='uint8',
+                            verbose=1, num_threads=None):
 
     # Declare image and sinogram Parameter structures
     cdef SinoParams c_sinoparams
@@ -264,129 +379,355 @@ def AmatrixComputeToFile_cy(angles, sinoparams, imgparams, Amatrix_fname, verbos
 
     c_Amatrix_fname = string_to_char_array(Amatrix_fname)
 
-    AmatrixComputeToFile(&c_angles[0], c_sinoparams, c_imgparams, &c_Amatrix_fname[0], verbose)
+    # System matrix computation is split across num_threads OpenMP threads
+    cdef int c_num_threads = num_threads if num_threads is not None else 0
+    # B and C are stored with the same coefficient type
+    cdef int coeff_type = __sysmatrix_precision_types[sysmatrix_precision]
+    cdef char c_on_the_fly = on_the_fly
+    cdef char c_verbose = verbose
+    cdef float *c_angles_ptr = &c_angles[0]
+    cdef char *c_Amatrix_fname_ptr = &c_Amatrix_fname[0]
+    with nogil:
+        set_num_threads(c_num_threads)
+        AmatrixComputeToFile(c_angles_ptr, c_sinoparams, c_imgparams, c_Amatrix_fname_ptr, c_on_the_fly, coeff_type, coeff_type, c_verbose)
 
 
-def recon_cy(sino, angles, wght, x_init, proxmap_input,
-             sinoparams, imgparams, reconparams, max_resolutions, 
-             num_threads, lib_path):
-    # sino, wght shape : views x slices x channels
-    # recon shape: N_x N_y N_z (source-detector-line, channels, slices)
+def AmatrixSubsetToFile_cy(superset_fname, superset_angles, view_index, sinoparams, imgparams, Amatrix_fname,
+                           verbose=1, num_threads=None):
+    """Write the system matrix of the views view_index of the system matrix in superset_fname, without recomputing it.
 
-    # Declare cython image array here so we can initialize in recursion block
-    cdef cnp.ndarray[float, ndim=3, mode="c"] py_image
+    superset_angles are the view angles of the superset matrix, sinoparams and imgparams describe the subset.
+    """
+    cdef SinoParams c_superset_sinoparams
+    cdef SinoParams c_sinoparams
+    cdef ImageParams c_imgparams
+    cdef cnp.ndarray[long, ndim=1, mode="c"] c_view_index = np.ascontiguousarray(view_index, dtype=ctypes.c_long)
+    cdef cnp.ndarray[char, ndim=1, mode="c"] c_superset_fname = string_to_char_array(superset_fname)
+    cdef cnp.ndarray[char, ndim=1, mode="c"] c_Amatrix_fname = string_to_char_array(Amatrix_fname)
 
-    # Determine if it the algorithm should reduce resolution further
-    go_to_lower_resolution = (max_resolutions > 0) and (min(imgparams['N_x'], imgparams['N_y'], imgparams['N_z']) > 16)
-    
-    imgparams_lr = imgparams.copy()
-    reconparams_lr = reconparams.copy()
-    # go to lower resolution if possible
-    if go_to_lower_resolution:
-        new_max_resolutions = max_resolutions-1;
-        # Set the pixel pitch, num_rows, and num_cols for the next lower resolution
-        imgparams_lr['Delta_xy'] = 2 * imgparams['Delta_xy']
-        imgparams_lr['Delta_z'] = 2 * imgparams['Delta_z']
-        imgparams_lr['N_x'] = int(np.ceil(imgparams['N_x'] / 2))
-        imgparams_lr['N_y'] = int(np.ceil(imgparams['N_y'] / 2))
-        imgparams_lr['N_z'] = int(np.ceil(imgparams['N_z'] / 2))
-        imgparams_lr['j_xstart_roi'] = int(np.floor(imgparams['j_xstart_roi'] / 2))
-        imgparams_lr['j_xstop_roi'] = int(np.ceil(imgparams['j_xstop_roi'] / 2))
-        imgparams_lr['j_ystart_roi'] = int(np.floor(imgparams['j_ystart_roi'] / 2))
-        imgparams_lr['j_ystop_roi'] = int(np.ceil(imgparams['j_ystop_roi'] / 2))
-        imgparams_lr['j_zstart_roi'] = int(np.floor(imgparams['j_zstart_roi'] / 2))
-        imgparams_lr['j_zstop_roi'] = int(np.ceil(imgparams['j_zstop_roi'] / 2))
-        # Rescale sigma_y for lower resolution
-        reconparams_lr['weightScaler_value'] = 2.0 * reconparams['weightScaler_value']
-        # Reduce resolution of initialization image if there is one
-        if isinstance(x_init, np.ndarray) and (x_init.ndim == 3):
-            lr_init_image = _utils.recon_resize_3D(x_init, (imgparams_lr['N_z'], imgparams_lr['N_x'], imgparams_lr['N_y']))
-        else:
-            lr_init_image = x_init
-        # Reduce resolution of proximal image if there is one
-        if isinstance(proxmap_input, np.ndarray) and (proxmap_input.ndim == 3):
-            lr_prox_image = _utils.recon_resize_3D(proxmap_input, (imgparams_lr['N_z'], imgparams_lr['N_x'], imgparams_lr['N_y']))
-        else:
-            lr_prox_image = proxmap_input
-        
-        if reconparams['verbosity'] >= 1:
-            lr_num_slices, lr_num_rows, lr_num_cols = imgparams_lr['N_z'], imgparams_lr['N_x'], imgparams_lr['N_y']
-            print(f'Calling multires_recon for reconstruction size (slices, rows, cols)=({lr_num_slices}, {lr_num_rows},{lr_num_cols}).')
-        
-        lr_recon = recon_cy(sino, angles, wght, x_init, proxmap_input,
-                            sinoparams, imgparams_lr, reconparams_lr, new_max_resolutions, 
-                            num_threads, lib_path)
-        
-        # Interpolate resolution of reconstruction
-        x_init = _utils.recon_resize_3D(lr_recon, (imgparams['N_z'], imgparams['N_x'], imgparams['N_y']))
-        del lr_recon
+    convert_py2c_SinoParams3D(&c_superset_sinoparams, dict(sinoparams, N_beta=len(superset_angles)))
+    convert_py2c_SinoParams3D(&c_sinoparams, sinoparams)
+    convert_py2c_ImageParams3D(&c_imgparams, imgparams)
 
-    hash_val = _utils.hash_params(angles, sinoparams, imgparams)
+    cdef int c_num_threads = num_threads if num_threads is not None else 0
+    cdef char c_verbose = verbose
+    cdef char *c_superset_fname_ptr = &c_superset_fname[0]
+    cdef long *c_view_index_ptr = &c_view_index[0]
+    cdef char *c_Amatrix_fname_ptr = &c_Amatrix_fname[0]
+    with nogil:
+        set_num_threads(c_num_threads)
+        AmatrixSubsetToFile(c_superset_fname_ptr, c_view_index_ptr, c_superset_sinoparams, c_sinoparams, c_imgparams,
+                            c_Amatrix_fname_ptr, c_verbose)
+
+
+def get_sysmatrix_fname_cy(angles, sinoparams, imgparams, lib_path, sysmatrix_precision='uint8', verbose=1, num_threads=None,
+                           sysmatrix_locks=None):
+    """Return the file name of the system matrix in lib_path, computing the system matrix first if it is not there yet.
+
+    If the estimated size of the precomputed matrix exceeds _utils.sysmatrix_memory_budget(), an on-the-fly matrix is used,
+    which stores only C and computes B during projection and reconstruction.
+    sysmatrix_precision is the coefficient type of B and C, one of 'uint8', 'uint16' and 'float32'.
+
+    The file is keyed by _utils.hash_params(), so processes on one node with the same geometry use the same file.
+    It is memory mapped read-only by the C code, so they share one resident copy of the matrix.
+    If a cached matrix with the same geometry has all the views in angles, the matrix is copied from its views.
+    After a new matrix is added, least recently used matrices are deleted to keep the cache within _utils.sysmatrix_cache_budget().
+
+    A shared lock on the matrix keeps _utils.evict_sysmatrix_cache() from deleting it while it is in use.
+    If sysmatrix_locks (contextlib.ExitStack) is given, the lock is entered into it and held until the stack is closed,
+    otherwise it is released on return.
+    """
+    if sysmatrix_precision not in __sysmatrix_precision_types:
+        raise ValueError(f'sysmatrix_precision must be one of {list(__sysmatrix_precision_types)}, got {sysmatrix_precision!r}.')
+    on_the_fly = _utils.estimate_sysmatrix_size(angles, sinoparams, imgparams, sysmatrix_precision) > _utils.sysmatrix_memory_budget()
+    if on_the_fly and verbose >= 1:
+        print('System matrix exceeds the memory budget, computing it on the fly.')
+    hash_val = _utils.hash_params(angles, sinoparams, imgparams, on_the_fly=on_the_fly, sysmatrix_precision=sysmatrix_precision)
     py_Amatrix_fname = _utils._gen_sysmatrix_fname(lib_path=lib_path, sysmatrix_name=hash_val[:__namelen_sysmatrix])
 
-    if os.path.exists(py_Amatrix_fname):
-        os.utime(py_Amatrix_fname)  # update file modified time
+    while True:
+        lock_file = _utils._open_sysmatrix_lock(py_Amatrix_fname, fcntl.LOCK_SH)
+        try:
+            os.utime(py_Amatrix_fname)  # update file modified time
+            break
+        except FileNotFoundError:
+            lock_file.close()
+        # Only one process builds a missing matrix, the others wait for it and then map the same file
+        with _utils._sysmatrix_build_lock(py_Amatrix_fname):
+            if not os.path.exists(py_Amatrix_fname):
+                _build_sysmatrix_file(angles, sinoparams, imgparams, lib_path, py_Amatrix_fname, hash_val, on_the_fly,
+                                      sysmatrix_precision, verbose, num_threads)
+
+    if sysmatrix_locks is not None:
+        sysmatrix_locks.enter_context(lock_file)
     else:
-        py_Amatrix_fname_tmp = _utils._gen_sysmatrix_fname_tmp(lib_path=lib_path, sysmatrix_name=hash_val[:__namelen_sysmatrix])
-        AmatrixComputeToFile_cy(angles, sinoparams, imgparams, py_Amatrix_fname_tmp, verbose=reconparams['verbosity'])
-        os.rename(py_Amatrix_fname_tmp, py_Amatrix_fname)
+        lock_file.close()
+    return py_Amatrix_fname
+
+
+def _build_sysmatrix_file(angles, sinoparams, imgparams, lib_path, py_Amatrix_fname, hash_val, on_the_fly,
+                          sysmatrix_precision, verbose, num_threads):
+    """Compute the system matrix into the file py_Amatrix_fname, used by get_sysmatrix_fname_cy() under the build lock."""
+    py_Amatrix_fname_tmp = _utils._gen_sysmatrix_fname_tmp(lib_path=lib_path, sysmatrix_name=hash_val[:__namelen_sysmatrix])
+    # A matrix for a subset of the views of a cached matrix is copied from it
+    views_key = _utils.sysmatrix_views_key(sinoparams, imgparams, on_the_fly=on_the_fly, sysmatrix_precision=sysmatrix_precision)
+    superset = _utils.find_sysmatrix_superset(lib_path, angles, views_key)
+    copied = False
+    if superset is not None:
+        superset_fname, superset_angles, view_index = superset
+        # The superset is locked while it is copied and may have been evicted since it was found
+        with _utils._open_sysmatrix_lock(superset_fname, fcntl.LOCK_SH):
+            if os.path.exists(superset_fname):
+                if verbose >= 1:
+                    print(f'Copying the system matrix from the views of {superset_fname}.')
+                AmatrixSubsetToFile_cy(superset_fname, superset_angles, view_index, sinoparams, imgparams, py_Amatrix_fname_tmp,
+                                       verbose=verbose, num_threads=num_threads)
+                copied = True
+    if not copied:
+        AmatrixComputeToFile_cy(angles, sinoparams, imgparams, py_Amatrix_fname_tmp, on_the_fly=on_the_fly,
+                                sysmatrix_precision=sysmatrix_precision, verbose=verbose, num_threads=num_threads)
+    os.rename(py_Amatrix_fname_tmp, py_Amatrix_fname)
+    _utils.write_sysmatrix_views(py_Amatrix_fname, angles, views_key)
+    cache_budget = _utils.sysmatrix_cache_budget()
+    if cache_budget is not None:
+        _utils.evict_sysmatrix_cache(lib_path, cache_budget, keep=[py_Amatrix_fname])
+
+
+def fdk_cy(sino, angles, sinoparams, imgparams, lib_path, sysmatrix_precision='uint8', verbose=1, num_threads=None):
+    """FDK style reconstruction used by mbircone.cone3D.recon() with init_image='fdk'.
+
+    Args:
+        sino (ndarray): 3D sinogram of shape (num_views, num_det_rows, num_det_channels).
+
+    Returns:
+        ndarray: 3D numpy array containing the reconstruction with shape (num_img_slices, num_img_rows, num_img_cols).
+    """
+    sino = as_float_array(sino, (sinoparams['N_beta'], sinoparams['N_dw'], sinoparams['N_dv']), 'sino')
+    image = np.empty((imgparams['N_z'], imgparams['N_y'], imgparams['N_x']), dtype=np.single)
+
+    cdef ImageParams c_imgparams
+    cdef SinoParams c_sinoparams
+    convert_py2c_SinoParams3D(&c_sinoparams, sinoparams)
+    convert_py2c_ImageParams3D(&c_imgparams, imgparams)
+
+    cdef cnp.ndarray[char, ndim=1, mode="c"] c_Amatrix_fname
+    cdef FloatArray3DView c_image = float_array_view(image, _IMAGE_AXES)
+    cdef FloatArray3DView c_sino = float_array_view(sino, _SINO_AXES)
+    cdef char *c_Amatrix_fname_ptr
+    cdef int c_num_threads = num_threads if num_threads is not None else 0
+    with contextlib.ExitStack() as sysmatrix_locks:
+        py_Amatrix_fname = get_sysmatrix_fname_cy(angles, sinoparams, imgparams, lib_path, sysmatrix_precision=sysmatrix_precision,
+                                                  verbose=verbose, num_threads=num_threads, sysmatrix_locks=sysmatrix_locks)
+        c_Amatrix_fname = string_to_char_array(py_Amatrix_fname)
+        c_Amatrix_fname_ptr = &c_Amatrix_fname[0]
+        with nogil:
+            set_num_threads(c_num_threads)
+            fdkRecon(c_image, c_sino, c_sinoparams, c_imgparams, c_Amatrix_fname_ptr)
+
+    return image
+
+
+def recon_cy(sino, angles, wght, x_init, proxmap_input,
+             sinoparams, imgparams, reconparams, max_resolutions, 
+             num_threads, lib_path, sysmatrix_precision='uint8'):
     # sino, wght shape : views x slices x channels
-    # recon shape: N_x N_y N_z (source-detector-line, channels, slices)
-    if np.isscalar(x_init):
-        x_init = np.zeros((imgparams['N_x'], imgparams['N_y'], imgparams['N_z'])) + x_init
-    else:
-        x_init = np.swapaxes(x_init, 0, 2)
-    if not x_init.flags["C_CONTIGUOUS"]:
-        x_init = np.ascontiguousarray(x_init, dtype=np.single)
-    else:
-        x_init = x_init.astype(np.single, copy=False)
-    cdef cnp.ndarray[float, ndim=3, mode="c"] cy_x = x_init
-    
-    cdef cnp.ndarray[float, ndim=3, mode="c"] cy_proxmap_input = np.empty((imgparams['N_x'], imgparams['N_y'], imgparams['N_z']), dtype=ctypes.c_float)
+    # recon shape: slices x rows x cols
+    # The arrays are passed to C in this layout, C reads them through views indexed as its own arrays
+    image_shape = (imgparams['N_z'], imgparams['N_y'], imgparams['N_x'])
+    sino_shape = (sinoparams['N_beta'], sinoparams['N_dw'], sinoparams['N_dv'])
+    x_init = as_float_array(x_init, image_shape, 'init_image')
     if proxmap_input is not None:
-        proxmap_input = np.swapaxes(proxmap_input, 0, 2)
-        proxmap_input = np.ascontiguousarray(proxmap_input, dtype=np.single)
-        cy_proxmap_input = proxmap_input
-    
-    sino = np.swapaxes(sino,1,2)
-    sino = np.ascontiguousarray(sino, dtype=np.single)
-    cdef cnp.ndarray[float, ndim=3, mode="c"] cy_sino = sino
-   
-    wght = np.swapaxes(wght,1,2) 
-    wght = np.ascontiguousarray(wght, dtype=np.single)
-    cdef cnp.ndarray[float, ndim=3, mode="c"] cy_wght = wght
-    
-    cdef cnp.ndarray[char, ndim=1, mode="c"] c_Amatrix_fname = string_to_char_array(py_Amatrix_fname)
+        proxmap_input = as_float_array(proxmap_input, image_shape, 'prox_image')
+    sino = as_float_array(sino, sino_shape, 'sino')
+    wght = as_float_array(wght, sino_shape, 'weights')
+    x = np.empty(image_shape, dtype=np.single)
+
+    # Parameters of each resolution level, level 0 is the finest. Binning the data, resizing the images and
+    # going from level to level is done in C by multiresRecon(), here only the parameters of the levels are set.
+    levels = [(angles, sinoparams, imgparams, reconparams, False)]
+    while (len(levels) <= max_resolutions) and (min(levels[-1][2]['N_x'], levels[-1][2]['N_y'], levels[-1][2]['N_z']) > 16):
+        angles_hr, sinoparams_hr, imgparams_hr, reconparams_hr, _ = levels[-1]
+        imgparams_lr = imgparams_hr.copy()
+        reconparams_lr = reconparams_hr.copy()
+        # Set the pixel pitch, num_rows, and num_cols for the next lower resolution
+        imgparams_lr['Delta_xy'] = 2 * imgparams_hr['Delta_xy']
+        imgparams_lr['Delta_z'] = 2 * imgparams_hr['Delta_z']
+        imgparams_lr['N_x'] = int(np.ceil(imgparams_hr['N_x'] / 2))
+        imgparams_lr['N_y'] = int(np.ceil(imgparams_hr['N_y'] / 2))
+        imgparams_lr['N_z'] = int(np.ceil(imgparams_hr['N_z'] / 2))
+        imgparams_lr['j_xstart_roi'] = int(np.floor(imgparams_hr['j_xstart_roi'] / 2))
+        imgparams_lr['j_xstop_roi'] = int(np.ceil(imgparams_hr['j_xstop_roi'] / 2))
+        imgparams_lr['j_ystart_roi'] = int(np.floor(imgparams_hr['j_ystart_roi'] / 2))
+        imgparams_lr['j_ystop_roi'] = int(np.ceil(imgparams_hr['j_ystop_roi'] / 2))
+        imgparams_lr['j_zstart_roi'] = int(np.floor(imgparams_hr['j_zstart_roi'] / 2))
+        imgparams_lr['j_zstop_roi'] = int(np.ceil(imgparams_hr['j_zstop_roi'] / 2))
+        # Rescale sigma_y for lower resolution
+        reconparams_lr['weightScaler_value'] = 2.0 * reconparams_hr['weightScaler_value']
+        # The sinogram and weights are binned to match the lower resolution; each level bins the data of the level above once.
+        # Views are binned only if the binned views still sample the lower resolution grid finely enough (about pi/2 views per pixel width).
+        bin_views = (sinoparams_hr['N_beta'] // 2) >= (np.pi / 2) * max(imgparams_lr['N_x'], imgparams_lr['N_y'])
+        bin_views = bin_views and sinoparams_hr['N_beta'] > 1
+        angles_lr, sinoparams_lr = _utils.bin_sinoparams_2x(angles_hr, sinoparams_hr, bin_views=bin_views)
+        levels.append((angles_lr, sinoparams_lr, imgparams_lr, reconparams_lr, bin_views))
+    num_levels = len(levels)
+
+    cdef SinoParams *c_sinoparams = <SinoParams *> malloc(num_levels * sizeof(SinoParams))
+    cdef ImageParams *c_imgparams = <ImageParams *> malloc(num_levels * sizeof(ImageParams))
+    cdef ReconParams *c_reconparams = <ReconParams *> malloc(num_levels * sizeof(ReconParams))
+    cdef char *c_bin_views = <char *> malloc(num_levels * sizeof(char))
+    cdef char **c_Amatrix_fnames = <char **> malloc(num_levels * sizeof(char *))
+    cdef cnp.ndarray[char, ndim=1, mode="c"] c_Amatrix_fname
     cdef cnp.ndarray[char, ndim=1, mode="c"] cy_relativeChangeMode = string_to_char_array(reconparams["relativeChangeMode"])
     cdef cnp.ndarray[char, ndim=1, mode="c"] cy_weightScaler_estimateMode = string_to_char_array(reconparams["weightScaler_estimateMode"])
     cdef cnp.ndarray[char, ndim=1, mode="c"] cy_weightScaler_domain = string_to_char_array(reconparams["weightScaler_domain"])
     cdef cnp.ndarray[char, ndim=1, mode="c"] cy_NHICD_Mode = string_to_char_array(reconparams["NHICD_Mode"])
+    # The C file names point into these arrays
+    Amatrix_fname_arrays = []
+
+    cdef FloatArray3DView c_x = float_array_view(x, _IMAGE_AXES)
+    cdef FloatArray3DView c_x_init = float_array_view(x_init, _IMAGE_AXES)
+    cdef FloatArray3DView c_sino = float_array_view(sino, _SINO_AXES)
+    cdef FloatArray3DView c_wght = float_array_view(wght, _SINO_AXES)
+    cdef FloatArray3DView c_proxmap_input = float_array_view(proxmap_input if reconparams['prox_mode'] else None, _IMAGE_AXES)
+    cdef int c_num_threads = num_threads
+    cdef int c_num_levels = num_levels
+    cdef int l
+    # The system matrices of all levels stay locked against cache eviction until multiresRecon() is done with them
+    sysmatrix_locks = contextlib.ExitStack()
+
+    try:
+        for l in range(num_levels):
+            angles_l, sinoparams_l, imgparams_l, reconparams_l, bin_views = levels[l]
+            py_Amatrix_fname = get_sysmatrix_fname_cy(angles_l, sinoparams_l, imgparams_l, lib_path, sysmatrix_precision=sysmatrix_precision,
+                                                      verbose=reconparams['verbosity'], num_threads=num_threads,
+                                                      sysmatrix_locks=sysmatrix_locks)
+            c_Amatrix_fname = string_to_char_array(py_Amatrix_fname)
+            Amatrix_fname_arrays.append(c_Amatrix_fname)
+            c_Amatrix_fnames[l] = &c_Amatrix_fname[0]
+            c_bin_views[l] = bin_views
+
+            convert_py2c_SinoParams3D(&c_sinoparams[l], sinoparams_l)
+            convert_py2c_ImageParams3D(&c_imgparams[l], imgparams_l)
+            map_py2c_reconparams(&c_reconparams[l],
+                                  reconparams_l,
+                                  &cy_relativeChangeMode[0],
+                                  &cy_weightScaler_estimateMode[0],
+                                  &cy_weightScaler_domain[0],
+                                  &cy_NHICD_Mode[0])
+
+        # The GIL is released, so other Python threads run while this reconstruction does
+        with nogil:
+            set_num_threads(c_num_threads)
+            multiresRecon(c_x,
+                          c_x_init,
+                          c_sino,
+                          c_wght,
+                          c_proxmap_input,
+                          c_num_levels,
+                          c_sinoparams,
+                          c_imgparams,
+                          c_reconparams,
+                          c_bin_views,
+                          c_Amatrix_fnames)
+    finally:
+        sysmatrix_locks.close()
+        free(c_sinoparams)
+        free(c_imgparams)
+        free(c_reconparams)
+        free(c_bin_views)
+        free(c_Amatrix_fnames)
+    # print("Cython done")
+    return x
 
-    cdef ImageParams c_imgparams
-    cdef SinoParams c_sinoparams
-    cdef ReconParams c_reconparams
 
-    convert_py2c_SinoParams3D(&c_sinoparams, sinoparams)
-    convert_py2c_ImageParams3D(&c_imgparams, imgparams)
-    map_py2c_reconparams(&c_reconparams,
-                          reconparams,
-                          &cy_relativeChangeMode[0],
-                          &cy_weightScaler_estimateMode[0],
-                          &cy_weightScaler_domain[0],
-                          &cy_NHICD_Mode[0])
-
-    openmp.omp_set_num_threads(num_threads)
-    recon(&cy_x[0,0,0],
-          &cy_sino[0,0,0],
-          &cy_wght[0,0,0],
-          &cy_proxmap_input[0,0,0],
-          c_sinoparams,
-          c_imgparams,
-          c_reconparams,
-          &c_Amatrix_fname[0])
-    # print("Cython done")
-    # Convert shape from Cython interface specifications to Python interface specifications
-    return np.swapaxes(cy_x, 0, 2)
+cdef class ReconContext_cy:
+    """Reconstruction state kept in C between calls with the same geometry, sinogram, weights and reconparams.
+
+    The system matrix is read once, and the error sinogram is updated from the image change instead of being
+    recomputed, so repeated short reconstructions (e.g. the proximal map in MACE) avoid the setup cost of recon_cy.
+    No multi-resolution is performed.
+    Different contexts can be used from different Python threads at the same time, one context only by one thread at a time.
+    """
+    cdef ReconContext *c_ctx
+    cdef object sino
+    cdef object imgparams
+    cdef int num_threads
+    cdef object sysmatrix_locks
+
+    def __cinit__(self, sino, angles, wght, sinoparams, imgparams, reconparams, num_threads, lib_path, sysmatrix_precision='uint8'):
+        self.c_ctx = NULL
+        self.imgparams = imgparams
+        self.num_threads = num_threads
+        # The system matrix stays locked against cache eviction while the context uses it
+        self.sysmatrix_locks = contextlib.ExitStack()
+
+        py_Amatrix_fname = get_sysmatrix_fname_cy(angles, sinoparams, imgparams, lib_path, sysmatrix_precision=sysmatrix_precision,
+                                                  verbose=reconparams['verbosity'], num_threads=num_threads,
+                                                  sysmatrix_locks=self.sysmatrix_locks)
+
+        # The C context keeps a view of the sinogram, so keep the array alive here. The weights are copied by C, unless they are a broadcast scalar.
+        sino_shape = (sinoparams['N_beta'], sinoparams['N_dw'], sinoparams['N_dv'])
+        self.sino = as_float_array(sino, sino_shape, 'sino')
+        wght = as_float_array(wght, sino_shape, 'weights')
+
+        cdef cnp.ndarray[char, ndim=1, mode="c"] c_Amatrix_fname = string_to_char_array(py_Amatrix_fname)
+        cdef cnp.ndarray[char, ndim=1, mode="c"] cy_relativeChangeMode = string_to_char_array(reconparams["relativeChangeMode"])
+        cdef cnp.ndarray[char, ndim=1, mode="c"] cy_weightScaler_estimateMode = string_to_char_array(reconparams["weightScaler_estimateMode"])
+        cdef cnp.ndarray[char, ndim=1, mode="c"] cy_weightScaler_domain = string_to_char_array(reconparams["weightScaler_domain"])
+        cdef cnp.ndarray[char, ndim=1, mode="c"] cy_NHICD_Mode = string_to_char_array(reconparams["NHICD_Mode"])
+
+        cdef ImageParams c_imgparams
+        cdef SinoParams c_sinoparams
+        cdef ReconParams c_reconparams
+
+        convert_py2c_SinoParams3D(&c_sinoparams, sinoparams)
+        convert_py2c_ImageParams3D(&c_imgparams, imgparams)
+        map_py2c_reconparams(&c_reconparams,
+                              reconparams,
+                              &cy_relativeChangeMode[0],
+                              &cy_weightScaler_estimateMode[0],
+                              &cy_weightScaler_domain[0],
+                              &cy_NHICD_Mode[0])
+
+        cdef FloatArray3DView c_sino = float_array_view(self.sino, _SINO_AXES)
+        cdef FloatArray3DView c_wght = float_array_view(wght, _SINO_AXES)
+        cdef char *c_Amatrix_fname_ptr = &c_Amatrix_fname[0]
+        cdef ReconContext *c_ctx
+        with nogil:
+            set_num_threads(self.num_threads)
+            c_ctx = createReconContext(c_sino, c_wght, c_sinoparams, c_imgparams, c_reconparams, c_Amatrix_fname_ptr)
+        self.c_ctx = c_ctx
+
+    def __dealloc__(self):
+        destroyReconContext(self.c_ctx)
+        self.c_ctx = NULL
+        if self.sysmatrix_locks is not None:
+            self.sysmatrix_locks.close()
+
+    def recon(self, x_init, proxmap_input=None):
+        """Reconstruct starting from x_init.
+
+        Args:
+            x_init (float or ndarray): Initial image, scalar or array with shape (num_img_slices, num_img_rows, num_img_cols).
+            proxmap_input (ndarray, optional): Proximal map input image with the same shape. Required if reconparams['prox_mode'] is True.
+
+        Returns:
+            ndarray: Reconstruction with shape (num_img_slices, num_img_rows, num_img_cols).
+        """
+        imgparams = self.imgparams
+        image_shape = (imgparams['N_z'], imgparams['N_y'], imgparams['N_x'])
+        x_init = as_float_array(x_init, image_shape, 'init_image')
+        if proxmap_input is not None:
+            proxmap_input = as_float_array(proxmap_input, image_shape, 'prox_image')
+        x = np.empty(image_shape, dtype=np.single)
+
+        cdef FloatArray3DView c_x = float_array_view(x, _IMAGE_AXES)
+        cdef FloatArray3DView c_x_init = float_array_view(x_init, _IMAGE_AXES)
+        cdef FloatArray3DView c_proxmap_input = float_array_view(proxmap_input, _IMAGE_AXES)
+        with nogil:
+            set_num_threads(self.num_threads)
+            reconWithContext(self.c_ctx, c_x, c_x_init, c_proxmap_input)
+        return x
 
 
 def project(image, settings):
@@ -405,20 +746,16 @@ def project(image, settings):
     sysmatrix_fname = settings['sysmatrix_fname']
     num_threads = settings['num_threads']
 
-    openmp.omp_set_num_threads(num_threads)
-
     # Get shapes of projection
     num_views = sinoparams['N_beta']
     num_det_rows = sinoparams['N_dv']
     num_det_channels = sinoparams['N_dw']
 
-    # Ensure image memory is aligned properly
-    image = np.swapaxes(image, 0, 2)
-    image = np.ascontiguousarray(image, dtype=np.single)
-    cdef cnp.ndarray[float, ndim=3, mode="c"] cy_image = image
+    # The image is read by C in the python layout
+    image = as_float_array(image, (imgparams['N_z'], imgparams['N_y'], imgparams['N_x']), 'image')
 
     # Allocates memory, without initialization, for matrix to be passed back from C subroutine
-    cdef cnp.ndarray[float, ndim=3, mode="c"] proj = np.empty((num_views, num_det_rows, num_det_channels), dtype=ctypes.c_float)
+    proj = np.empty((num_views, num_det_channels, num_det_rows), dtype=np.single)
 
     # Write parameter to c structures based on given py parameter List.
     cdef ImageParams c_imgparams
@@ -428,13 +765,99 @@ def project(image, settings):
 
     cdef cnp.ndarray[char, ndim=1, mode="c"] Amatrix_fname = string_to_char_array(sysmatrix_fname)
 
+    cdef FloatArray3DView c_proj = float_array_view(proj, _SINO_AXES)
+    cdef FloatArray3DView c_image = float_array_view(image, _IMAGE_AXES)
+    cdef char *c_Amatrix_fname = &Amatrix_fname[0]
+    cdef int c_num_threads = num_threads
+
     # Forward projection by calling C subroutine
-    forwardProject(&proj[0,0,0],
-                    &cy_image[0,0,0],
+    with nogil:
+        set_num_threads(c_num_threads)
+        forwardProject(c_proj,
+                        c_image,
+                        c_sinoparams,
+                        c_imgparams,
+                        c_Amatrix_fname)
+
+    # print("Cython done")
+    return proj
+
+
+def backproject(sino, settings):
+    """Back projection function used by mbircone.cone3D.backproject().
+
+    Args:
+        sino (ndarray): 3D sinogram of shape (num_views, num_det_rows, num_det_channels) to be back projected.
+        settings (dict): Dictionary containing back projection settings. settings['mode'] is 0 for A^t y, 1 for entropy and 2 for kappa.
+
+    Returns:
+        ndarray: 3D numpy array containing back projection with shape (num_img_slices, num_img_rows, num_img_cols).
+    """
+
+    imgparams = settings['imgparams']
+    sinoparams = settings['sinoparams']
+    sysmatrix_fname = settings['sysmatrix_fname']
+    num_threads = settings['num_threads']
+    mode = settings['mode']
+
+    # The sinogram is read by C in the python layout
+    sino = as_float_array(sino, (sinoparams['N_beta'], sinoparams['N_dw'], sinoparams['N_dv']), 'sino')
+
+    # Allocates memory, without initialization, for matrix to be passed back from C subroutine
+    image = np.empty((imgparams['N_z'], imgparams['N_y'], imgparams['N_x']), dtype=np.single)
+
+    # Write parameter to c structures based on given py parameter List.
+    cdef ImageParams c_imgparams
+    cdef SinoParams c_sinoparams
+    convert_py2c_SinoParams3D(&c_sinoparams, sinoparams)
+    convert_py2c_ImageParams3D(&c_imgparams, imgparams)
+
+    cdef cnp.ndarray[char, ndim=1, mode="c"] Amatrix_fname = string_to_char_array(sysmatrix_fname)
+
+    cdef FloatArray3DView c_image = float_array_view(image, _IMAGE_AXES)
+    cdef FloatArray3DView c_sino = float_array_view(sino, _SINO_AXES)
+    cdef char *c_Amatrix_fname = &Amatrix_fname[0]
+    cdef int c_num_threads = num_threads
+    cdef char c_mode = mode
+
+    # Back projection by calling C subroutine
+    with nogil:
+        set_num_threads(c_num_threads)
+        backProject(c_image,
+                    c_sino,
                     c_sinoparams,
                     c_imgparams,
-                    &Amatrix_fname[0])
+                    c_Amatrix_fname,
+                    c_mode)
 
-    # print("Cython done")
-    # Convert shape from Cython interface specifications to Python interface specifications
-    return np.swapaxes(proj, 1, 2)
+    return image
+
+
+def resize_image_cy(image, output_shape, num_threads=None):
+    """Resizing function used by _utils.recon_resize_3D() and _utils.recon_resize_2D().
+
+    Args:
+        image (ndarray): 3D image to be resized.
+        output_shape (tuple): Shape of the resized image.
+        num_threads (int, optional): Number of threads, None keeps the current OpenMP setting.
+
+    Returns:
+        ndarray: 3D float32 numpy array with shape output_shape. It is box averaged if it is smaller than image
+        along every axis, and trilinearly interpolated otherwise.
+    """
+    image = np.asarray(image, dtype=np.single)
+    output_shape = tuple(int(n) for n in output_shape)
+    image = as_float_array(image, image.shape, 'image')
+    resized_image = np.empty(output_shape, dtype=np.single)
+
+    # Both resizing kernels treat the axes alike, so the arrays are passed with their axes in memory order
+    cdef FloatArray3DView c_resized_image = float_array_view(resized_image, (0, 1, 2))
+    cdef FloatArray3DView c_image = float_array_view(image, (0, 1, 2))
+    cdef long int N_0_out = output_shape[0], N_1_out = output_shape[1], N_2_out = output_shape[2]
+    cdef long int N_0_in = image.shape[0], N_1_in = image.shape[1], N_2_in = image.shape[2]
+    cdef int c_num_threads = num_threads if num_threads is not None else 0
+    with nogil:
+        set_num_threads(c_num_threads)
+        resizeImage(c_resized_image, c_image, N_0_out, N_1_out, N_2_out, N_0_in, N_1_in, N_2_in)
+
+    return resized_image
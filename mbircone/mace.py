@@ -3,6 +3,7 @@ import os
 import time
 import mbircone.cone3D as cone3D
 import mbircone.multinode as multinode
+import mbircone._utils as _utils
 
 __lib_path = os.path.join(os.path.expanduser('~'), '.cache', 'mbircone')
 
@@ -62,7 +63,7 @@ def mace3D(sino, angles, dist_source_detector, magnification,
            positivity=True, p=1.2, q=2.0, T=1.0, num_neighbors=6,
            sharpness=0.0, sigma_x=None, sigma_p=None, max_iterations=3, stop_threshold=0.02,
            num_threads=None, NHICD=False, verbose=1, 
-           lib_path=__lib_path):
+           lib_path=__lib_path, zipline_mode=2):
     """Computes 3-D conebeam beam reconstruction with multi-slice MACE alogorithm by fusing forward model proximal map with 2D denoisers across xy, xz, and yz planes.
     
     Required arguments: 
@@ -111,6 +112,7 @@ def mace3D(sino, angles, dist_source_detector, magnification,
         - **NHICD** (*bool, optional*): [Default=False] If true, uses Non-homogeneous ICD updates
         - **verbose** (*int, optional*): [Default=1] Possible values are {0,1,2}, where 0 is quiet, 1 prints MACE reconstruction progress information, and 2 prints the MACE reconstruction as well as qGGMRF/proximal-map reconstruction progress information.
         - **lib_path** (*str, optional*): [Default=~/.cache/mbircone] Path to directory containing library of forward projection matrices.
+        - **zipline_mode** (*int, optional*): [Default=2] Order of the ICD voxel updates in the qGGMRF and proximal map reconstructions. See ``cone3D.recon``.
     
     Returns:
         3-D numpy array: 3-D reconstruction with shape (num_img_slices, num_img_rows, num_img_cols) in units of :math:`ALU^{-1}`.        
@@ -122,7 +124,7 @@ def mace3D(sino, angles, dist_source_detector, magnification,
     qGGMRF_verbose = max(0,verbose-1)     
     # Calculate automatic value of sinogram weights
     if weights is None:
-        weights = cone3D.calc_weights(sino,weight_type)
+        weights = cone3D._default_weights(sino,weight_type)
     # Calculate automatic value of delta_pixel_image
     if delta_pixel_image is None:
         delta_pixel_image = delta_pixel_detector/magnification
@@ -146,7 +148,8 @@ def mace3D(sino, angles, dist_source_detector, magnification,
                                   weights=weights, sigma_y=sigma_y, sigma_x=sigma_x,
                                   positivity=positivity, p=p, q=q, T=T, num_neighbors=num_neighbors,
                                   stop_threshold=stop_threshold,
-                                  num_threads=num_threads, NHICD=NHICD, verbose=qGGMRF_verbose, lib_path=lib_path)
+                                  num_threads=num_threads, NHICD=NHICD, verbose=qGGMRF_verbose, lib_path=lib_path,
+                                  zipline_mode=zipline_mode)
         if verbose:
             end = time.time()
             elapsed_t = end-start
@@ -181,6 +184,17 @@ def mace3D(sino, angles, dist_source_detector, magnification,
     if not isinstance(denoiser_args, tuple):
         denoiser_args = (denoiser_args,) 
     
+    # The forward model proximal map keeps the system matrix and error sinogram resident across ADMM iterations
+    prox_context = cone3D._create_recon_context(sino, angles, dist_source_detector, magnification,
+                                                channel_offset=channel_offset, row_offset=row_offset, rotation_offset=rotation_offset,
+                                                delta_pixel_detector=delta_pixel_detector, delta_pixel_image=delta_pixel_image, ror_radius=ror_radius,
+                                                prox_mode=True,
+                                                sigma_y=sigma_y, weights=weights,
+                                                positivity=positivity,
+                                                sigma_p=sigma_p, max_iterations=max_iterations, stop_threshold=stop_threshold,
+                                                num_threads=num_threads, NHICD=NHICD, verbose=qGGMRF_verbose, lib_path=lib_path,
+                                                zipline_mode=zipline_mode)
+
     ######################## begin ADMM iterations ########################
     if verbose:
         print("Begin MACE ADMM iterations:")
@@ -189,14 +203,7 @@ def mace3D(sino, angles, dist_source_detector, magnification,
             print(f"Begin MACE iteration {itr}/{max_admm_itr}:")
             itr_start = time.time()
         # forward model prox map agent
-        X[0] = cone3D.recon(sino, angles, dist_source_detector, magnification,
-                            channel_offset=channel_offset, row_offset=row_offset, rotation_offset=rotation_offset,
-                            delta_pixel_detector=delta_pixel_detector, delta_pixel_image=delta_pixel_image, ror_radius=ror_radius,
-                            init_image=X[0], prox_image=W[0],
-                            sigma_y=sigma_y, weights=weights,
-                            positivity=positivity,
-                            sigma_p=sigma_p, max_iterations=max_iterations, stop_threshold=stop_threshold,
-                            num_threads=num_threads, NHICD=NHICD, verbose=qGGMRF_verbose, lib_path=lib_path)
+        X[0] = prox_context.recon(X[0], W[0])
         if verbose:
             print("Done forward model proximal map estimation.")
         # prior model denoiser agents
@@ -235,7 +242,7 @@ def mace4D(sino, angles, dist_source_detector, magnification,
            positivity=True, p=1.2, q=2.0, T=1.0, num_neighbors=6,
            sharpness=0.0, sigma_x=None, sigma_p=None, max_iterations=3, stop_threshold=0.02,
            num_threads=None, NHICD=False, verbose=1, 
-           lib_path=__lib_path):
+           lib_path=__lib_path, zipline_mode=2):
     """Computes 4-D conebeam beam reconstruction with multi-slice MACE alogorithm by fusing forward model proximal map with 2.5-D denoisers across XY-t, XZ-t, and YZ-t hyperplanes.
 
     Required arguments:
@@ -293,6 +300,7 @@ def mace4D(sino, angles, dist_source_detector, magnification,
         - **NHICD** (*bool, optional*): [Default=False] If true, uses Non-homogeneous ICD updates
         - **verbose** (*int, optional*): [Default=1] Possible values are {0,1,2}, where 0 is quiet, 1 prints MACE reconstruction progress information, and 2 prints the MACE reconstruction as well as qGGMRF/proximal-map reconstruction and multinode computation information.
         - **lib_path** (*str, optional*): [Default=~/.cache/mbircone] Path to directory containing library of forward projection matrices.
+        - **zipline_mode** (*int, optional*): [Default=2] Order of the ICD voxel updates in the qGGMRF and proximal map reconstructions. See ``cone3D.recon``.
 
     Returns:
         4-D numpy array: 4-D reconstruction with shape (num_time_points, num_img_slices, num_img_rows, num_img_cols) in units of :math:`ALU^{-1}`.
@@ -324,7 +332,7 @@ def mace4D(sino, angles, dist_source_detector, magnification,
         angles = [angles for _ in range(Nt)]
     # Calculate automatic value of sinogram weights
     if weights is None:
-        weights = cone3D.calc_weights(sino,weight_type)
+        weights = cone3D._default_weights(sino,weight_type)
     # Calculate automatic value of delta_pixel_image
     if delta_pixel_image is None:
         delta_pixel_image = delta_pixel_detector/magnification
@@ -342,7 +350,8 @@ def mace4D(sino, angles, dist_source_detector, magnification,
                          'sigma_y':sigma_y, 'sigma_p':sigma_p,
                          'positivity':positivity, 'p':p, 'q':q, 'T':T, 'num_neighbors':num_neighbors,
                          'max_iterations':20, 'stop_threshold':stop_threshold,
-                         'num_threads':num_threads, 'NHICD':NHICD, 'verbose':qGGMRF_verbose, 'lib_path':lib_path
+                         'num_threads':num_threads, 'NHICD':NHICD, 'verbose':qGGMRF_verbose, 'lib_path':lib_path,
+                         'zipline_mode':zipline_mode
         }
         # List of variable args dictionaries used for multi-node parallelization
         variable_args_list = [{'sino': sino[t], 'angles':angles[t], 'weights':weights[t]} 
@@ -368,7 +377,8 @@ def mace4D(sino, angles, dist_source_detector, magnification,
                                                 weights=weights[t], sigma_y=sigma_y, sigma_x=sigma_x,
                                                 positivity=positivity, p=p, q=q, T=T, num_neighbors=num_neighbors,
                                                 max_iterations=20, stop_threshold=stop_threshold,
-                                                num_threads=num_threads, NHICD=NHICD, verbose=qGGMRF_verbose, lib_path=lib_path) for t in range(Nt)])
+                                                num_threads=num_threads, NHICD=NHICD, verbose=qGGMRF_verbose, lib_path=lib_path,
+                                                zipline_mode=zipline_mode) for t in range(Nt)])
         if verbose:
             end = time.time()
             elapsed_t = end-start
@@ -389,6 +399,29 @@ def mace4D(sino, angles, dist_source_detector, magnification,
     W = [np.copy(init_image) for _ in range(4)]
     X = [np.copy(init_image) for _ in range(4)]
 
+    # Without a cluster, the forward model proximal maps keep their system matrix and error sinogram resident across ADMM iterations
+    if cluster_ticket is None:
+        def create_prox_context(t):
+            return cone3D._create_recon_context(sino[t], angles[t], dist_source_detector, magnification,
+                                                channel_offset=channel_offset, row_offset=row_offset, rotation_offset=rotation_offset,
+                                                delta_pixel_detector=delta_pixel_detector, delta_pixel_image=delta_pixel_image, ror_radius=ror_radius,
+                                                prox_mode=True,
+                                                weights=weights[t], sigma_y=sigma_y, sigma_p=sigma_p,
+                                                positivity=positivity,
+                                                max_iterations=max_iterations, stop_threshold=stop_threshold,
+                                                num_threads=num_threads, NHICD=NHICD, verbose=qGGMRF_verbose, lib_path=lib_path,
+                                                zipline_mode=zipline_mode)
+        # Each context holds the weights and error sinogram of its time point. If the contexts of all time points
+        # exceed the budget, only one context is live at a time, and it is created anew for every proximal map.
+        constant_weights = all(stride == 0 for stride in np.asarray(weights[0]).strides)
+        context_size = _utils.estimate_recon_context_size(np.shape(sino[0]), np.shape(init_image)[1:], constant_weights=constant_weights)
+        if Nt * context_size <= _utils.recon_context_memory_budget():
+            prox_contexts = [create_prox_context(t) for t in range(Nt)]
+        else:
+            prox_contexts = None
+            if verbose:
+                print("Reconstruction contexts of all time points exceed the memory budget, creating them one at a time.")
+
     ######################## begin ADMM iterations ########################
     if verbose:
         print("Begin MACE ADMM iterations:")
@@ -407,15 +440,10 @@ def mace4D(sino, angles, dist_source_detector, magnification,
                                                       variable_args_list=variable_args_list,
                                                       constant_args=constant_args,
                                                       verbose=qGGMRF_verbose))
+        elif prox_contexts is not None:
+            X[0] = np.array([prox_contexts[t].recon(X[0][t], W[0][t]) for t in range(Nt)])
         else:
-            X[0] = np.array([cone3D.recon(sino[t], angles[t], dist_source_detector, magnification,
-                                          channel_offset=channel_offset, row_offset=row_offset, rotation_offset=rotation_offset,
-                                          delta_pixel_detector=delta_pixel_detector, delta_pixel_image=delta_pixel_image, ror_radius=ror_radius,
-                                          init_image=X[0][t], prox_image=W[0][t],
-                                          weights=weights, sigma_y=sigma_y, sigma_p=sigma_p,
-                                          positivity=positivity,
-                                          max_iterations=max_iterations, stop_threshold=stop_threshold,
-                                          num_threads=num_threads, NHICD=NHICD, verbose=qGGMRF_verbose, lib_path=lib_path) for t in range(Nt)])
+            X[0] = np.array([create_prox_context(t).recon(X[0][t], W[0][t]) for t in range(Nt)])
         if verbose:
             print("Done forward model proximal map estimation.")
         # prior model denoiser agents
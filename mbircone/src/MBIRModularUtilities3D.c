@@ -1,138 +1,331 @@
 #include "MBIRModularUtilities3D.h"
 
+/* Block size of the layout conversions between caller owned arrays and contiguous C arrays */
+#define FLOATARRAY3DVIEW_BLOCK 32
+
+/**
+ *      Ax_view = Ax_view + a * A_{*,(j_x,j_y,*)} x_col for view i_beta, where Ax_view is [N_dv][N_dw] and x_col is [N_z].
+ *      The w-profile of the column is built in profile[N_dw] and added to each detector row with weight B_ij.
+ *      Voxels with x_col[j_z] == 0 are skipped.
+ */
+static void addColumnProjection3DCone(float *Ax_view, float *x_col, float a, long int j_x, long int j_y, long int i_beta, struct SysMatrix *A, long int N_z, long int N_dw, float *profile)
+{
+    long int j_u, j_z, i_v, q;
+    long int i_wmin, i_wmax, i_wstart, i_wstride;
+    float B_ij, val;
+    struct BColumn col;
+    const void *C_row;
+
+    SysMatrix_getBColumn(A, j_x, j_y, i_beta, &col);
+    j_u = col.j_u;
+
+    /* w-range covered by the column */
+    i_wmin = N_dw;
+    i_wmax = 0;
+    for (j_z = 0; j_z < N_z; ++j_z)
+    {
+        i_wstride = SysMatrix_getWStride(A, j_u, j_z);
+        if (x_col[j_z] == 0 || i_wstride == 0)
+            continue;
+        i_wstart = SysMatrix_getWStart(A, j_u, j_z);
+        i_wmin = _MIN_(i_wmin, i_wstart);
+        i_wmax = _MAX_(i_wmax, i_wstart + i_wstride);
+    }
+    if (i_wmin >= i_wmax)
+        return;
+
+    /* w-profile: profile[i_w - i_wmin] = a * sum_j_z C_ij x_j */
+    memset(profile, 0, (i_wmax - i_wmin)*sizeof(float));
+    for (j_z = 0; j_z < N_z; ++j_z)
+    {
+        if (x_col[j_z] == 0)
+            continue;
+        val = a * A->C_ij_scaler * x_col[j_z];
+        C_row = SysMatrix_getCRow(A, j_u, j_z);
+        i_wstart = SysMatrix_getWStart(A, j_u, j_z);
+        i_wstride = SysMatrix_getWStride(A, j_u, j_z);
+        for (q = 0; q < i_wstride; ++q)
+            profile[i_wstart - i_wmin + q] += val * getCoeff(C_row, A->C_type, q);
+    }
+
+    /* Add the profile to each detector row hit by the column */
+    for (i_v = col.i_vstart; i_v < col.i_vstart+col.i_vstride; ++i_v)
+    {
+        B_ij = BColumn_getB(A, &col, i_v);
+        simd_rowAxpy(&Ax_view[i_v*N_dw + i_wmin], profile, B_ij, i_wmax - i_wmin);
+    }
+}
+
+/* Ax_view = Ax_view + a * A_{*,*} x for view i_beta, skipping the columns with isColumnChanged[j_x][j_y] == 0 unless isColumnChanged is NULL */
+static void addViewProjection3DCone(float *Ax_view, float *x, float a, char **isColumnChanged, long int i_beta, struct ImageParams *imgParams, struct SysMatrix *A, long int N_dw, float *profile)
+{
+    long int j_x, j_y;
+
+    for (j_x = 0; j_x <= imgParams->N_x-1; ++j_x)
+    {
+        for (j_y = 0; j_y <= imgParams->N_y-1; ++j_y)
+        {
+            if (isColumnChanged != NULL && !isColumnChanged[j_x][j_y])
+                continue;
+
+            addColumnProjection3DCone(Ax_view, &x[index_3D(j_x,j_y,0,imgParams->N_y,imgParams->N_z)],
+                                        a, j_x, j_y, i_beta, A, imgParams->N_z, N_dw, profile);
+        }
+    }
+}
+
 void forwardProject3DCone( float *Ax, float *x, struct ImageParams *imgParams, struct SysMatrix *A, struct SinoParams *sinoParams)
 {
-    long int j_u, j_x, j_y, i_beta, i_v, j_z, i_w;
-    float B_ij, B_ij_times_x_j;
+    long int i_beta;
+    float *profile;
 
     setFloatArray2Value( &Ax[0], sinoParams->N_beta*sinoParams->N_dv*sinoParams->N_dw, 0);
 
 
-    #pragma omp parallel for private(j_x, j_y, j_u, i_v, B_ij, j_z, B_ij_times_x_j, i_w)
-    for (i_beta = 0; i_beta <= sinoParams->N_beta-1; ++i_beta)
+    #pragma omp parallel private(profile)
     {
+        profile = (float *) mget_spc(sinoParams->N_dw, sizeof(float));
 
-        for (j_x = 0; j_x <= imgParams->N_x-1; ++j_x)
+        #pragma omp for
+        for (i_beta = 0; i_beta <= sinoParams->N_beta-1; ++i_beta)
         {
-            for (j_y = 0; j_y <= imgParams->N_y-1; ++j_y)
-            {
-                j_u = A->j_u[j_x][j_y][i_beta];
-                for (i_v = A->i_vstart[j_x][j_y][i_beta]; i_v < A->i_vstart[j_x][j_y][i_beta]+A->i_vstride[j_x][j_y][i_beta] ; ++i_v)
-                {
-                    B_ij = A->B_ij_scaler * A->B[j_x][j_y][i_beta*A->i_vstride_max + i_v-A->i_vstart[j_x][j_y][i_beta]];
-                    for (j_z = 0; j_z <= imgParams->N_z-1; ++j_z)
-                    {
-                        B_ij_times_x_j = B_ij * x[index_3D(j_x,j_y,j_z,imgParams->N_y,imgParams->N_z)];    
-                        for (i_w = A->i_wstart[j_u][j_z]; i_w < A->i_wstart[j_u][j_z]+A->i_wstride[j_u][j_z]; ++i_w)
-                        {
-                            Ax[index_3D(i_beta,i_v,i_w,sinoParams->N_dv,sinoParams->N_dw)] += B_ij_times_x_j * A->C_ij_scaler * A->C[j_u][j_z*A->i_wstride_max + i_w-A->i_wstart[j_u][j_z]];
-                        }
-                    }
-                }
-            }
+            addViewProjection3DCone(&Ax[index_3D(i_beta,0,0,sinoParams->N_dv,sinoParams->N_dw)], x, 1.0, NULL, i_beta, imgParams, A, sinoParams->N_dw, profile);
         }
+
+        free((void*)profile);
+    }
+}
+
+/**
+ *      sino->e = y - Ax, one view at a time. A compact error sinogram is encoded view by view from a float
+ *      view buffer of each thread, so no float32 copy of the whole sinogram is needed.
+ */
+void computeErrorSino3DCone(struct Sino *sino, float *x, struct ImageParams *imgParams, struct SysMatrix *A)
+{
+    long int i_beta, i_v, i_w, i_vb, i_wb, N_dv, N_dw;
+    float *profile, *buffer, *view;
+
+    N_dv = sino->params.N_dv;
+    N_dw = sino->params.N_dw;
+
+    #pragma omp parallel private(profile, buffer, view, i_v, i_w, i_vb, i_wb)
+    {
+        profile = (float *) mget_spc(N_dw, sizeof(float));
+        buffer = (sino->eType == COEFF_TYPE_FLOAT32) ? NULL : (float *) mget_spc(N_dv*N_dw, sizeof(float));
+
+        #pragma omp for
+        for (i_beta = 0; i_beta < sino->params.N_beta; ++i_beta)
+        {
+            view = (buffer == NULL) ? (float *) sino->e + i_beta*N_dv*N_dw : buffer;
+            setFloatArray2Value(view, N_dv*N_dw, 0);
+            addViewProjection3DCone(view, x, 1.0, NULL, i_beta, imgParams, A, N_dw, profile);
+
+            /* e = y - Ax, blocked since y may be stored in any layout */
+            for (i_vb = 0; i_vb < N_dv; i_vb += FLOATARRAY3DVIEW_BLOCK)
+            for (i_wb = 0; i_wb < N_dw; i_wb += FLOATARRAY3DVIEW_BLOCK)
+            for (i_v = i_vb; i_v < _MIN_(i_vb + FLOATARRAY3DVIEW_BLOCK, N_dv); ++i_v)
+            for (i_w = i_wb; i_w < _MIN_(i_wb + FLOATARRAY3DVIEW_BLOCK, N_dw); ++i_w)
+                view[i_v*N_dw + i_w] = *FloatArray3DView_at(&sino->vox, i_beta, i_v, i_w) - view[i_v*N_dw + i_w];
+
+            setCoeffRow(sino->e, sino->eType, 1, i_beta*N_dv*N_dw, N_dv*N_dw, view);
+        }
+
+        free((void*)profile);
+        if (buffer != NULL)
+            free((void*)buffer);
     }
 }
 
-void backProjectlike3DCone( float ***x_out, float ***y_in, struct ImageParams *imgParams, struct SysMatrix *A, struct SinoParams *sinoParams, char mode)
+/* sino->e = sino->e - A*deltaX. Columns and voxels where deltaX is zero are skipped. */
+void subtractForwardProject3DCone(struct Sino *sino, float *deltaX, struct ImageParams *imgParams, struct SysMatrix *A)
 {
+    long int j_x, j_y, j_z, i_beta, N_view;
+    char **isColumnChanged;
+    float *profile, *buffer, *view;
 
-    long int j_u, j_x, j_y, i_beta, i_v, j_z, i_w;
-    float B_ij, A_ij;
-    float ticToc;
-    float ***normalization, val, val2;
+    N_view = sino->params.N_dv*sino->params.N_dw;
 
+    /* Mark the (j_x,j_y) columns that contain a nonzero change */
+    isColumnChanged = (char**) multialloc(sizeof(char), 2, imgParams->N_x, imgParams->N_y);
 
-    tic(&ticToc);
     #pragma omp parallel for private(j_y, j_z)
     for (j_x = 0; j_x <= imgParams->N_x-1; ++j_x)
     {
-        for (j_y = 0; j_y <= imgParams->N_y-1 ; ++j_y)
+        for (j_y = 0; j_y <= imgParams->N_y-1; ++j_y)
         {
+            isColumnChanged[j_x][j_y] = 0;
             for (j_z = 0; j_z <= imgParams->N_z-1; ++j_z)
             {
-                x_out[j_x][j_y][j_z] = 0;
+                if (deltaX[index_3D(j_x,j_y,j_z,imgParams->N_y,imgParams->N_z)] != 0)
+                {
+                    isColumnChanged[j_x][j_y] = 1;
+                    break;
+                }
             }
         }
     }
 
-    printf("mode: %d\n", mode);
+    /* Each view is owned by one thread, so the updates of e do not conflict */
+    #pragma omp parallel private(profile, buffer, view)
+    {
+        profile = (float *) mget_spc(sino->params.N_dw, sizeof(float));
+        buffer = (sino->eType == COEFF_TYPE_FLOAT32) ? NULL : (float *) mget_spc(N_view, sizeof(float));
+
+        #pragma omp for
+        for (i_beta = 0; i_beta <= sino->params.N_beta-1; ++i_beta)
+        {
+            view = (buffer == NULL) ? (float *) sino->e + i_beta*N_view : (float *) getCoeffRow(sino->e, sino->eType, 1, i_beta*N_view, N_view, buffer);
+            addViewProjection3DCone(view, deltaX, -1.0, isColumnChanged, i_beta, imgParams, A, sino->params.N_dw, profile);
+            setCoeffRow(sino->e, sino->eType, 1, i_beta*N_view, N_view, view);
+        }
+
+        free((void*)profile);
+        if (buffer != NULL)
+            free((void*)buffer);
+    }
+
+    multifree((void**)isColumnChanged, 2);
+}
+
+/**
+ *      x_out = A^t y_in (mode 0), A^t-weighted variants of y_in (mode 1: entropy in bits, mode 2: kappa = (A.*A)^t y_in),
+ *      or the FDK backprojection (mode 3), where view i_beta is weighted by M^2, M the magnification of the voxel.
+ *      x_out is [N_x][N_y][N_z] and y_in is [N_beta][N_dv][N_dw].
+ *
+ *      Each thread computes whole voxel columns (j_x,j_y), so the output needs no synchronization.
+ *      For modes 0, 2 and 3, the detector rows hit by the column in a view are first combined over i_v
+ *      (sum_i_v B_ij y, resp. sum_i_v B_ij^2 y), as in the zipline ICD kernels.
+ */
+void backProjectlike3DCone( float *x_out, float *y_in, struct ImageParams *imgParams, struct SysMatrix *A, struct SinoParams *sinoParams, char mode)
+{
+    long int j_xy, j_u, j_x, j_y, i_beta, i_v, j_z, i_w, q;
+    long int i_wmin, i_wmax, i_wstart, i_wstride;
+    long int N_y, N_z, N_dv, N_dw;
+    float B_ij, A_ij, C_ij, val, val2, u_v, M;
+    float *x_col, *normalization, *yRow;
+    struct BColumn col;
+    const void *C_row;
+
+    N_y = imgParams->N_y;
+    N_z = imgParams->N_z;
+    N_dv = sinoParams->N_dv;
+    N_dw = sinoParams->N_dw;
 
-    #pragma omp parallel for private(j_x, j_y, j_u, i_v, B_ij, j_z, i_w, A_ij, val)
-    for (i_beta = 0; i_beta <= sinoParams->N_beta-1; ++i_beta)
+    if (mode < 0 || mode > 3)
     {
+        fprintf(stderr, "ERROR in backProjectlike3DCone: unknown mode %d\n", mode);
+        exit(-1);
+    }
 
-        for (j_x = 0; j_x <= imgParams->N_x-1; ++j_x)
+    #pragma omp parallel private(j_x, j_y, j_u, i_beta, i_v, j_z, i_w, q, i_wmin, i_wmax, i_wstart, i_wstride, B_ij, A_ij, C_ij, val, val2, u_v, M, x_col, col, C_row, normalization, yRow)
+    {
+        normalization = (float *) mget_spc(N_z, sizeof(float));
+        yRow = (float *) mget_spc(N_dw, sizeof(float));
+
+        #pragma omp for schedule(dynamic)
+        for (j_xy = 0; j_xy < imgParams->N_x*N_y; ++j_xy)
         {
-            for (j_y = 0; j_y <= imgParams->N_y-1; ++j_y)
+            j_x = j_xy / N_y;
+            j_y = j_xy % N_y;
+            x_col = &x_out[index_3D(j_x,j_y,0,N_y,N_z)];
+            memset(x_col, 0, N_z*sizeof(float));
+            memset(normalization, 0, N_z*sizeof(float));
+
+            if (!isInsideMask(j_x, j_y, imgParams->N_x, N_y))
+                continue;
+
+            for (i_beta = 0; i_beta < sinoParams->N_beta; ++i_beta)
             {
-                if(isInsideMask(j_x, j_y, imgParams->N_x, imgParams->N_y))
+                SysMatrix_getBColumn(A, j_x, j_y, i_beta, &col);
+                j_u = col.j_u;
+
+                if (mode == 1)
                 {
-                    j_u = A->j_u[j_x][j_y][i_beta];
-                    for (i_v = A->i_vstart[j_x][j_y][i_beta]; i_v < A->i_vstart[j_x][j_y][i_beta]+A->i_vstride[j_x][j_y][i_beta] ; ++i_v)
+                    /* entropy */
+                    for (i_v = col.i_vstart; i_v < col.i_vstart+col.i_vstride; ++i_v)
                     {
-                        B_ij = A->B_ij_scaler * A->B[j_x][j_y][i_beta*A->i_vstride_max + i_v-A->i_vstart[j_x][j_y][i_beta]];
-                        for (j_z = 0; j_z <= imgParams->N_z-1; ++j_z)
+                        B_ij = BColumn_getB(A, &col, i_v);
+                        for (j_z = 0; j_z < N_z; ++j_z)
                         {
-                            for (i_w = A->i_wstart[j_u][j_z]; i_w < A->i_wstart[j_u][j_z]+A->i_wstride[j_u][j_z]; ++i_w)
+                            C_row = SysMatrix_getCRow(A, j_u, j_z);
+                            i_wstart = SysMatrix_getWStart(A, j_u, j_z);
+                            i_wstride = SysMatrix_getWStride(A, j_u, j_z);
+                            for (i_w = i_wstart; i_w < i_wstart+i_wstride; ++i_w)
                             {
-                                A_ij = B_ij * A->C_ij_scaler * A->C[j_u][j_z*A->i_wstride_max + i_w-A->i_wstart[j_u][j_z]];
-                                
-
-                                if(mode==0){
-                                    /* normal backprojection */
-                                    x_out[j_x][j_y][j_z] += A_ij * y_in[i_beta][i_v][i_w] ;
-                                }
-                                else if(mode==1){
-                                    /* entropy */
-                                    val = A_ij * y_in[i_beta][i_v][i_w];
-                                    if (val!=0){
-                                        x_out[j_x][j_y][j_z] += val * log(val) ;
-                                    }
-                                    normalization[j_x][j_y][j_z] += A_ij * y_in[i_beta][i_v][i_w] ;
-                                }
-                                else if(mode==2){
-                                    /* kappa */
-                                    x_out[j_x][j_y][j_z] += A_ij * y_in[i_beta][i_v][i_w] * A_ij ;
-                                }
+                                A_ij = B_ij * A->C_ij_scaler * getCoeff(C_row, A->C_type, i_w-i_wstart);
+                                val = A_ij * y_in[index_3D(i_beta,i_v,i_w,N_dv,N_dw)];
+                                if (val != 0)
+                                    x_col[j_z] += val * log(val);
+                                normalization[j_z] += val;
                             }
                         }
                     }
+                    continue;
                 }
-            }
-        }
-    }
 
-    printf("mode: %d\n", mode);
+                /* w-range covered by the column */
+                i_wmin = N_dw;
+                i_wmax = 0;
+                for (j_z = 0; j_z < N_z; ++j_z)
+                {
+                    if (SysMatrix_getWStride(A, j_u, j_z) == 0)
+                        continue;
+                    i_wmin = _MIN_(i_wmin, SysMatrix_getWStart(A, j_u, j_z));
+                    i_wmax = _MAX_(i_wmax, SysMatrix_getWStart(A, j_u, j_z) + SysMatrix_getWStride(A, j_u, j_z));
+                }
+                if (i_wmin >= i_wmax)
+                    continue;
 
-    if(mode==1)
-    {
-        /* compute entropy in bits after normalization */
-        #pragma omp parallel for private(j_y, j_z, val, val2)
-        for (j_x = 0; j_x <= imgParams->N_x-1; ++j_x)
-        {
-            for (j_y = 0; j_y <= imgParams->N_y-1; ++j_y)
-            {
-                for (j_z = 0; j_z <= imgParams->N_z-1; ++j_z)
+                /* FDK distance weight, with u_v recovered from j_u */
+                if (mode == 3)
                 {
-                    val = x_out[j_x][j_y][j_z];
-                    val2 = normalization[j_x][j_y][j_z];
-                    if (val2==0){
-                        x_out[j_x][j_y][j_z] = 0;
-                    }
-                    else{
-                        x_out[j_x][j_y][j_z] = (log(val2) - val/val2)/log(2);
-                    }
+                    u_v = A->u_0 + imgParams->Delta_xy/2 + j_u * A->Delta_u;
+                    M = (sinoParams->u_d0 - sinoParams->u_s) / (u_v - sinoParams->u_s);
+                }
+                else
+                    M = 1;
+
+                /* Combine the detector rows hit by the column */
+                memset(yRow, 0, (i_wmax - i_wmin)*sizeof(float));
+                for (i_v = col.i_vstart; i_v < col.i_vstart+col.i_vstride; ++i_v)
+                {
+                    B_ij = BColumn_getB(A, &col, i_v);
+                    simd_rowAxpy(yRow, &y_in[index_3D(i_beta,i_v,i_wmin,N_dv,N_dw)], (mode == 2) ? B_ij*B_ij : B_ij*M*M, i_wmax - i_wmin);
                 }
-            }   
-        }
-        multifree((void***)normalization, 3);
-    }
 
+                for (j_z = 0; j_z < N_z; ++j_z)
+                {
+                    C_row = SysMatrix_getCRow(A, j_u, j_z);
+                    i_wstart = SysMatrix_getWStart(A, j_u, j_z) - i_wmin;
+                    i_wstride = SysMatrix_getWStride(A, j_u, j_z);
+                    val = 0;
+                    for (q = 0; q < i_wstride; ++q)
+                    {
+                        C_ij = A->C_ij_scaler * getCoeff(C_row, A->C_type, q);
+                        val += ((mode == 2) ? C_ij*C_ij : C_ij) * yRow[i_wstart + q];
+                    }
+                    x_col[j_z] += val;
+                }
+            }
 
-    toc(&ticToc);
-    ticTocDisp(ticToc, "backProjectlike3DCone");
+            if (mode == 1)
+            {
+                /* compute entropy in bits after normalization */
+                for (j_z = 0; j_z < N_z; ++j_z)
+                {
+                    val = x_col[j_z];
+                    val2 = normalization[j_z];
+                    if (val2 == 0)
+                        x_col[j_z] = 0;
+                    else
+                        x_col[j_z] = (log(val2) - val/val2)/log(2);
+                }
+            }
+        }
 
+        free((void*)normalization);
+        free((void*)yRow);
+    }
 }
 
 
@@ -228,29 +421,43 @@ float computeRelativeRMSEFloatArray(float *arr1, float *arr2, long int len)
     return sqrt(numerator/denominator);
 }
 
-float computeSinogramWeightedNormSquared(struct Sino *sino, float *arr)
+float computeErrorSinoWeightedNormSquared(struct Sino *sino)
 {
     /**
-     *                      1  ||     ||2   
-     *      normError    = --- || arr ||  
-     *                      M  ||     ||L 
+     *                      1  ||   ||2   
+     *      normError    = --- || e ||  
+     *                      M  ||   ||L 
      *
      *      normError = weightScaler_value
      * 
      *      Weight_true = Weight / weightScaler_value
      */
-    long int i_beta, i_v, i_w;
+    long int i_beta, i, N_view;
     long int num_mask;
-    float normError = 0;
+    float e, normError = 0;
 
-    for (i_beta = 0; i_beta < sino->params.N_beta; ++i_beta)
-    for (i_v = 0; i_v < sino->params.N_dv; ++i_v)
-    for (i_w = 0; i_w < sino->params.N_dw; ++i_w)
+    N_view = sino->params.N_dv*sino->params.N_dw;
+
+    if (sino->wgt == NULL)
+    {
+        for (i = 0; i < sino->params.N_beta*N_view; ++i)
+        {
+            e = sinoError(sino, i);
+            normError += e*e;
+        }
+        normError *= sino->wgtValue;
+    }
+    else
     {
-        normError += arr[index_3D(i_beta,i_v,i_w,sino->params.N_dv,sino->params.N_dw)] * sino->wgt[index_3D(i_beta,i_v,i_w,sino->params.N_dv,sino->params.N_dw)] * arr[index_3D(i_beta,i_v,i_w,sino->params.N_dv,sino->params.N_dw)];
+        for (i_beta = 0; i_beta < sino->params.N_beta; ++i_beta)
+        for (i = i_beta*N_view; i < (i_beta+1)*N_view; ++i)
+        {
+            e = sinoError(sino, i);
+            normError += e * sinoWeight(sino, i_beta, i) * e;
+        }
     }
 
-    num_mask = sino->params.N_beta * sino->params.N_dv * sino->params.N_dw;
+    num_mask = sino->params.N_beta * N_view;
     
     normError /= num_mask;
 
@@ -258,6 +465,260 @@ float computeSinogramWeightedNormSquared(struct Sino *sino, float *arr)
 }
 
 
+/**
+ *      Norms of the measured sinogram y = sino->vox, weighted as in computeErrorSinoWeightedNormSquared() and unweighted.
+ *      y does not change during a reconstruction, so they are computed once.
+ */
+void computeMeasuredSinoNormsSquared(struct Sino *sino, float *weightedNormSquared, float *normSquared)
+{
+    long int i_beta, i_v, i_w;
+    float y, w, weighted = 0, unweighted = 0;
+
+    for (i_beta = 0; i_beta < sino->params.N_beta; ++i_beta)
+    for (i_v = 0; i_v < sino->params.N_dv; ++i_v)
+    for (i_w = 0; i_w < sino->params.N_dw; ++i_w)
+    {
+        y = *FloatArray3DView_at(&sino->vox, i_beta, i_v, i_w);
+        w = sinoWeight(sino, i_beta, index_3D(i_beta,i_v,i_w,sino->params.N_dv,sino->params.N_dw));
+        weighted += y * w * y;
+        if (w != 0)
+            unweighted += y*y;
+    }
+
+    *weightedNormSquared = weighted / (sino->params.N_beta * sino->params.N_dv * sino->params.N_dw);
+    *normSquared = unweighted;
+}
+
+/**
+ *      Unweighted squared norm of the error sinogram over the entries with nonzero weight.
+ *      The ICD updates skip the error sinogram where the weight is zero, so only these entries of it are up to date.
+ */
+float computeErrorSinoLiveNormSquared(struct Sino *sino)
+{
+    long int i;
+    float e, normSquared = 0;
+
+    if (sino->wgt == NULL && sino->wgtValue == 0)
+        return 0;
+
+    for (i = 0; i < sino->params.N_beta*sino->params.N_dv*sino->params.N_dw; ++i)
+    {
+        if (sino->wgt == NULL || getCoeff(sino->wgt, sino->wgtType, i) != 0)
+        {
+            e = sinoError(sino, i);
+            normSquared += e*e;
+        }
+    }
+
+    return normSquared;
+}
+
+/**
+ *      Relative error of a compact error sinogram against float32: ||e - e_32||_W / ||e_32||_W, where
+ *      e_32 = y - Ax is recomputed in float32 one view at a time. Only entries with nonzero weight are compared,
+ *      since the ICD updates skip the others. Rounding in the ICD updates of e accumulates over the iterations,
+ *      so this checks the whole reconstruction, not just the storage of e.
+ */
+float computeErrorSinoRelativeError(struct Sino *sino, float *x, struct ImageParams *imgParams, struct SysMatrix *A)
+{
+    long int i_beta, i_v, i_w, i, N_dv, N_dw;
+    float *profile, *view;
+    float w, e_32, d;
+    double diffSquared = 0, normSquared = 0;
+
+    N_dv = sino->params.N_dv;
+    N_dw = sino->params.N_dw;
+
+    #pragma omp parallel private(profile, view, i_v, i_w, i, w, e_32, d) reduction(+:diffSquared, normSquared)
+    {
+        profile = (float *) mget_spc(N_dw, sizeof(float));
+        view = (float *) mget_spc(N_dv*N_dw, sizeof(float));
+
+        #pragma omp for
+        for (i_beta = 0; i_beta < sino->params.N_beta; ++i_beta)
+        {
+            setFloatArray2Value(view, N_dv*N_dw, 0);
+            addViewProjection3DCone(view, x, 1.0, NULL, i_beta, imgParams, A, N_dw, profile);
+
+            for (i_v = 0; i_v < N_dv; ++i_v)
+            for (i_w = 0; i_w < N_dw; ++i_w)
+            {
+                i = index_3D(i_beta,i_v,i_w,N_dv,N_dw);
+                w = sinoWeight(sino, i_beta, i);
+                if (w == 0)
+                    continue;
+                e_32 = *FloatArray3DView_at(&sino->vox, i_beta, i_v, i_w) - view[i_v*N_dw + i_w];
+                d = sinoError(sino, i) - e_32;
+                diffSquared += w*d*d;
+                normSquared += w*e_32*e_32;
+            }
+        }
+
+        free((void*)profile);
+        free((void*)view);
+    }
+
+    return (normSquared > 0) ? sqrt(diffSquared / normSquared) : sqrt(diffSquared);
+}
+
+/**
+ *      Store the weights w[N_dv][N_dw] of view i_beta in sino->wgt. For compact types the largest weight
+ *      of the view sets the per-view scaler, see coeffScaler(). Nonzero weights too small for the type keep the
+ *      smallest nonzero value, so the channels with nonzero weight (see computeWeightRuns()) do not change.
+ */
+void setSinoViewWeights(struct Sino *sino, long int i_beta, const float *w)
+{
+    long int i, N_view;
+    float wMax, scaler;
+
+    N_view = sino->params.N_dv*sino->params.N_dw;
+
+    if (sino->wgtType == COEFF_TYPE_FLOAT32)
+    {
+        memcpy((float *) sino->wgt + i_beta*N_view, w, N_view*sizeof(float));
+        return;
+    }
+
+    wMax = 0;
+    for (i = 0; i < N_view; ++i)
+        wMax = _MAX_(wMax, w[i]);
+    scaler = coeffScaler(sino->wgtType, wMax);
+    sino->wgtScale[i_beta] = scaler;
+
+    setCoeffRow(sino->wgt, sino->wgtType, scaler, i_beta*N_view, N_view, w);
+    for (i = 0; i < N_view; ++i)
+    {
+        if (w[i] > 0 && getCoeff(sino->wgt, sino->wgtType, i_beta*N_view + i) == 0)
+        {
+            if (sino->wgtType == COEFF_TYPE_UINT8)
+                ((unsigned char *) sino->wgt)[i_beta*N_view + i] = 1;
+            else
+                ((unsigned short *) sino->wgt)[i_beta*N_view + i] = 1;
+        }
+    }
+}
+
+/**
+ *      Store the weights wght in sino->wgt, one view at a time, see setSinoViewWeights().
+ *      Returns the relative error ||w - w_32|| / ||w_32|| of the stored weights, 0 for float32 weights.
+ */
+float setSinoWeights(struct Sino *sino, struct FloatArray3DView *wght)
+{
+    long int i_beta, i_v, i_w, i_vb, i_wb, i, N_dv, N_dw;
+    float *view;
+    float d;
+    double diffSquared = 0, normSquared = 0;
+
+    N_dv = sino->params.N_dv;
+    N_dw = sino->params.N_dw;
+
+    #pragma omp parallel private(view, i_v, i_w, i_vb, i_wb, i, d) reduction(+:diffSquared, normSquared)
+    {
+        view = (float *) mget_spc(N_dv*N_dw, sizeof(float));
+
+        #pragma omp for
+        for (i_beta = 0; i_beta < sino->params.N_beta; ++i_beta)
+        {
+            for (i_vb = 0; i_vb < N_dv; i_vb += FLOATARRAY3DVIEW_BLOCK)
+            for (i_wb = 0; i_wb < N_dw; i_wb += FLOATARRAY3DVIEW_BLOCK)
+            for (i_v = i_vb; i_v < _MIN_(i_vb + FLOATARRAY3DVIEW_BLOCK, N_dv); ++i_v)
+            for (i_w = i_wb; i_w < _MIN_(i_wb + FLOATARRAY3DVIEW_BLOCK, N_dw); ++i_w)
+                view[i_v*N_dw + i_w] = *FloatArray3DView_at(wght, i_beta, i_v, i_w);
+
+            setSinoViewWeights(sino, i_beta, view);
+
+            if (sino->wgtType != COEFF_TYPE_FLOAT32)
+            {
+                for (i = 0; i < N_dv*N_dw; ++i)
+                {
+                    d = sinoWeight(sino, i_beta, i_beta*N_dv*N_dw + i) - view[i];
+                    diffSquared += d*d;
+                    normSquared += view[i]*view[i];
+                }
+            }
+        }
+
+        free((void*)view);
+    }
+
+    return (normSquared > 0) ? sqrt(diffSquared / normSquared) : 0;
+}
+
+/**
+ *      Set up sino->rowRunIndex and sino->wgtRun, the maximal runs of channels with nonzero weight in each detector row.
+ *      Rows with zero weight everywhere have no runs. The runs are counted per row first and then filled in
+ *      at the offsets given by the running sum of the counts.
+ */
+void computeWeightRuns(struct Sino *sino)
+{
+    long int N_rows, N_dw, r, i_w, k;
+    char isLive, isLiveBefore, isLiveAfter;
+
+    N_rows = sino->params.N_beta*sino->params.N_dv;
+    N_dw = sino->params.N_dw;
+    sino->rowRunIndex = (long int *) mget_spc(N_rows+1, sizeof(long int));
+
+    /* With constant weights each row is one run, or has none if the weight is zero */
+    if (sino->wgt == NULL)
+    {
+        sino->wgtRun = (struct ChannelRun *) mget_spc(N_rows+1, sizeof(struct ChannelRun));
+        for (r = 0; r <= N_rows; ++r)
+        {
+            sino->rowRunIndex[r] = (sino->wgtValue != 0) ? r : 0;
+            sino->wgtRun[r].i_wstart = 0;
+            sino->wgtRun[r].i_wstop = N_dw;
+        }
+        return;
+    }
+
+    #pragma omp parallel for private(i_w, k, isLive, isLiveBefore)
+    for (r = 0; r < N_rows; ++r)
+    {
+        k = 0;
+        isLiveBefore = 0;
+        for (i_w = 0; i_w < N_dw; ++i_w)
+        {
+            isLive = getCoeff(sino->wgt, sino->wgtType, r*N_dw + i_w) != 0;
+            if (isLive && !isLiveBefore)
+                ++k;
+            isLiveBefore = isLive;
+        }
+        sino->rowRunIndex[r+1] = k;
+    }
+
+    sino->rowRunIndex[0] = 0;
+    for (r = 0; r < N_rows; ++r)
+        sino->rowRunIndex[r+1] += sino->rowRunIndex[r];
+
+    sino->wgtRun = (struct ChannelRun *) mget_spc(_MAX_(sino->rowRunIndex[N_rows], 1), sizeof(struct ChannelRun));
+
+    #pragma omp parallel for private(i_w, k, isLive, isLiveBefore, isLiveAfter)
+    for (r = 0; r < N_rows; ++r)
+    {
+        k = sino->rowRunIndex[r];
+        isLiveBefore = 0;
+        isLive = N_dw > 0 && getCoeff(sino->wgt, sino->wgtType, r*N_dw) != 0;
+        for (i_w = 0; i_w < N_dw; ++i_w)
+        {
+            isLiveAfter = i_w+1 < N_dw && getCoeff(sino->wgt, sino->wgtType, r*N_dw + i_w+1) != 0;
+            if (isLive && !isLiveBefore)
+                sino->wgtRun[k].i_wstart = i_w;
+            if (isLive && !isLiveAfter)
+                sino->wgtRun[k++].i_wstop = i_w+1;
+            isLiveBefore = isLive;
+            isLive = isLiveAfter;
+        }
+    }
+}
+
+void freeWeightRuns(struct Sino *sino)
+{
+    free((void *) sino->rowRunIndex);
+    free((void *) sino->wgtRun);
+    sino->rowRunIndex = NULL;
+    sino->wgtRun = NULL;
+}
+
 char isInsideMask(long int i_1, long int i_2, long int N1, long int N2)
 {
     /**
@@ -376,6 +837,206 @@ void floatArray_z_equals_aX_plus_bY(float *Z, float a, float *X, float b, float
     }
 }
 
+/**
+ *      Layout conversion between caller owned arrays and contiguous C arrays [N_0][N_1][N_2].
+ *      Either of the last two indices can be the contiguous one of the caller's array, so both are blocked.
+ */
+
+/* Z = a*X + b*Y, Z and Y contiguous, X in any layout. Y is not read if b == 0. */
+void floatArray3DView_z_equals_aX_plus_bY(float *Z, float a, struct FloatArray3DView *X, float b, float *Y, long int N_0, long int N_1, long int N_2)
+{
+    long int i_0, i_1, i_2, i_1b, i_2b, index;
+
+    #pragma omp parallel for private(i_1b, i_2b, i_1, i_2, index)
+    for (i_0 = 0; i_0 < N_0; ++i_0)
+    for (i_1b = 0; i_1b < N_1; i_1b += FLOATARRAY3DVIEW_BLOCK)
+    for (i_2b = 0; i_2b < N_2; i_2b += FLOATARRAY3DVIEW_BLOCK)
+    for (i_1 = i_1b; i_1 < _MIN_(i_1b + FLOATARRAY3DVIEW_BLOCK, N_1); ++i_1)
+    for (i_2 = i_2b; i_2 < _MIN_(i_2b + FLOATARRAY3DVIEW_BLOCK, N_2); ++i_2)
+    {
+        index = index_3D(i_0, i_1, i_2, N_1, N_2);
+        if (b == 0)
+            Z[index] = a * *FloatArray3DView_at(X, i_0, i_1, i_2);
+        else
+            Z[index] = a * *FloatArray3DView_at(X, i_0, i_1, i_2) + b*Y[index];
+    }
+}
+
+/* X = Y, Y contiguous, X in any layout */
+void floatArray3DView_copyFrom(struct FloatArray3DView *X, float *Y, long int N_0, long int N_1, long int N_2)
+{
+    long int i_0, i_1, i_2, i_1b, i_2b;
+
+    #pragma omp parallel for private(i_1b, i_2b, i_1, i_2)
+    for (i_0 = 0; i_0 < N_0; ++i_0)
+    for (i_1b = 0; i_1b < N_1; i_1b += FLOATARRAY3DVIEW_BLOCK)
+    for (i_2b = 0; i_2b < N_2; i_2b += FLOATARRAY3DVIEW_BLOCK)
+    for (i_1 = i_1b; i_1 < _MIN_(i_1b + FLOATARRAY3DVIEW_BLOCK, N_1); ++i_1)
+    for (i_2 = i_2b; i_2 < _MIN_(i_2b + FLOATARRAY3DVIEW_BLOCK, N_2); ++i_2)
+        *FloatArray3DView_at(X, i_0, i_1, i_2) = Y[index_3D(i_0, i_1, i_2, N_1, N_2)];
+}
+
+/* Neighbors i_lo, i_hi and weight w_hi of i_hi for each of N_out points spread evenly over [0, N_in-1] */
+static void linearInterpolationTable(long int *i_lo, long int *i_hi, float *w_hi, long int N_out, long int N_in)
+{
+    long int j;
+    double c;
+
+    for (j = 0; j < N_out; ++j)
+    {
+        c = (N_out > 1) ? (double) j * (N_in-1) / (N_out-1) : 0;
+        i_lo[j] = _MIN_((long int) c, N_in-1);
+        i_hi[j] = _MIN_(i_lo[j]+1, N_in-1);
+        w_hi[j] = c - i_lo[j];
+    }
+}
+
+/* Start start[j], number of taps count[j] and weights weight[j*maxTaps + t] of each of N_out cells of width N_in/N_out
+ * tiling [0, N_in). Each input voxel is weighted by its overlap with the cell, so the weights of a cell add up to 1. */
+static void boxAveragingTable(long int *start, long int *count, float *weight, long int maxTaps, long int N_out, long int N_in)
+{
+    long int j, i, i_stop;
+    double lo, hi;
+
+    for (j = 0; j < N_out; ++j)
+    {
+        lo = (double) j * N_in / N_out;
+        hi = (double) (j+1) * N_in / N_out;
+        start[j] = (long int) lo;
+        i_stop = _MIN_((long int) ceil(hi), N_in);
+        count[j] = _MIN_(i_stop - start[j], maxTaps);
+        for (i = 0; i < count[j]; ++i)
+            weight[j*maxTaps + i] = (_MIN_(start[j]+i+1, hi) - _MAX_(start[j]+i, lo)) / (hi - lo);
+    }
+}
+
+/**
+ *      Trilinear resizing of the image in[N_x_in][N_y_in][N_z_in] to out[N_x_out][N_y_out][N_z_out].
+ *      The first and last voxels of the two grids are aligned along each axis, as with
+ *      np.linspace(0, N_in-1, N_out), so a constant image stays constant.
+ *      The innermost loop runs along the last axis, so it reads and writes contiguous rows when
+ *      the views are contiguous, and the threads share out the rows of the output.
+ */
+void resizeImageTrilinear(struct FloatArray3DView *out, long int N_x_out, long int N_y_out, long int N_z_out, struct FloatArray3DView *in, long int N_x_in, long int N_y_in, long int N_z_in)
+{
+    long int j_x, j_y, j_z, i_lo, i_hi, *x_lo, *x_hi, *y_lo, *y_hi, *z_lo, *z_hi;
+    float *wx, *wy, *wz, *row_00, *row_01, *row_10, *row_11, *row_out, v_lo, v_hi, c_00, c_01, c_10, c_11;
+
+    x_lo = (long int *) mget_spc(N_x_out, sizeof(long int));
+    x_hi = (long int *) mget_spc(N_x_out, sizeof(long int));
+    y_lo = (long int *) mget_spc(N_y_out, sizeof(long int));
+    y_hi = (long int *) mget_spc(N_y_out, sizeof(long int));
+    z_lo = (long int *) mget_spc(N_z_out, sizeof(long int));
+    z_hi = (long int *) mget_spc(N_z_out, sizeof(long int));
+    wx = (float *) mget_spc(N_x_out, sizeof(float));
+    wy = (float *) mget_spc(N_y_out, sizeof(float));
+    wz = (float *) mget_spc(N_z_out, sizeof(float));
+    linearInterpolationTable(x_lo, x_hi, wx, N_x_out, N_x_in);
+    linearInterpolationTable(y_lo, y_hi, wy, N_y_out, N_y_in);
+    linearInterpolationTable(z_lo, z_hi, wz, N_z_out, N_z_in);
+
+    #pragma omp parallel for collapse(2) private(j_z, i_lo, i_hi, row_00, row_01, row_10, row_11, row_out, v_lo, v_hi, c_00, c_01, c_10, c_11)
+    for (j_x = 0; j_x < N_x_out; ++j_x)
+    for (j_y = 0; j_y < N_y_out; ++j_y)
+    {
+        /* The four input rows along z that the output row at (j_x, j_y) is interpolated from */
+        row_00 = FloatArray3DView_at(in, x_lo[j_x], y_lo[j_y], 0);
+        row_01 = FloatArray3DView_at(in, x_lo[j_x], y_hi[j_y], 0);
+        row_10 = FloatArray3DView_at(in, x_hi[j_x], y_lo[j_y], 0);
+        row_11 = FloatArray3DView_at(in, x_hi[j_x], y_hi[j_y], 0);
+        row_out = FloatArray3DView_at(out, j_x, j_y, 0);
+
+        for (j_z = 0; j_z < N_z_out; ++j_z)
+        {
+            /* Interpolate along z, then y, then x */
+            i_lo = z_lo[j_z]*in->stride[2];
+            i_hi = z_hi[j_z]*in->stride[2];
+            v_lo = row_00[i_lo];
+            v_hi = row_00[i_hi];
+            c_00 = v_lo + wz[j_z]*(v_hi - v_lo);
+            v_lo = row_01[i_lo];
+            v_hi = row_01[i_hi];
+            c_01 = v_lo + wz[j_z]*(v_hi - v_lo);
+            v_lo = row_10[i_lo];
+            v_hi = row_10[i_hi];
+            c_10 = v_lo + wz[j_z]*(v_hi - v_lo);
+            v_lo = row_11[i_lo];
+            v_hi = row_11[i_hi];
+            c_11 = v_lo + wz[j_z]*(v_hi - v_lo);
+
+            c_00 = c_00 + wy[j_y]*(c_01 - c_00);
+            c_10 = c_10 + wy[j_y]*(c_11 - c_10);
+            row_out[j_z*out->stride[2]] = c_00 + wx[j_x]*(c_10 - c_00);
+        }
+    }
+
+    free((void *) x_lo);
+    free((void *) x_hi);
+    free((void *) y_lo);
+    free((void *) y_hi);
+    free((void *) z_lo);
+    free((void *) z_hi);
+    free((void *) wx);
+    free((void *) wy);
+    free((void *) wz);
+}
+
+/**
+ *      Box downsampling of the image in[N_x_in][N_y_in][N_z_in] to out[N_x_out][N_y_out][N_z_out],
+ *      with N_out <= N_in along each axis. Each output voxel is the mean of the input voxels under it,
+ *      with the voxels on the border of its footprint weighted by their overlap, so the grids span
+ *      the same extent and the image mean is kept.
+ */
+void resizeImageBox(struct FloatArray3DView *out, long int N_x_out, long int N_y_out, long int N_z_out, struct FloatArray3DView *in, long int N_x_in, long int N_y_in, long int N_z_in)
+{
+    long int j_x, j_y, j_z, i_x, i_y, i_z, T_x, T_y, T_z, *x_start, *x_count, *y_start, *y_count, *z_start, *z_count;
+    float *wx, *wy, *wz, w_xy, sum;
+
+    /* Most input voxels a cell of width N_in/N_out can overlap */
+    T_x = (N_x_in + N_x_out - 1) / N_x_out + 1;
+    T_y = (N_y_in + N_y_out - 1) / N_y_out + 1;
+    T_z = (N_z_in + N_z_out - 1) / N_z_out + 1;
+
+    x_start = (long int *) mget_spc(N_x_out, sizeof(long int));
+    x_count = (long int *) mget_spc(N_x_out, sizeof(long int));
+    y_start = (long int *) mget_spc(N_y_out, sizeof(long int));
+    y_count = (long int *) mget_spc(N_y_out, sizeof(long int));
+    z_start = (long int *) mget_spc(N_z_out, sizeof(long int));
+    z_count = (long int *) mget_spc(N_z_out, sizeof(long int));
+    wx = (float *) mget_spc(N_x_out*T_x, sizeof(float));
+    wy = (float *) mget_spc(N_y_out*T_y, sizeof(float));
+    wz = (float *) mget_spc(N_z_out*T_z, sizeof(float));
+    boxAveragingTable(x_start, x_count, wx, T_x, N_x_out, N_x_in);
+    boxAveragingTable(y_start, y_count, wy, T_y, N_y_out, N_y_in);
+    boxAveragingTable(z_start, z_count, wz, T_z, N_z_out, N_z_in);
+
+    #pragma omp parallel for collapse(2) private(j_z, i_x, i_y, i_z, w_xy, sum)
+    for (j_x = 0; j_x < N_x_out; ++j_x)
+    for (j_y = 0; j_y < N_y_out; ++j_y)
+    for (j_z = 0; j_z < N_z_out; ++j_z)
+    {
+        sum = 0;
+        for (i_x = 0; i_x < x_count[j_x]; ++i_x)
+        for (i_y = 0; i_y < y_count[j_y]; ++i_y)
+        {
+            w_xy = wx[j_x*T_x + i_x] * wy[j_y*T_y + i_y];
+            for (i_z = 0; i_z < z_count[j_z]; ++i_z)
+                sum += w_xy * wz[j_z*T_z + i_z] * *FloatArray3DView_at(in, x_start[j_x]+i_x, y_start[j_y]+i_y, z_start[j_z]+i_z);
+        }
+        *FloatArray3DView_at(out, j_x, j_y, j_z) = sum;
+    }
+
+    free((void *) x_start);
+    free((void *) x_count);
+    free((void *) y_start);
+    free((void *) y_count);
+    free((void *) z_start);
+    free((void *) z_count);
+    free((void *) wx);
+    free((void *) wy);
+    free((void *) wz);
+}
+
 void setFloatArray2Value(float *arr, long int len, float value)
 {
     long int i;
@@ -509,7 +1170,7 @@ void RandomAux_free(struct RandomAux *aux)
 
 
 
-void RandomZiplineAux_ShuffleGroupIndices(struct RandomZiplineAux *aux, struct ImageParams *imgParams)
+void RandomZiplineAux_ShuffleGroupIndices(struct RandomZiplineAux *aux, struct ImageParams *imgParams, struct RandomState *rng)
 {
     long int j_x, j_y, j_z, N_G, r;
 
@@ -525,12 +1186,12 @@ void RandomZiplineAux_ShuffleGroupIndices(struct RandomZiplineAux *aux, struct I
 
 
             /* random[1,N_G-1]*/
-            aux->groupIndex[j_x][j_y][0] = rand() % N_G;
+            aux->groupIndex[j_x][j_y][0] = RandomState_next(rng) % N_G;
 
             for (j_z = 1; j_z < imgParams->N_z; ++j_z) 
             {
                 /* r \in [1, ..., N_G-1] */
-                r = 1 + (rand() % (N_G-1)); 
+                r = 1 + (RandomState_next(rng) % (N_G-1)); 
                 /* next index is any of the other N_G-1 indices (uniformly random) */
                 aux->groupIndex[j_x][j_y][j_z] = (aux->groupIndex[j_x][j_y][j_z-1] + r) % N_G;
                 
@@ -539,7 +1200,7 @@ void RandomZiplineAux_ShuffleGroupIndices(struct RandomZiplineAux *aux, struct I
     }
 }
 
-void RandomZiplineAux_ShuffleGroupIndices_FixedDistance(struct RandomZiplineAux *aux, struct ImageParams *imgParams)
+void RandomZiplineAux_ShuffleGroupIndices_FixedDistance(struct RandomZiplineAux *aux, struct ImageParams *imgParams, struct RandomState *rng)
 {
     long int j_x, j_y, j_z, N_G, i;
     int *first_N_G_members;
@@ -559,7 +1220,7 @@ void RandomZiplineAux_ShuffleGroupIndices_FixedDistance(struct RandomZiplineAux
     {
         for (j_y = 0; j_y < imgParams->N_y; ++j_y)
         {
-            shuffleIntArray(first_N_G_members, N_G);
+            shuffleIntArray(first_N_G_members, N_G, rng);
 
             for (j_z = 0; j_z < imgParams->N_z; ++j_z)
             {
@@ -570,9 +1231,9 @@ void RandomZiplineAux_ShuffleGroupIndices_FixedDistance(struct RandomZiplineAux
     }
 }
 
-void RandomZiplineAux_shuffleOrderXY(struct RandomZiplineAux *aux, struct ImageParams *imgParams)
+void RandomZiplineAux_shuffleOrderXY(struct RandomZiplineAux *aux, struct ImageParams *imgParams, struct RandomState *rng)
 {
-    shuffleIntArray(aux->orderXY, imgParams->N_x*imgParams->N_y);
+    shuffleIntArray(aux->orderXY, imgParams->N_x*imgParams->N_y, rng);
 }
 
 
@@ -588,7 +1249,32 @@ void indexExtraction2D(long int j_xy, long int *j_x, long int N_x, long int *j_y
 }
 
 
-void shuffleIntArray(int *arr, long int len)
+/* Seeds rng. Different seeds give independent sequences. */
+void RandomState_seed(struct RandomState *rng, unsigned long long int seed)
+{
+    /* splitmix64 step, so that small or similar seeds give well mixed, nonzero states */
+    seed += 0x9E3779B97F4A7C15ULL;
+    seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBULL;
+    seed = seed ^ (seed >> 31);
+    rng->state = seed != 0 ? seed : 1;
+}
+
+/* Uniform random integer in [0, RANDOMSTATE_MAX] */
+long int RandomState_next(struct RandomState *rng)
+{
+    unsigned long long int x;
+
+    x = rng->state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    rng->state = x;
+
+    return (long int) ((x * 0x2545F4914F6CDD1DULL) >> 33);
+}
+
+void shuffleIntArray(int *arr, long int len, struct RandomState *rng)
 {
     int target_idx, candidate_idx, target, candidate;
 
@@ -596,7 +1282,7 @@ void shuffleIntArray(int *arr, long int len)
     
     for (target_idx = 0; target_idx < len-1; target_idx++)
     {
-        candidate_idx = target_idx + (rand() % (len-target_idx));
+        candidate_idx = target_idx + (RandomState_next(rng) % (len-target_idx));
 
         /* Swap target and candidate */
         candidate = arr[candidate_idx];
@@ -606,7 +1292,7 @@ void shuffleIntArray(int *arr, long int len)
     }
 }
 
-void shuffleLongIntArray(long int *arr, long int len)
+void shuffleLongIntArray(long int *arr, long int len, struct RandomState *rng)
 {
     long int target_idx, candidate_idx, target, candidate;
 
@@ -614,7 +1300,7 @@ void shuffleLongIntArray(long int *arr, long int len)
     
     for (target_idx = 0; target_idx < len-1; target_idx++)
     {
-        candidate_idx = target_idx + (rand() % (len-target_idx));
+        candidate_idx = target_idx + (RandomState_next(rng) % (len-target_idx));
 
         /* Swap target and candidate */
         candidate = arr[candidate_idx];
@@ -632,7 +1318,7 @@ void shuffleLongIntArray(long int *arr, long int len)
  *      bernoulli(P/100)==1 is true with probability P[%]
  */     
         
-int bernoulli(float p)
+int bernoulli(float p, struct RandomState *rng)
 {
     float r;
     if(p==0)
@@ -641,19 +1327,19 @@ int bernoulli(float p)
     if(p==1)
         return 1;
 
-    r = ((float) rand() / (RAND_MAX));
+    r = ((float) RandomState_next(rng) / (RANDOMSTATE_MAX));
     if(r<p)
         return 1;
     else
         return 0;
 }
 
-long int uniformIntegerRV(long int l, long int h)
+long int uniformIntegerRV(long int l, long int h, struct RandomState *rng)
 {
-    return l+rand()%(h-l+1);
+    return l+RandomState_next(rng)%(h-l+1);
 }
 
-long int almostUniformIntegerRV(float mean, int sigma)
+long int almostUniformIntegerRV(float mean, int sigma, struct RandomState *rng)
 {
     /* creates random integer, Z, variable that is approx uniform in [mean-sigma, mean+sigma] */
     /* "mean" corresponds to the real expectation of Z*/
@@ -664,10 +1350,10 @@ long int almostUniformIntegerRV(float mean, int sigma)
 
     mean_low = floor(mean);
     mean_high = ceil(mean);
-    X_low = uniformIntegerRV(mean_low-sigma, mean_low+sigma);
-    X_high = uniformIntegerRV(mean_high-sigma, mean_high+sigma);
+    X_low = uniformIntegerRV(mean_low-sigma, mean_low+sigma, rng);
+    X_high = uniformIntegerRV(mean_high-sigma, mean_high+sigma, rng);
 
-    b = bernoulli(mean_high-mean);
+    b = bernoulli(mean_high-mean, rng);
 
     return b*X_low + (1-b)*X_high;
 }
@@ -1035,6 +1721,10 @@ void printReconParams(struct ReconParams *params)
 
     printf("\tverbosity = %d \n", params->verbosity);
     printf("\tisComputeCost = %d \n", params->isComputeCost);
+    printf("\ttheta2CacheMode = %d \n", params->theta2CacheMode);
+    printf("\tweightType = %d \n", params->weightType);
+    printf("\terrorSinoType = %d \n", params->errorSinoType);
+    printf("\tisCheckSinoPrecision = %d \n", params->isCheckSinoPrecision);
 
 }
 
@@ -1053,5 +1743,14 @@ void printSysMatrixParams(struct SysMatrix *A)
     printf("\tC_ij_max = %e \n", A->C_ij_max);
     printf("\tB_ij_scaler = %e \n", A->B_ij_scaler);
     printf("\tC_ij_scaler = %e \n", A->C_ij_scaler);
+    printf("\tN_betaStored = %ld \n", A->N_betaStored);
+    printf("\tviewSymmetry = %d \n", A->viewSymmetry);
+    printf("\tisOnTheFly = %d \n", A->isOnTheFly);
+    printf("\tB_type = %d \n", A->B_type);
+    printf("\tC_type = %d \n", A->C_type);
+    printf("\tindexStartStop_type = %d \n", A->indexStartStop_type);
+    printf("\tindexStride_type = %d \n", A->indexStride_type);
+    printf("\tdescriptor_type = %d \n", A->descriptor_type);
+    printf("\tcolumnsSize = %ld \n", A->columnsSize);
 
 }
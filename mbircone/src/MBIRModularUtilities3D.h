@@ -8,6 +8,7 @@
 #include <string.h>
 #include <omp.h>
 #include "allocate.h"
+#include "simdKernels.h"
 
 #define OUTPUT_REFRESH_TIME 1.0
 
@@ -20,43 +21,148 @@
 
 #define PI 3.1415926535897932384
 
-/* WEIGHTCHANGE */
-#define WEIGHTDATATYPE float
-#define WEIGHTDATATYPE_string "float"
-/*#define WEIGHTDATATYPE unsigned char
-#define WEIGHTDATATYPE_string "unsigned char"*/
-
 #define AMATRIX_RHO 4.0 /* System Matrix parameter rho*/
 
 /* AMATRIXCHANGE */
-#define ISBIJCOMPRESSED 1       /* 1: used compressed mode, 0: use uncompressed mode */
-#if ISBIJCOMPRESSED == 1
-    #define BIJDATATYPE unsigned char
-    #define BIJDATATYPE_string "unsigned char"
-#else
-    #define BIJDATATYPE float
-    #define BIJDATATYPE_string "float"
-#endif
-
-#define ISCIJCOMPRESSED 1       /* 1: used compressed mode, 0: use uncompressed mode */
-#if ISCIJCOMPRESSED == 1
-    #define CIJDATATYPE unsigned char
-    #define CIJDATATYPE_string "unsigned char"
-#else
-    #define CIJDATATYPE float
-    #define CIJDATATYPE_string "float"
-#endif
+/**
+ *      Data types of the stored B and C coefficients, chosen when the system matrix is computed.
+ *      Integer types are compressed: B_ij_true = B_ij * B_ij_scaler with B_ij_scaler = B_ij_max / (largest integer).
+ *      The sinogram weights (uint8, float16 or float32) and the error sinogram (float16, bfloat16 or float32)
+ *      are stored with the same types, see struct Sino.
+ */
+#define COEFF_TYPE_UINT8    0
+#define COEFF_TYPE_UINT16   1
+#define COEFF_TYPE_FLOAT32  2
+#define COEFF_TYPE_FLOAT16  3
+#define COEFF_TYPE_BFLOAT16 4
+
+/* Size in bytes of a coefficient of type COEFF_TYPE_* */
+static inline size_t coeffTypeSize(int type)
+{
+    switch (type)
+    {
+        case COEFF_TYPE_UINT8:
+            return sizeof(unsigned char);
+        case COEFF_TYPE_UINT16:
+        case COEFF_TYPE_FLOAT16:
+        case COEFF_TYPE_BFLOAT16:
+            return sizeof(unsigned short);
+        default:
+            return sizeof(float);
+    }
+}
+
+/* Coefficient k of an array of coefficients of type COEFF_TYPE_*, without the scaler */
+static inline float getCoeff(const void *data, int type, long int k)
+{
+    switch (type)
+    {
+        case COEFF_TYPE_UINT8:
+            return ((const unsigned char *) data)[k];
+        case COEFF_TYPE_UINT16:
+            return ((const unsigned short *) data)[k];
+        case COEFF_TYPE_FLOAT16:
+            return halfToFloat(((const unsigned short *) data)[k]);
+        case COEFF_TYPE_BFLOAT16:
+            return bfloat16ToFloat(((const unsigned short *) data)[k]);
+        default:
+            return ((const float *) data)[k];
+    }
+}
+
+/**
+ *      Scaler that maps the largest coefficient to the largest value of an integer coefficient type,
+ *      or to 1 for float16, whose precision is relative but whose range is small.
+ */
+static inline float coeffScaler(int type, float coeffMax)
+{
+    if (coeffMax <= 0)
+        return 1;
+    switch (type)
+    {
+        case COEFF_TYPE_UINT8:   return coeffMax / 255;
+        case COEFF_TYPE_UINT16:  return coeffMax / 65535;
+        case COEFF_TYPE_FLOAT16: return coeffMax;
+        default:                 return 1;
+    }
+}
+
+/* Store coefficient k of data, rounded to the nearest value of the coefficient type */
+static inline void setCoeff(void *data, int type, long int k, float value, float scaler)
+{
+    switch (type)
+    {
+        case COEFF_TYPE_UINT8:    ((unsigned char *) data)[k] = (value / scaler) + 0.5; break;
+        case COEFF_TYPE_UINT16:   ((unsigned short *) data)[k] = (value / scaler) + 0.5; break;
+        case COEFF_TYPE_FLOAT16:  ((unsigned short *) data)[k] = floatToHalf(value / scaler); break;
+        case COEFF_TYPE_BFLOAT16: ((unsigned short *) data)[k] = floatToBfloat16(value / scaler); break;
+        default:                  ((float *) data)[k] = value / scaler; break;
+    }
+}
+
+/**
+ *      Coefficients k .. k+n-1 of data times scaler as floats. For float32 data with scaler 1 this is
+ *      the data itself, otherwise they are decoded into buffer[n].
+ */
+static inline const float *getCoeffRow(const void *data, int type, float scaler, long int k, long int n, float *buffer)
+{
+    long int q;
+
+    switch (type)
+    {
+        case COEFF_TYPE_UINT8:
+            simd_rowDecodeUint8(buffer, (const unsigned char *) data + k, scaler, n);
+            return buffer;
+        case COEFF_TYPE_FLOAT16:
+            simd_rowDecodeHalf(buffer, (const unsigned short *) data + k, scaler, n);
+            return buffer;
+        case COEFF_TYPE_BFLOAT16:
+            simd_rowDecodeBfloat16(buffer, (const unsigned short *) data + k, scaler, n);
+            return buffer;
+        case COEFF_TYPE_FLOAT32:
+            if (scaler == 1)
+                return (const float *) data + k;
+            /* fall through */
+        default:
+            for (q = 0; q < n; ++q)
+                buffer[q] = scaler * getCoeff(data, type, k + q);
+            return buffer;
+    }
+}
+
+/* Store values[0 .. n-1] as coefficients k .. k+n-1 of data, as setCoeff() does. Nothing to do if values is the float32 data itself. */
+static inline void setCoeffRow(void *data, int type, float scaler, long int k, long int n, const float *values)
+{
+    long int q;
+
+    switch (type)
+    {
+        case COEFF_TYPE_FLOAT16:
+            simd_rowEncodeHalf((unsigned short *) data + k, values, 1 / scaler, n);
+            break;
+        case COEFF_TYPE_BFLOAT16:
+            simd_rowEncodeBfloat16((unsigned short *) data + k, values, 1 / scaler, n);
+            break;
+        case COEFF_TYPE_FLOAT32:
+            if (values == (const float *) data + k)
+                break;
+            /* fall through */
+        default:
+            for (q = 0; q < n; ++q)
+                setCoeff(data, type, k + q, values[q], scaler);
+            break;
+    }
+}
 
 /* MATRIXINDEXCHANGE */
-#define INDEXSTARTSTOPDATATYPE unsigned short
-#define INDEXSTARTSTOPDATATYPE_string "unsigned short"
-
-#define INDEXJUDATATYPE unsigned short
-#define INDEXJUDATATYPE_string "unsigned short"
-
-/* INDEXSTRIDE */
-#define INDEXSTRIDEDATATYPE unsigned char
-#define INDEXSTRIDEDATATYPE_string "unsigned char"
+/**
+ *      Data types of the stored index arrays, chosen when the system matrix is computed.
+ *      i_wstart, i_wstride and the B column descriptors each use the narrowest type that holds
+ *      their largest value for the geometry (see chooseIndexType in computeSysMatrix.c).
+ */
+#define INDEX_TYPE_UINT8    0
+#define INDEX_TYPE_UINT16   1
+#define INDEX_TYPE_UINT32   2
 
 /* Added by Diyu for indexing flattened 3D array with 3D index */
 #define index_3D(i, j, k, Ny, Nz) (i*Ny*Nz+j*Nz+k)
@@ -89,6 +195,18 @@ struct RandomZiplineAux
     unsigned char ***groupIndex;           
 };
 
+/**
+ *      State of the random number generator of one reconstruction (xorshift64*).
+ *      Kept per reconstruction and per thread instead of using rand(), so that reconstructions
+ *      in different threads do not share state and each one gives the same result as if run alone.
+ */
+struct RandomState
+{
+    unsigned long long int state;
+};
+
+#define RANDOMSTATE_MAX 2147483647
+
 struct RandomAux
 {
     /**
@@ -172,6 +290,7 @@ struct Image
     unsigned char ***timeToChange;
     float ***projInput;
     float ***backprojlikeOutput;
+    float *theta2Cache;     /* [N_x][N_y][N_z] A_{*,j}^t W A_{*,j} without weightScaler; <0 if not computed yet; NULL if not used */
     struct RandomZiplineAux randomZiplineAux;
     struct RandomAux randomAux;
 };
@@ -208,18 +327,111 @@ struct SinoParams
 };
 
 
+/**
+ *      Caller owned 3D float array in any memory layout, e.g. a NumPy array in its Python axis order.
+ *      Element (i_0,i_1,i_2), in the index order of the C array it stands for, is data[i_0*stride[0] + i_1*stride[1] + i_2*stride[2]].
+ */
+struct FloatArray3DView
+{
+    float *data;            /* NULL if there is no array */
+    long int stride[3];     /* in elements */
+};
+
+static inline float *FloatArray3DView_at(struct FloatArray3DView *arr, long int i_0, long int i_1, long int i_2)
+{
+    return arr->data + i_0*arr->stride[0] + i_1*arr->stride[1] + i_2*arr->stride[2];
+}
+
+/* 1 if all elements of arr are the same element, as for a broadcast scalar */
+static inline char FloatArray3DView_isConstant(struct FloatArray3DView *arr)
+{
+    return arr->data != NULL && arr->stride[0] == 0 && arr->stride[1] == 0 && arr->stride[2] == 0;
+}
+
+/* View of the contiguous C array data[N_0][N_1][N_2] */
+static inline struct FloatArray3DView FloatArray3DView_contiguous(float *data, long int N_1, long int N_2)
+{
+    struct FloatArray3DView arr;
+
+    arr.data = data;
+    arr.stride[0] = N_1*N_2;
+    arr.stride[1] = N_2;
+    arr.stride[2] = 1;
+    return arr;
+}
+
+/* Channels i_wstart .. i_wstop-1 of a detector row */
+struct ChannelRun
+{
+    long int i_wstart;
+    long int i_wstop;
+};
+
 struct Sino
 {
     struct SinoParams params;
-    float *vox;       /* [N_beta][N_dv][N_dw] */
-    WEIGHTDATATYPE *wgt;
-    float *e;
+    struct FloatArray3DView vox;    /* [N_beta][N_dv][N_dw], measured sinogram y in the layout of the caller */
+
+    /**
+     *      Weights of type wgtType (COEFF_TYPE_FLOAT32, _FLOAT16 or _UINT8), scaled per view: the weight of
+     *      entry i in view i_beta is wgtScale[i_beta]*getCoeff(wgt, wgtType, i), see sinoWeight().
+     *      wgtScale is NULL for float32 weights. wgt is NULL if all entries have weight wgtValue, e.g. for unweighted reconstruction.
+     */
+    void *wgt;
+    int wgtType;
+    float *wgtScale;            /* [N_beta] */
+    float wgtValue;
+
+    /* Error sinogram e = y - Ax of type eType (COEFF_TYPE_FLOAT32, _FLOAT16 or _BFLOAT16), see sinoError() */
+    void *e;
+    int eType;
     float ***projOutput;
     float ***backprojlikeInput;
 
-
+    /**
+     *      Runs of detector channels with nonzero weight, set up by computeWeightRuns() for the ICD updates,
+     *      which skip the channels outside the runs. The runs of row (i_beta,i_v) are
+     *      wgtRun[rowRunIndex[r]] .. wgtRun[rowRunIndex[r+1]-1] with r = i_beta*N_dv + i_v.
+     */
+    long int *rowRunIndex;      /* [N_beta*N_dv+1] */
+    struct ChannelRun *wgtRun;
 };
 
+/* Row index of (i_beta,i_v) in sino->e and sino->wgt, i.e. (i_beta,i_v,i_w) is at sinoRowIndex(...)*N_dw + i_w */
+static inline long int sinoRowIndex(struct Sino *sino, long int i_beta, long int i_v)
+{
+    return i_beta*sino->params.N_dv + i_v;
+}
+
+/* Scaler of the stored weights of view i_beta */
+static inline float sinoWeightScale(struct Sino *sino, long int i_beta)
+{
+    return (sino->wgtScale != NULL) ? sino->wgtScale[i_beta] : 1;
+}
+
+/* Weight of entry i of sino->wgt in view i_beta; i indexes the rows as sino->wgt does */
+static inline float sinoWeight(struct Sino *sino, long int i_beta, long int i)
+{
+    return (sino->wgt != NULL) ? sinoWeightScale(sino, i_beta) * getCoeff(sino->wgt, sino->wgtType, i) : sino->wgtValue;
+}
+
+/* Entry i of sino->e */
+static inline float sinoError(struct Sino *sino, long int i)
+{
+    return getCoeff(sino->e, sino->eType, i);
+}
+
+static inline void sinoSetError(struct Sino *sino, long int i, float value)
+{
+    setCoeff(sino->e, sino->eType, i, value, 1);
+}
+
+/* Index of the first run of nonzero weight of row (i_beta,i_v) in sino->wgtRun; the runs of rows i_v .. i_v'-1 end at the first run of row i_v' */
+static inline long int sinoRunIndex(struct Sino *sino, long int i_beta, long int i_v)
+{
+    return sino->rowRunIndex[i_beta*sino->params.N_dv + i_v];
+}
+
 struct ViewAngleList
 {
     long int N_beta;
@@ -256,7 +468,7 @@ struct ReconParams
 
     /* Zipline Parameters */
     int N_G;                /* Number of groups for group ICD */
-    int zipLineMode;            /* Zipline mode: (0: off, 1: conventional Zipline, 2: randomized Zipline) */
+    int zipLineMode;            /* Zipline mode: (0: off, 1: conventional Zipline, 2: randomized Zipline, 4: randomized Zipline over several columns in parallel) */
     int numVoxelsPerZiplineMax;
     int numVoxelsPerZipline;
     int numZiplines;
@@ -275,6 +487,14 @@ struct ReconParams
     /* Misc Parameters */
     int verbosity;        /* 0: minimum output; 1: intermediate output; 2: most output */
     int isComputeCost;
+
+    /* Theta2 cache Parameters */
+    int theta2CacheMode;    /* theta2 cache: (0: off, 1: filled on first visit of each voxel, 2: precomputed in parallel) */
+
+    /* Sinogram storage Parameters */
+    int weightType;             /* Stored weights: COEFF_TYPE_FLOAT32, COEFF_TYPE_FLOAT16 or COEFF_TYPE_UINT8 */
+    int errorSinoType;          /* Stored error sinogram: COEFF_TYPE_FLOAT32, COEFF_TYPE_FLOAT16 or COEFF_TYPE_BFLOAT16 */
+    int isCheckSinoPrecision;   /* 1: report the error of compact weights and error sinogram against float32 */
 };
 
 
@@ -293,18 +513,208 @@ struct SysMatrix
     float u_0;
     float u_1;
 
-    BIJDATATYPE ***B;                   /* [N_x][N_y][N_beta*i_vstride_max]  */
-    INDEXSTARTSTOPDATATYPE ***i_vstart; /* [N_x][N_y][N_beta]           */
-    INDEXSTRIDEDATATYPE ***i_vstride;   /* [N_x][N_y][N_beta]           */
-    INDEXJUDATATYPE ***j_u;             /* [N_x][N_y][N_beta]           */
+    /**
+     *      View symmetry: if viewSymmetry != 0, only the first N_betaStored = N_beta/4 views are stored.
+     *      View i_beta+N_betaStored of voxel (j_x,j_y) is view i_beta of the voxel rotated by
+     *      viewSymmetry*90 degrees about the center of the N_xy x N_xy grid (see SysMatrix_getBColumn).
+     */
+    long int N_betaStored;
+    long int N_xy;
+    int viewSymmetry;   /* 0: none, +1/-1: views N_beta/4 apart differ by +90/-90 degrees */
 
-    CIJDATATYPE **C;                    /* [N_u][N_z*i_wstride_max]          */
-    INDEXSTARTSTOPDATATYPE **i_wstart;  /* [N_u][N_z]                   */
-    INDEXSTRIDEDATATYPE **i_wstride;    /* [N_u][N_z]                   */
+    /**
+     *      On-the-fly mode: if isOnTheFly != 0, the B columns are not stored (columnOffset and columns are NULL)
+     *      and each B column is computed from the geometry when it is looked up. C is always stored.
+     */
+    char isOnTheFly;
+    struct SinoParams sinoParams;       /* geometry used in on-the-fly mode */
+    struct ImageParams imgParams;
+    float *beta;                        /* [N_beta], NULL if not on the fly */
+    float *cosBeta;                     /* [N_beta] */
+    float *sinBeta;                     /* [N_beta] */
+
+    int B_type;                         /* COEFF_TYPE_* of B */
+    int C_type;                         /* COEFF_TYPE_* of C */
+    int indexStartStop_type;            /* INDEX_TYPE_* of i_wstart */
+    int indexStride_type;               /* INDEX_TYPE_* of i_wstride */
+    int descriptor_type;                /* INDEX_TYPE_* of the B column descriptors */
 
+    /**
+     *      B is stored as one packed block per voxel column (j_x,j_y), starting at byte columnOffset[j_x*N_y+j_y]
+     *      of columns. A block holds N_betaStored descriptors {i_vstart, i_vstride, j_u, B offset} of type
+     *      descriptor_type, padded to descriptorsSize bytes, followed by the B coefficients of all its views.
+     *      View i_beta has i_vstride coefficients of type B_type, starting at coefficient B offset.
+     */
+    long int N_y;
+    long int descriptorsSize;
+    long int columnsSize;               /* size of columns in bytes */
+    long int *columnOffset;             /* [N_x*N_y] */
+    char *columns;
+    char isColumnsMapped;               /* 1: columnOffset and columns point into the mapped file */
+
+    void **C;                           /* [N_u][N_z*i_wstride_max] elements of type C_type */
+    void **i_wstart;                    /* [N_u][N_z] elements of type indexStartStop_type */
+    void **i_wstride;                   /* [N_u][N_z] elements of type indexStride_type */
+
+    /* Not stored in the file: */
+    char isMapped;                      /* 1: arrays point into a memory mapped file, 0: arrays are allocated */
+    void *mapAddress;
+    size_t mapLength;
+};
 
+/* Size in bytes of an index of type INDEX_TYPE_* */
+static inline size_t indexTypeSize(int type)
+{
+    switch (type)
+    {
+        case INDEX_TYPE_UINT8:
+            return sizeof(unsigned char);
+        case INDEX_TYPE_UINT16:
+            return sizeof(unsigned short);
+        default:
+            return sizeof(unsigned int);
+    }
+}
+
+/* Index k of an array of indices of type INDEX_TYPE_* */
+static inline long int getIndex(const void *data, int type, long int k)
+{
+    switch (type)
+    {
+        case INDEX_TYPE_UINT8:
+            return ((const unsigned char *) data)[k];
+        case INDEX_TYPE_UINT16:
+            return ((const unsigned short *) data)[k];
+        default:
+            return ((const unsigned int *) data)[k];
+    }
+}
+
+/* Fields of a B column descriptor */
+#define BCOLUMN_DESCRIPTOR_LENGTH   4
+#define BCOLUMN_DESCRIPTOR_VSTART   0
+#define BCOLUMN_DESCRIPTOR_VSTRIDE  1
+#define BCOLUMN_DESCRIPTOR_JU       2
+#define BCOLUMN_DESCRIPTOR_BOFFSET  3
+
+/* First detector column i_wstart[j_u][j_z] of the footprint of (j_u,j_z) */
+static inline long int SysMatrix_getWStart(struct SysMatrix *A, long int j_u, long int j_z)
+{
+    return getIndex(A->i_wstart[j_u], A->indexStartStop_type, j_z);
+}
+
+/* Number of detector columns i_wstride[j_u][j_z] in the footprint of (j_u,j_z) */
+static inline long int SysMatrix_getWStride(struct SysMatrix *A, long int j_u, long int j_z)
+{
+    return getIndex(A->i_wstride[j_u], A->indexStride_type, j_z);
+}
+
+/* Largest i_vstride supported in on-the-fly mode */
+#define BCOLUMN_BUFFER_SIZE 1024
+
+/* Footprint of voxel column (j_x,j_y) in view i_beta: B_ij = B_ij_scaler*B[i_v-i_vstart] for i_vstart <= i_v < i_vstart+i_vstride */
+struct BColumn
+{
+    long int i_vstart;
+    long int i_vstride;
+    long int j_u;
+    const void *B;      /* [i_vstride] elements of type B_type */
+    float buffer[BCOLUMN_BUFFER_SIZE];      /* B points here in on-the-fly mode, holds any coefficient type */
 };
 
+/* B_ij of detector row i_v in a B column */
+static inline float BColumn_getB(struct SysMatrix *A, struct BColumn *col, long int i_v)
+{
+    return A->B_ij_scaler * getCoeff(col->B, A->B_type, i_v - col->i_vstart);
+}
+
+/* Row of C for (j_u,j_z): C_ij = C_ij_scaler*getCoeff(C_row, C_type, i_w-i_wstart[j_u][j_z]) */
+static inline const void *SysMatrix_getCRow(struct SysMatrix *A, long int j_u, long int j_z)
+{
+    return (const char *) A->C[j_u] + j_z*A->i_wstride_max*coeffTypeSize(A->C_type);
+}
+
+/* C_ij of (j_u,j_z) at detector column i_w, for i_wstart[j_u][j_z] <= i_w < i_wstart[j_u][j_z]+i_wstride[j_u][j_z] */
+static inline float SysMatrix_getC(struct SysMatrix *A, long int j_u, long int j_z, long int i_w)
+{
+    return A->C_ij_scaler * getCoeff(SysMatrix_getCRow(A, j_u, j_z), A->C_type, i_w - SysMatrix_getWStart(A, j_u, j_z));
+}
+
+/* Compute the B column of (j_x,j_y,i_beta) from the geometry, for on-the-fly mode (see computeSysMatrix.c) */
+void SysMatrix_computeBColumn(struct SysMatrix *A, long int j_x, long int j_y, long int i_beta, struct BColumn *col);
+
+/* Look up the B column of (j_x,j_y,i_beta), mapping i_beta to a stored view if the matrix uses view symmetry */
+static inline void SysMatrix_getBColumn(struct SysMatrix *A, long int j_x, long int j_y, long int i_beta, struct BColumn *col)
+{
+    long int numQuarterTurns, temp, k, B_offset;
+    const char *column;
+    const unsigned char *d_8;
+    const unsigned short *d_16;
+    const unsigned int *d_32;
+
+    if (A->isOnTheFly)
+    {
+        SysMatrix_computeBColumn(A, j_x, j_y, i_beta, col);
+        return;
+    }
+
+    if (A->viewSymmetry != 0)
+    {
+        numQuarterTurns = i_beta / A->N_betaStored;
+        i_beta -= numQuarterTurns*A->N_betaStored;
+        if (A->viewSymmetry < 0)
+            numQuarterTurns = (4 - numQuarterTurns) % 4;
+
+        /* rotate (j_x,j_y) by numQuarterTurns*90 degrees: (j_x,j_y) -> (N_xy-1-j_y, j_x) per turn */
+        switch (numQuarterTurns)
+        {
+            case 1:
+                temp = j_x;
+                j_x = A->N_xy-1-j_y;
+                j_y = temp;
+                break;
+            case 2:
+                j_x = A->N_xy-1-j_x;
+                j_y = A->N_xy-1-j_y;
+                break;
+            case 3:
+                temp = j_x;
+                j_x = j_y;
+                j_y = A->N_xy-1-temp;
+                break;
+        }
+    }
+
+    /* one descriptor and the coefficients it points to, both in the block of the column */
+    column = A->columns + A->columnOffset[j_x*A->N_y + j_y];
+    k = i_beta*BCOLUMN_DESCRIPTOR_LENGTH;
+    switch (A->descriptor_type)
+    {
+        case INDEX_TYPE_UINT8:
+            d_8 = (const unsigned char *) column + k;
+            col->i_vstart = d_8[BCOLUMN_DESCRIPTOR_VSTART];
+            col->i_vstride = d_8[BCOLUMN_DESCRIPTOR_VSTRIDE];
+            col->j_u = d_8[BCOLUMN_DESCRIPTOR_JU];
+            B_offset = d_8[BCOLUMN_DESCRIPTOR_BOFFSET];
+            break;
+        case INDEX_TYPE_UINT16:
+            d_16 = (const unsigned short *) column + k;
+            col->i_vstart = d_16[BCOLUMN_DESCRIPTOR_VSTART];
+            col->i_vstride = d_16[BCOLUMN_DESCRIPTOR_VSTRIDE];
+            col->j_u = d_16[BCOLUMN_DESCRIPTOR_JU];
+            B_offset = d_16[BCOLUMN_DESCRIPTOR_BOFFSET];
+            break;
+        default:
+            d_32 = (const unsigned int *) column + k;
+            col->i_vstart = d_32[BCOLUMN_DESCRIPTOR_VSTART];
+            col->i_vstride = d_32[BCOLUMN_DESCRIPTOR_VSTRIDE];
+            col->j_u = d_32[BCOLUMN_DESCRIPTOR_JU];
+            B_offset = d_32[BCOLUMN_DESCRIPTOR_BOFFSET];
+            break;
+    }
+    col->B = column + A->descriptorsSize + B_offset*coeffTypeSize(A->B_type);
+}
+
 
 struct ICDInfo3DCone
 {
@@ -341,11 +751,27 @@ struct PartialTheta
     float t2;
 };
 
+/* State of a column in the zipLineMode 4 schedule */
+#define COLUMN_PENDING      0
+#define COLUMN_BUSY         1
+#define COLUMN_DONE         2
+
+/* claimColumn results that are not a column index */
+#define COLUMN_NONE_FREE    -1
+#define COLUMN_ALL_CLAIMED  -2
+
+/* Locks of the detector rows of a compact error sinogram in zipLineMode 4, row i uses lock i % ERRORSINO_ROW_LOCKS */
+#define ERRORSINO_ROW_LOCKS 1024
+
 struct ParallelAux
 {
     int numThreads;
     int N_M_max;
     struct PartialTheta **partialTheta;     /* [numThreads][N_M_max] */
+    float **wProfile;                       /* [numThreads][N_dw] row buffers of the zipline kernels */
+    float **wProfile2;                      /* [numThreads][N_dw] */
+    float **eRow;                           /* [numThreads][N_dw] decoded rows of a compact error sinogram */
+    float **wRow;                           /* [numThreads][N_dw] decoded rows of compact weights */
     long int *j_u;
     long int *i_v;
     float *B_ij;
@@ -353,6 +779,12 @@ struct ParallelAux
     long int *j_z;
     long int *i_w;
     float *A_ij;
+    struct ICDInfo3DCone **icdInfo;         /* [numThreads][N_M_max] members of each thread's column (zipLineMode 4 only) */
+    struct ReconAux *reconAux;              /* [numThreads] reconAux of each thread (zipLineMode 4 only) */
+    char *columnState;                      /* [N_x*N_y] COLUMN_PENDING, COLUMN_BUSY or COLUMN_DONE (zipLineMode 4 only) */
+    long int i_orderFirst;                  /* entries of orderXY before it are claimed (zipLineMode 4 only) */
+    long int numColumnsReleased;            /* columns finished in this iteration, read by threads waiting for a free column (zipLineMode 4 only) */
+    omp_lock_t *errorSinoRowLocks;          /* [ERRORSINO_ROW_LOCKS] locks of the rows of a compact error sinogram (zipLineMode 4 only) */
 };
 
 struct SpeedAuxICD
@@ -393,12 +825,18 @@ struct ReconAux
 
     float NHICD_neighborFilter[3][3];
 
+    struct RandomState rng;
+
 };
 
 
 void forwardProject3DCone( float *Ax, float *x, struct ImageParams *imgParams, struct SysMatrix *A, struct SinoParams *sinoParams);
 
-void backProjectlike3DCone( float ***x_out, float ***y_in, struct ImageParams *imgParams, struct SysMatrix *A, struct SinoParams *sinoParams, char mode);
+void computeErrorSino3DCone(struct Sino *sino, float *x, struct ImageParams *imgParams, struct SysMatrix *A);
+
+void subtractForwardProject3DCone(struct Sino *sino, float *deltaX, struct ImageParams *imgParams, struct SysMatrix *A);
+
+void backProjectlike3DCone( float *x_out, float *y_in, struct ImageParams *imgParams, struct SysMatrix *A, struct SinoParams *sinoParams, char mode);
 
 void computeSecondaryReconParams(struct ReconParams *reconParams, struct ImageParams *imgParams);
 
@@ -408,7 +846,21 @@ float computeNormSquaredFloatArray(float *arr, long int len);
 
 float computeRelativeRMSEFloatArray(float *arr1, float *arr2, long int len);
 
-float computeSinogramWeightedNormSquared(struct Sino *sino, float *arr);
+float computeErrorSinoWeightedNormSquared(struct Sino *sino);
+
+void computeMeasuredSinoNormsSquared(struct Sino *sino, float *weightedNormSquared, float *normSquared);
+
+float computeErrorSinoLiveNormSquared(struct Sino *sino);
+
+float computeErrorSinoRelativeError(struct Sino *sino, float *x, struct ImageParams *imgParams, struct SysMatrix *A);
+
+void setSinoViewWeights(struct Sino *sino, long int i_beta, const float *w);
+
+float setSinoWeights(struct Sino *sino, struct FloatArray3DView *wght);
+
+void computeWeightRuns(struct Sino *sino);
+
+void freeWeightRuns(struct Sino *sino);
 
 char isInsideMask(long int i_1, long int i_2, long int N1, long int N2);
 
@@ -422,6 +874,14 @@ void applyMask3D(float ***arr, long int N1, long int N2, long int N3);
 
 void floatArray_z_equals_aX_plus_bY(float *Z, float a, float *X, float b, float *Y, long int len);
 
+void floatArray3DView_z_equals_aX_plus_bY(float *Z, float a, struct FloatArray3DView *X, float b, float *Y, long int N_0, long int N_1, long int N_2);
+
+void floatArray3DView_copyFrom(struct FloatArray3DView *X, float *Y, long int N_0, long int N_1, long int N_2);
+
+void resizeImageTrilinear(struct FloatArray3DView *out, long int N_x_out, long int N_y_out, long int N_z_out, struct FloatArray3DView *in, long int N_x_in, long int N_y_in, long int N_z_in);
+
+void resizeImageBox(struct FloatArray3DView *out, long int N_x_out, long int N_y_out, long int N_z_out, struct FloatArray3DView *in, long int N_x_in, long int N_y_in, long int N_z_in);
+
 void setFloatArray2Value(float *arr, long int len, float value);
 
 void setUCharArray2Value(unsigned char *arr, long int len, unsigned char value);
@@ -447,24 +907,28 @@ void RandomZiplineAux_free(struct RandomZiplineAux *aux);
 void RandomAux_free(struct RandomAux *aux);
 
 
-void RandomZiplineAux_ShuffleGroupIndices(struct RandomZiplineAux *aux, struct ImageParams *imgParams);
+void RandomZiplineAux_ShuffleGroupIndices(struct RandomZiplineAux *aux, struct ImageParams *imgParams, struct RandomState *rng);
 
-void RandomZiplineAux_ShuffleGroupIndices_FixedDistance(struct RandomZiplineAux *aux, struct ImageParams *imgParams);
+void RandomZiplineAux_ShuffleGroupIndices_FixedDistance(struct RandomZiplineAux *aux, struct ImageParams *imgParams, struct RandomState *rng);
 
-void RandomZiplineAux_shuffleOrderXY(struct RandomZiplineAux *aux, struct ImageParams *imgParams);
+void RandomZiplineAux_shuffleOrderXY(struct RandomZiplineAux *aux, struct ImageParams *imgParams, struct RandomState *rng);
 
 
 void indexExtraction2D(long int j_xy, long int *j_x, long int N_x, long int *j_y, long int N_y);
 
-void shuffleIntArray(int *arr, long int len);
+void RandomState_seed(struct RandomState *rng, unsigned long long int seed);
+
+long int RandomState_next(struct RandomState *rng);
+
+void shuffleIntArray(int *arr, long int len, struct RandomState *rng);
 
-void shuffleLongIntArray(long int *arr, long int len);
+void shuffleLongIntArray(long int *arr, long int len, struct RandomState *rng);
 
-int bernoulli(float p);
+int bernoulli(float p, struct RandomState *rng);
 
-long int uniformIntegerRV(long int l, long int h);
+long int uniformIntegerRV(long int l, long int h, struct RandomState *rng);
 
-long int almostUniformIntegerRV(float mean, int sigma);
+long int almostUniformIntegerRV(float mean, int sigma, struct RandomState *rng);
 
 
 
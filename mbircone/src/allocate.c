@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include "allocate.h"
 
 void *get_spc(size_t num, size_t size)
@@ -58,9 +59,8 @@ void free_img(void **pt)
 /* of size s.                                                             */
 
 
-void *multialloc(size_t s, int d, ...)
+static void *vmultialloc(void *data, size_t s, int d, va_list ap)
 {
-        va_list ap;             /* varargs list traverser */
         size_t max;             /* size of array to be declared */
         size_t j;               /* loop counter */
         size_t *d1,*q;          /* pointer to dimension list */
@@ -69,7 +69,6 @@ void *multialloc(size_t s, int d, ...)
         char **s1, *t, *tree;   /* base pointer to beginning of first array */
         int i;                  /* loop counter */
 
-        va_start(ap,d);
         d1 = (size_t *) mget_spc(d,sizeof(size_t));
 
         for(i=0;i<d;i++)
@@ -78,7 +77,7 @@ void *multialloc(size_t s, int d, ...)
 
         /* Take care of 1-D case separately (6/29/95) */
         if( d==1 ) {
-          tree = (char *)mget_spc(d1[0],s*sizeof(char));
+          tree = (data != NULL) ? (char *)data : (char *)mget_spc(d1[0],s*sizeof(char));
           free((void *)d1);
           return((void *)tree);              /* return base pointer */
         }
@@ -95,7 +94,7 @@ void *multialloc(size_t s, int d, ...)
                                    * dimension array */
         }
         max *= s * (*q);        /* grab actual array memory */
-        r[0] = (char *)mget_spc(max,sizeof(char));
+        r[0] = (data != NULL) ? (char *)data : (char *)mget_spc(max,sizeof(char));
 
         /*
          * r is now set to posize_t to the beginning of each array so that we can
@@ -133,13 +132,43 @@ void *multialloc(size_t s, int d, ...)
         for (j = 1, s1 = r + 1, t = r[0]; j < max; j++)
           *s1++ = (t += s * *(q + 1));
 
-        va_end(ap);
         free((void *)d1);
         return((void *)tree);              /* return base pointer */
 }
 
 
 
+void *multialloc(size_t s, int d, ...)
+{
+        va_list ap;             /* varargs list traverser */
+        void *tree;
+
+        va_start(ap,d);
+        tree = vmultialloc(NULL, s, d, ap);
+        va_end(ap);
+        return(tree);
+}
+
+
+
+/* multiwrap( data, s, d,  d1, d2 ....) is the same as multialloc, except */
+/* that the array elements are not allocated but taken from data, e.g. a  */
+/* memory mapped file. Only the pointer arrays are allocated, so release  */
+/* them with multifree( r, d-1 ). data itself is not freed.               */
+
+void *multiwrap(void *data, size_t s, int d, ...)
+{
+        va_list ap;             /* varargs list traverser */
+        void *tree;
+
+        va_start(ap,d);
+        tree = vmultialloc(data, s, d, ap);
+        va_end(ap);
+        return(tree);
+}
+
+
+
 /*
  * multifree releases all memory that we have already declared analogous to
  * free() when using malloc() 
@@ -158,3 +187,49 @@ void multifree(void *r, int d)
 }
 
 
+
+/* Arena_allocate( arena, size ) gets size bytes at once for Arena_get(). */
+/* Pass the used count of a counting arena (base NULL) to get the bytes    */
+/* for the same sequence of Arena_get() calls.                             */
+
+void Arena_allocate(struct Arena *arena, size_t size)
+{
+        arena->base = (char *)mget_spc(size + ARENA_ALIGNMENT, sizeof(char));
+        arena->size = size + ARENA_ALIGNMENT;
+        arena->used = (size_t)(-(uintptr_t)arena->base % ARENA_ALIGNMENT);
+}
+
+
+
+/* Arena_get( arena, num, size ) returns num elements of size bytes,      */
+/* aligned to ARENA_ALIGNMENT and not initialized. Counting arenas return */
+/* NULL.                                                                  */
+
+void *Arena_get(struct Arena *arena, size_t num, size_t size)
+{
+        char *pt;
+        size_t bytes;
+
+        bytes = (num*size + ARENA_ALIGNMENT-1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+        if(arena->base == NULL) {
+          arena->used += bytes;
+          return(NULL);
+        }
+        if(arena->used + bytes > arena->size) {
+          fprintf(stderr,"Arena_get: arena of %zu bytes is full\n", arena->size);
+          exit(-1);
+        }
+        pt = arena->base + arena->used;
+        arena->used += bytes;
+        return((void *)pt);
+}
+
+
+
+void Arena_free(struct Arena *arena)
+{
+        if(arena->base != NULL)
+          free((void *)arena->base);
+        arena->base = NULL;
+        arena->size = arena->used = 0;
+}
@@ -8,8 +8,24 @@ void *mget_spc(size_t num, size_t size);
 void **get_img(size_t wd, size_t ht, size_t size);
 void free_img(void **pt);
 void *multialloc(size_t s, int d, ...);
+void *multiwrap(void *data, size_t s, int d, ...);
 void multifree(void *r, int d);
 
+/* Arena: one allocation that buffers are taken from in order and released together. */
+/* An arena with base NULL only counts the bytes that Arena_get() is asked for.       */
+#define ARENA_ALIGNMENT 64
+
+struct Arena
+{
+        char *base;
+        size_t size;
+        size_t used;
+};
+
+void Arena_allocate(struct Arena *arena, size_t size);
+void *Arena_get(struct Arena *arena, size_t num, size_t size);
+void Arena_free(struct Arena *arena);
+
 #endif /* _ALLOCATE_H_ */
 
 
@@ -1,9 +1,37 @@
 
+#define _POSIX_C_SOURCE 200809L
+
+#include <string.h>
+#include <stddef.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include "computeSysMatrix.h"
 
  
 
-void computeSysMatrix(struct SinoParams *sinoParams, struct ImageParams *imgParams, struct SysMatrix *A, struct ViewAngleList *viewAngleList)
+/* Keep a copy of the geometry and view angles in A, for computing B columns in on-the-fly mode */
+static void setSysMatrixGeometry(struct SysMatrix *A, struct SinoParams *sinoParams, struct ImageParams *imgParams, float *beta)
+{
+    long int i_beta;
+
+    A->sinoParams = *sinoParams;
+    A->imgParams = *imgParams;
+    A->beta = (float *) mget_spc(sinoParams->N_beta, sizeof(float));
+    A->cosBeta = (float *) mget_spc(sinoParams->N_beta, sizeof(float));
+    A->sinBeta = (float *) mget_spc(sinoParams->N_beta, sizeof(float));
+    for (i_beta = 0; i_beta < sinoParams->N_beta; ++i_beta)
+    {
+        A->beta[i_beta] = beta[i_beta];
+        A->cosBeta[i_beta] = cos(beta[i_beta]);
+        A->sinBeta[i_beta] = sin(beta[i_beta]);
+    }
+}
+
+void computeSysMatrix(struct SinoParams *sinoParams, struct ImageParams *imgParams, struct SysMatrix *A, struct ViewAngleList *viewAngleList, char isOnTheFly, int B_type, int C_type)
 {
     float ticToc;
     tic(&ticToc);
@@ -11,11 +39,30 @@ void computeSysMatrix(struct SinoParams *sinoParams, struct ImageParams *imgPara
     // printf("\nInitialize Sinogram Mask ...\n");
     // printf("\nCompute SysMatrix Parameters...\n");
 
+    A->B_type = B_type;
+    A->C_type = C_type;
     computeAMatrixParameters(sinoParams, imgParams, A, viewAngleList);
-    allocateSysMatrix(A, imgParams->N_x, imgParams->N_y, imgParams->N_z, sinoParams->N_beta, A->i_vstride_max, A->i_wstride_max, A->N_u);
+
+    /* B columns are computed from the geometry on lookup, so all views are computed directly */
+    A->isOnTheFly = isOnTheFly;
+    A->beta = NULL;
+    if (isOnTheFly)
+    {
+        if (A->i_vstride_max > BCOLUMN_BUFFER_SIZE)
+        {
+            fprintf(stderr, "ERROR in computeSysMatrix: i_vstride_max = %ld exceeds %d in on-the-fly mode.\n", A->i_vstride_max, BCOLUMN_BUFFER_SIZE);
+            exit(-1);
+        }
+        A->N_betaStored = sinoParams->N_beta;
+        A->viewSymmetry = 0;
+        setSysMatrixGeometry(A, sinoParams, imgParams, viewAngleList->beta);
+    }
+
+    allocateSysMatrix(A, imgParams->N_x, imgParams->N_y, imgParams->N_z, A->i_wstride_max, A->N_u);
    
     // printf("\nPrecompute B...\n");
-    computeBMatrix( sinoParams, imgParams, A, viewAngleList);
+    if (!isOnTheFly)
+        computeBMatrix( sinoParams, imgParams, A, viewAngleList);
 
     
     // printf("\nPrecompute C...\n");
@@ -26,6 +73,153 @@ void computeSysMatrix(struct SinoParams *sinoParams, struct ImageParams *imgPara
     ticTocDisp(ticToc, "computeSysMatrix");
 }
 
+/**
+ *      Detect whether views N_beta/4 apart differ by a quarter turn.
+ *
+ *      The footprint of voxel (x,y) in view beta+90deg is the footprint of voxel (-y,x) in view beta.
+ *      On a square grid centered on the axis of rotation, (-y,x) is again a voxel, so only the
+ *      first N_beta/4 views need to be stored if beta[i+N_beta/4] = beta[i] +- 90deg for all i.
+ *      The angle tolerance keeps the rotated voxel positions within 1/100 of a voxel of the grid.
+ */
+static void computeViewSymmetry(struct SinoParams *sinoParams, struct ImageParams *imgParams, struct SysMatrix *A, struct ViewAngleList *viewAngleList)
+{
+    long int i_beta, N_quarter;
+    double tolerance, diff;
+    int sign, viewSymmetry;
+
+    A->N_betaStored = sinoParams->N_beta;
+    A->N_xy = imgParams->N_x;
+    A->viewSymmetry = 0;
+
+    N_quarter = sinoParams->N_beta / 4;
+    if (N_quarter == 0 || sinoParams->N_beta % 4 != 0 || imgParams->N_x != imgParams->N_y)
+        return;
+
+    /* grid center has to be on the axis of rotation */
+    if (fabs(imgParams->x_0 + imgParams->N_x*imgParams->Delta_xy/2) > 1e-3*imgParams->Delta_xy
+        || fabs(imgParams->y_0 + imgParams->N_y*imgParams->Delta_xy/2) > 1e-3*imgParams->Delta_xy)
+        return;
+
+    tolerance = 0.01 / imgParams->N_x;
+    viewSymmetry = 0;
+    for (i_beta = 0; i_beta < sinoParams->N_beta - N_quarter; ++i_beta)
+    {
+        diff = (double) viewAngleList->beta[i_beta+N_quarter] - (double) viewAngleList->beta[i_beta];
+        diff = diff - 2*PI*floor(diff/(2*PI) + 0.5);    /* in [-pi, pi) */
+
+        if (fabs(diff - PI/2) <= tolerance)
+            sign = 1;
+        else if (fabs(diff + PI/2) <= tolerance)
+            sign = -1;
+        else
+            return;
+
+        if (viewSymmetry != 0 && sign != viewSymmetry)
+            return;
+        viewSymmetry = sign;
+    }
+
+    A->N_betaStored = N_quarter;
+    A->viewSymmetry = viewSymmetry;
+}
+
+/* Narrowest index type that holds the values 0 .. maxValue */
+static int chooseIndexType(long int maxValue)
+{
+    if (maxValue <= UCHAR_MAX)
+        return INDEX_TYPE_UINT8;
+    if (maxValue <= USHRT_MAX)
+        return INDEX_TYPE_UINT16;
+    return INDEX_TYPE_UINT32;
+}
+
+/* Index type with elements of the given size in bytes, -1 if there is none */
+static int indexTypeFromSize(long int size)
+{
+    switch (size)
+    {
+        case sizeof(unsigned char):  return INDEX_TYPE_UINT8;
+        case sizeof(unsigned short): return INDEX_TYPE_UINT16;
+        case sizeof(unsigned int):   return INDEX_TYPE_UINT32;
+        default:                     return -1;
+    }
+}
+
+/* Store index k of data */
+static void setIndex(void *data, int type, long int k, long int value)
+{
+    switch (type)
+    {
+        case INDEX_TYPE_UINT8:  ((unsigned char *) data)[k] = value; break;
+        case INDEX_TYPE_UINT16: ((unsigned short *) data)[k] = value; break;
+        default:                ((unsigned int *) data)[k] = value; break;
+    }
+}
+
+/* Block sizes in A->columns are rounded up to a multiple of this, so that every block is aligned */
+#define BCOLUMN_BLOCK_ALIGNMENT 8
+
+static long int alignBColumnBlock(long int size)
+{
+    return ((size + BCOLUMN_BLOCK_ALIGNMENT - 1) / BCOLUMN_BLOCK_ALIGNMENT) * BCOLUMN_BLOCK_ALIGNMENT;
+}
+
+/**
+ *      Narrowest index type for the B column descriptors of A.
+ *      i_vstart is clipped to [0, N_dv], j_u is in [0, N_u) and the B offset is at most N_betaStored*i_vstride_max.
+ */
+static int chooseDescriptorType(struct SysMatrix *A, long int N_dv)
+{
+    long int maxValue;
+
+    maxValue = _MAX_(N_dv, A->i_vstride_max);
+    maxValue = _MAX_(maxValue, A->N_u - 1);
+    maxValue = _MAX_(maxValue, A->N_betaStored*A->i_vstride_max);
+    return chooseIndexType(maxValue);
+}
+
+/* Allocate the column offsets of A, the blocks are allocated once their sizes are known */
+static void allocateBColumns(struct SysMatrix *A, long int N_x, long int N_y)
+{
+    A->N_y = N_y;
+    A->descriptorsSize = alignBColumnBlock(A->N_betaStored*BCOLUMN_DESCRIPTOR_LENGTH*indexTypeSize(A->descriptor_type));
+    A->columnOffset = (long int *) mget_spc(N_x*N_y, sizeof(long int));
+    A->columns = NULL;
+    A->columnsSize = 0;
+    A->isColumnsMapped = 0;
+}
+
+/**
+ *      Turn the block sizes in A->columnOffset into offsets and allocate A->columns.
+ *      The blocks are zeroed, so that the padding in the file is reproducible.
+ */
+static void allocateBColumnBlocks(struct SysMatrix *A, long int N_xy)
+{
+    long int j, size, offset;
+
+    offset = 0;
+    for (j = 0; j < N_xy; ++j)
+    {
+        size = A->columnOffset[j];
+        A->columnOffset[j] = offset;
+        offset += size;
+    }
+    A->columnsSize = offset;
+    A->columns = (char *) mget_spc(A->columnsSize, sizeof(char));
+    memset(A->columns, 0, A->columnsSize);
+}
+
+/* Write the descriptor of view i_beta to the block of a B column */
+static void setBColumnDescriptor(struct SysMatrix *A, char *column, long int i_beta, long int i_vstart, long int i_vstride, long int j_u, long int B_offset)
+{
+    long int k = i_beta*BCOLUMN_DESCRIPTOR_LENGTH;
+
+    setIndex(column, A->descriptor_type, k + BCOLUMN_DESCRIPTOR_VSTART, i_vstart);
+    setIndex(column, A->descriptor_type, k + BCOLUMN_DESCRIPTOR_VSTRIDE, i_vstride);
+    setIndex(column, A->descriptor_type, k + BCOLUMN_DESCRIPTOR_JU, j_u);
+    setIndex(column, A->descriptor_type, k + BCOLUMN_DESCRIPTOR_BOFFSET, B_offset);
+}
+
 /* Paper referenced is Balke et al "Separable Models for cone-beam MBIR Reconstruction" */
 
 void computeAMatrixParameters(struct SinoParams *sinoParams, struct ImageParams *imgParams, struct SysMatrix *A, struct ViewAngleList *viewAngleList)
@@ -51,7 +245,13 @@ void computeAMatrixParameters(struct SinoParams *sinoParams, struct ImageParams
     float L_w;
     int temp_stop;
 
-    
+    computeViewSymmetry(sinoParams, imgParams, A, viewAngleList);
+
+    /**
+     *      Columns j_x are split across threads. Only max/min reductions are used to merge the
+     *      per-thread results, so the parameters do not depend on the number of threads.
+     */
+    #pragma omp parallel for private(j_y, i_beta, x_v, y_v, u_v, v_v, beta, alpha_xy, theta, cosine, sine, W_pv, M, i_vstart, i_vstride, temp_stop, delta_v, L_v) reduction(max: i_vstride_max, u_1, B_ij_max) reduction(min: u_0)
     for (j_x = 0; j_x <= imgParams->N_x-1; ++j_x)
     {
         for (j_y = 0; j_y <= imgParams->N_y-1; ++j_y)
@@ -113,17 +313,15 @@ void computeAMatrixParameters(struct SinoParams *sinoParams, struct ImageParams
 
                 /* calculate B_ij according to (6) (7) (8) (9) (10) */
                 /* but only store the max so far B_ij_max */
-                #if ISBIJCOMPRESSED == 1
-                    cosine = cos(alpha_xy);
-                    delta_v = 0;
-                    L_v = (W_pv - sinoParams->Delta_dv)/2;           /* b                         */
-                    L_v = _ABS_(L_v);                                /* |b|                         */
-                    L_v = _MAX_(L_v, delta_v);                        /* max(|b|, c)                 */
-                    L_v = (W_pv + sinoParams->Delta_dv)/2 - L_v;    /* a - max(|b|, c)             */
-                    L_v = _MAX_(L_v, 0);                            /* max{ a - max(|b|, c), 0} */
-
-                    B_ij_max = _MAX_(imgParams->Delta_xy * L_v / (cosine * sinoParams->Delta_dv), B_ij_max);
-                #endif
+                cosine = cos(alpha_xy);
+                delta_v = 0;
+                L_v = (W_pv - sinoParams->Delta_dv)/2;           /* b                         */
+                L_v = _ABS_(L_v);                                /* |b|                         */
+                L_v = _MAX_(L_v, delta_v);                        /* max(|b|, c)                 */
+                L_v = (W_pv + sinoParams->Delta_dv)/2 - L_v;    /* a - max(|b|, c)             */
+                L_v = _MAX_(L_v, 0);                            /* max{ a - max(|b|, c), 0} */
+
+                B_ij_max = _MAX_(imgParams->Delta_xy * L_v / (cosine * sinoParams->Delta_dv), B_ij_max);
 
             }
         }
@@ -132,11 +330,7 @@ void computeAMatrixParameters(struct SinoParams *sinoParams, struct ImageParams
     A->u_0 = u_0;
     A->u_1 = u_1;
     A->B_ij_max = B_ij_max;
-    #if ISBIJCOMPRESSED == 1
-        A->B_ij_scaler = B_ij_max / 255;
-    #else
-        A->B_ij_scaler = 1;
-    #endif
+    A->B_ij_scaler = coeffScaler(A->B_type, B_ij_max);
 
     /* Compute resulting struct SysMatrix parameters from these */
     A->Delta_u = imgParams->Delta_xy / AMATRIX_RHO;
@@ -147,6 +341,7 @@ void computeAMatrixParameters(struct SinoParams *sinoParams, struct ImageParams
 
     /* Part 2: Find i_wstride_max */
     /* iterate over image voxels */
+    #pragma omp parallel for private(j_z, u_v, w_v, M, W_pw, i_wstart, i_wstride, temp_stop, delta_w, L_w) reduction(max: i_wstride_max, C_ij_max)
     for (j_u = 0; j_u <= A->N_u-1; ++j_u)
     {
         /* retrieve voxel center in image coordinates, u coordinate */
@@ -177,142 +372,230 @@ void computeAMatrixParameters(struct SinoParams *sinoParams, struct ImageParams
             
             /* compute C_ij according to (11) (12) */
             /* track the largest in C_ij_max */
-            #if ISCIJCOMPRESSED == 1
-                delta_w = 0;
-                
-                /* eq (12) */
-                /* L_w = max{a - max{|b|, c}, 0} */
-                L_w = (W_pw - sinoParams->Delta_dw)/2;            /* b */
-                L_w = _ABS_(L_w);                                /* |b| */
-                L_w = _MAX_(L_w, delta_w);                        /* max{|b|, c} */
-                L_w = (W_pw + sinoParams->Delta_dw)/2 - L_w;    /* a - max{|b|, c} */
-                L_w = _MAX_(L_w, 0);                            /* max{a - max{|b|, c}, 0} */
-                
-                /* eq (11) */
-                /* see figure 2: alpha = phi */
-                /* 1/cos(alpha) = sqrt( 1 + ( w_v/(u_v-u_s) )^2 ) */
-                C_ij_max = _MAX_((1/sinoParams->Delta_dw) * sqrt( 1 + (w_v*w_v)/((u_v-sinoParams->u_s)*(u_v-sinoParams->u_s)) ) * L_w, C_ij_max);
-            #endif
+            delta_w = 0;
+            
+            /* eq (12) */
+            /* L_w = max{a - max{|b|, c}, 0} */
+            L_w = (W_pw - sinoParams->Delta_dw)/2;            /* b */
+            L_w = _ABS_(L_w);                                /* |b| */
+            L_w = _MAX_(L_w, delta_w);                        /* max{|b|, c} */
+            L_w = (W_pw + sinoParams->Delta_dw)/2 - L_w;    /* a - max{|b|, c} */
+            L_w = _MAX_(L_w, 0);                            /* max{a - max{|b|, c}, 0} */
+            
+            /* eq (11) */
+            /* see figure 2: alpha = phi */
+            /* 1/cos(alpha) = sqrt( 1 + ( w_v/(u_v-u_s) )^2 ) */
+            C_ij_max = _MAX_((1/sinoParams->Delta_dw) * sqrt( 1 + (w_v*w_v)/((u_v-sinoParams->u_s)*(u_v-sinoParams->u_s)) ) * L_w, C_ij_max);
         }
     }
     
     A->i_wstride_max = i_wstride_max;
     A->C_ij_max = C_ij_max;
-    A->C_ij_scaler = C_ij_max / 255;
-    
-    #if ISCIJCOMPRESSED == 1
-        A->C_ij_scaler = C_ij_max / 255;
-    #else
-        A->C_ij_scaler = 1;
-    #endif
+    A->C_ij_scaler = coeffScaler(A->C_type, C_ij_max);
+
+    /* i_wstart is clipped to [0, N_dw] */
+    A->indexStartStop_type = chooseIndexType(sinoParams->N_dw);
+    A->indexStride_type = chooseIndexType(A->i_wstride_max);
+    A->descriptor_type = chooseDescriptorType(A, sinoParams->N_dv);
 
 }
 
 
-void computeBMatrix(struct SinoParams *sinoParams, struct ImageParams *imgParams, struct SysMatrix *A, struct ViewAngleList *viewAngleList)
+/**
+ *      Footprint of voxel column (j_x,j_y) in the view with angle beta, cosine = cos(beta), sine = sin(beta).
+ *      Writes i_vstart, i_vstride, j_u and, unless B is NULL, B[0..i_vstride-1].
+ */
+static void computeBColumnFootprint(struct SinoParams *sinoParams, struct ImageParams *imgParams, struct SysMatrix *A, float beta, float cosine, float sine, long int j_x, long int j_y,
+    long int *i_vstart, long int *i_vstride, long int *j_u, void *B)
 {
-    /* Variable declarations */
     float x_v, y_v;
     float u_v, v_v;
-    float beta, theta, alpha_xy;
-    float cosine, sine;
+    float theta, alpha_xy;
     float W_pv, M;
     float v_d;
     float delta_v;
     float L_v;
     float B_ij;
     float temp_stop;
+    long int i_v;
 
-    long int j_x, j_y, i_beta, i_v;
+    x_v = j_x * imgParams->Delta_xy + (imgParams->x_0 + imgParams->Delta_xy/2);
+    y_v = j_y * imgParams->Delta_xy + (imgParams->y_0 + imgParams->Delta_xy/2);
 
+    /* calculate (u_v, v_v) voxel center position in scanner coordinates */
+    /* accomplished by "rotating around" the position as a detector would */
+    /* for cone3D.py, u_r = 0 */
+    u_v = cosine * x_v - sine * y_v + sinoParams->u_r;
+    v_v = sine * x_v + cosine * y_v + sinoParams->v_r;
 
-    for (j_x = 0; j_x <= imgParams->N_x-1; ++j_x)
+    /* calculate magnification factor as a result of projection */
+    /* M = (dist source detector) / (dist voxel detector) */
+    M = (sinoParams->u_d0 - sinoParams->u_s) / (u_v - sinoParams->u_s);
+
+    /* triangle: (v_v, u_v) voxel center, (0, u_s) source, source-detector line */
+    theta = atan2(v_v, u_v - sinoParams->u_s );
+    
+    /* beta = view angle, theta = angle voxel makes with source-detector line */
+    /* see Figure 1 in Balke et al  */
+    /* alpha = pi/2 + theta - beta is technically the right value */
+    /* alpha mod pi/2 = theta - beta */
+    /* but cos is an even function so sign doesn't matter */
+    alpha_xy = beta - theta;
+    alpha_xy = fmod(alpha_xy + PI/4, PI/2) - PI/4;
+    W_pv = M * imgParams->Delta_xy * cos(alpha_xy) / cos(theta);
+
+    /* compute start coordinate of voxel footprint in detector index */
+    /* M*v_v = center of voxel footprint on detector, image coords */
+    /* M*v_v - W_pv/2 = start of voxel footprint on detector, image coords */
+    /* v_d0 + Delta_dv/2 = center of first detector box */
+    *i_vstart = (M*v_v - W_pv/2 - (sinoParams->v_d0 + sinoParams->Delta_dv/2))/ sinoParams->Delta_dv + 0.5;
+    *i_vstart = _MAX_(*i_vstart, 0);
+    
+    /* compute end coordinate of voxel footprint in detector index */
+    /* same logic as above, with M*v_v + W_pv/2 = end of voxel footprint */
+    temp_stop =  (M*v_v + W_pv/2 - (sinoParams->v_d0 + sinoParams->Delta_dv/2))/ sinoParams->Delta_dv + 0.5;
+    temp_stop = _MIN_(temp_stop, sinoParams->N_dv-1);
+
+    *i_vstride = _MAX_(temp_stop - *i_vstart + 1, 0);
+    *i_vstart = _MIN_(*i_vstart, sinoParams->N_dv);  /* footprint above the detector */
+
+    /* Auxiliary for using C */
+    *j_u = (u_v - (A->u_0+imgParams->Delta_xy/2)) / A->Delta_u + 0.5;
+
+    if (B == NULL)
+        return;
+
+    cosine = cos(alpha_xy);
+    
+    for (i_v = *i_vstart; i_v < *i_vstart + *i_vstride; ++i_v)
     {
-        for (j_y = 0; j_y <= imgParams->N_y-1; ++j_y)
-        {
+        /* Calculate B_(i_y, i_beta, j) eq (6) */
+        v_d = (sinoParams->v_d0 + sinoParams->Delta_dv/2) + i_v * sinoParams->Delta_dv;
 
-            /* Function Body */
-            x_v = j_x * imgParams->Delta_xy + (imgParams->x_0 + imgParams->Delta_xy/2);
-            y_v = j_y * imgParams->Delta_xy + (imgParams->y_0 + imgParams->Delta_xy/2);
+        delta_v = v_d - M * v_v;
+        delta_v = _ABS_(delta_v);
 
-            for (i_beta = 0; i_beta <= sinoParams->N_beta-1 ; ++i_beta)
-            {
-                /* Calculate i_vstart, i_vstride and i_vstride_max */
-                beta = viewAngleList->beta[i_beta];
+        /* L_v = max{ a - max(|b|, c), 0} */
+        L_v = (W_pv - sinoParams->Delta_dv)/2;           /* b                         */
+        L_v = _ABS_(L_v);                                /* |b|                         */
+        L_v = _MAX_(L_v, delta_v);                        /* max(|b|, c)                 */
+        L_v = (W_pv + sinoParams->Delta_dv)/2 - L_v;    /* a - max(|b|, c)             */
+        L_v = _MAX_(L_v, 0);                            /* max{ a - max(|b|, c), 0} */
 
-                /* calculate (u_v, v_v) voxel center position in scanner coordinates */
-                /* accomplished by "rotating around" the position as a detector would */
-                /* for cone3D.py, u_r = 0 */
-                cosine = cos(beta);
-                sine = sin(beta);
-                u_v = cosine * x_v - sine * y_v + sinoParams->u_r;
-                v_v = sine * x_v + cosine * y_v + sinoParams->v_r;
+        B_ij = imgParams->Delta_xy * L_v / (cosine * sinoParams->Delta_dv);     /* cosine = cos(alpha_xy) */
+        
+        /* store B_ij, see (16) (21) for data structure */
+        setCoeff(B, A->B_type, i_v - *i_vstart, B_ij, A->B_ij_scaler);
+    }
+}
 
-                /* calculate magnification factor as a result of projection */
-                /* M = (dist source detector) / (dist voxel detector) */
-                M = (sinoParams->u_d0 - sinoParams->u_s) / (u_v - sinoParams->u_s);
+/**
+ *      B is computed in two passes over the voxel columns: the first finds the size of the block
+ *      of each column from the footprint strides, the second fills in the descriptors and coefficients.
+ */
+void computeBMatrix(struct SinoParams *sinoParams, struct ImageParams *imgParams, struct SysMatrix *A, struct ViewAngleList *viewAngleList)
+{
+    float beta;
+    long int j_x, j_y, i_beta;
+    long int i_vstart, i_vstride, j_u, B_offset;
+    char *column;
 
-                /* triangle: (v_v, u_v) voxel center, (0, u_s) source, source-detector line */
-                theta = atan2(v_v, u_v - sinoParams->u_s );
-                
-                /* beta = view angle, theta = angle voxel makes with source-detector line */
-                /* see Figure 1 in Balke et al  */
-                /* alpha = pi/2 + theta - beta is technically the right value */
-                /* alpha mod pi/2 = theta - beta */
-                /* but cos is an even function so sign doesn't matter */
-                alpha_xy = beta - theta;
-                alpha_xy = fmod(alpha_xy + PI/4, PI/2) - PI/4;
-                W_pv = M * imgParams->Delta_xy * cos(alpha_xy) / cos(theta);
+    #pragma omp parallel for private(j_y, i_beta, beta, i_vstart, i_vstride, j_u, B_offset)
+    for (j_x = 0; j_x <= imgParams->N_x-1; ++j_x)
+    {
+        for (j_y = 0; j_y <= imgParams->N_y-1; ++j_y)
+        {
+            B_offset = 0;
+            for (i_beta = 0; i_beta <= A->N_betaStored-1 ; ++i_beta)
+            {
+                beta = viewAngleList->beta[i_beta];
+                computeBColumnFootprint(sinoParams, imgParams, A, beta, cos(beta), sin(beta), j_x, j_y,
+                    &i_vstart, &i_vstride, &j_u, NULL);
+                B_offset += i_vstride;
+            }
+            A->columnOffset[j_x*imgParams->N_y + j_y] = alignBColumnBlock(A->descriptorsSize + B_offset*coeffTypeSize(A->B_type));
+        }
+    }
 
-                /* compute start coordinate of voxel footprint in detector index */
-                /* M*v_v = center of voxel footprint on detector, image coords */
-                /* M*v_v - W_pv/2 = start of voxel footprint on detector, image coords */
-                /* v_d0 + Delta_dv/2 = center of first detector box */
-                A->i_vstart[j_x][j_y][i_beta] = (M*v_v - W_pv/2 - (sinoParams->v_d0 + sinoParams->Delta_dv/2))/ sinoParams->Delta_dv + 0.5;
-                A->i_vstart[j_x][j_y][i_beta] = _MAX_(A->i_vstart[j_x][j_y][i_beta], 0);
-                
-                /* compute end coordinate of voxel footprint in detector index */
-                /* same logic as above, with M*v_v + W_pv/2 = end of voxel footprint */
-                temp_stop =  (M*v_v + W_pv/2 - (sinoParams->v_d0 + sinoParams->Delta_dv/2))/ sinoParams->Delta_dv + 0.5;
-                temp_stop = _MIN_(temp_stop, sinoParams->N_dv-1);
+    allocateBColumnBlocks(A, imgParams->N_x*imgParams->N_y);
 
-                A->i_vstride[j_x][j_y][i_beta] = _MAX_(temp_stop - A->i_vstart[j_x][j_y][i_beta] + 1, 0);
+    #pragma omp parallel for private(j_y, i_beta, beta, i_vstart, i_vstride, j_u, B_offset, column)
+    for (j_x = 0; j_x <= imgParams->N_x-1; ++j_x)
+    {
+        for (j_y = 0; j_y <= imgParams->N_y-1; ++j_y)
+        {
+            column = A->columns + A->columnOffset[j_x*imgParams->N_y + j_y];
 
-                /* Auxiliary for using C */
-                A->j_u[j_x][j_y][i_beta] = (u_v - (A->u_0+imgParams->Delta_xy/2)) / A->Delta_u + 0.5;
+            /* with view symmetry, the other views are looked up with SysMatrix_getBColumn */
+            B_offset = 0;
+            for (i_beta = 0; i_beta <= A->N_betaStored-1 ; ++i_beta)
+            {
+                beta = viewAngleList->beta[i_beta];
+                computeBColumnFootprint(sinoParams, imgParams, A, beta, cos(beta), sin(beta), j_x, j_y,
+                    &i_vstart, &i_vstride, &j_u,
+                    column + A->descriptorsSize + B_offset*coeffTypeSize(A->B_type));
+                setBColumnDescriptor(A, column, i_beta, i_vstart, i_vstride, j_u, B_offset);
+                B_offset += i_vstride;
+            }
+        }
+    }
+}
 
-                cosine = cos(alpha_xy);
-                
-                for (i_v = A->i_vstart[j_x][j_y][i_beta]; i_v < A->i_vstart[j_x][j_y][i_beta]+A->i_vstride[j_x][j_y][i_beta]; ++i_v)
-                {
-                    /* Calculate B_(i_y, i_beta, j) eq (6) */
-                    v_d = (sinoParams->v_d0 + sinoParams->Delta_dv/2) + i_v * sinoParams->Delta_dv;
+/**
+ *      Pack B and its index arrays, as stored before file version 5, into the blocks of A->columns.
+ *      B[N_x][N_y][N_betaStored*i_vstride_max] holds i_vstride_max coefficients per view,
+ *      i_vstart, i_vstride and j_u are [N_x][N_y][N_betaStored] of the given index types.
+ */
+static void packBColumns(struct SysMatrix *A, long int N_x, long int N_y, void ***B, void ***i_vstart, void ***i_vstride, void ***j_u,
+    int startStop_type, int stride_type, int JU_type)
+{
+    long int j_x, j_y, i_beta;
+    long int stride, B_offset;
+    size_t size;
+    char *column;
 
-                    delta_v = v_d - M * v_v;
-                    delta_v = _ABS_(delta_v);
+    size = coeffTypeSize(A->B_type);
 
-                    /* L_v = max{ a - max(|b|, c), 0} */
-                    L_v = (W_pv - sinoParams->Delta_dv)/2;           /* b                         */
-                    L_v = _ABS_(L_v);                                /* |b|                         */
-                    L_v = _MAX_(L_v, delta_v);                        /* max(|b|, c)                 */
-                    L_v = (W_pv + sinoParams->Delta_dv)/2 - L_v;    /* a - max(|b|, c)             */
-                    L_v = _MAX_(L_v, 0);                            /* max{ a - max(|b|, c), 0} */
+    #pragma omp parallel for private(j_y, i_beta, B_offset)
+    for (j_x = 0; j_x < N_x; ++j_x)
+    {
+        for (j_y = 0; j_y < N_y; ++j_y)
+        {
+            B_offset = 0;
+            for (i_beta = 0; i_beta < A->N_betaStored; ++i_beta)
+                B_offset += getIndex(i_vstride[j_x][j_y], stride_type, i_beta);
+            A->columnOffset[j_x*N_y + j_y] = alignBColumnBlock(A->descriptorsSize + B_offset*size);
+        }
+    }
 
-                    B_ij = imgParams->Delta_xy * L_v / (cosine * sinoParams->Delta_dv);     /* cosine = cos(alpha_xy) */
-                    
-                    /* store B_ij in A->B, see (16) (21) for data structure */
-                    #if ISBIJCOMPRESSED == 1
-                        A->B[j_x][j_y][i_beta*A->i_vstride_max + i_v-A->i_vstart[j_x][j_y][i_beta]] = (B_ij / A->B_ij_scaler) + 0.5;
-                    #else
-                        A->B[j_x][j_y][i_beta*A->i_vstride_max + i_v-A->i_vstart[j_x][j_y][i_beta]] = B_ij;
-                    #endif
-                }
+    allocateBColumnBlocks(A, N_x*N_y);
 
+    #pragma omp parallel for private(j_y, i_beta, stride, B_offset, column)
+    for (j_x = 0; j_x < N_x; ++j_x)
+    {
+        for (j_y = 0; j_y < N_y; ++j_y)
+        {
+            column = A->columns + A->columnOffset[j_x*N_y + j_y];
+            B_offset = 0;
+            for (i_beta = 0; i_beta < A->N_betaStored; ++i_beta)
+            {
+                stride = getIndex(i_vstride[j_x][j_y], stride_type, i_beta);
+                memcpy(column + A->descriptorsSize + B_offset*size, (char *) B[j_x][j_y] + i_beta*A->i_vstride_max*size, stride*size);
+                setBColumnDescriptor(A, column, i_beta, getIndex(i_vstart[j_x][j_y], startStop_type, i_beta), stride,
+                    getIndex(j_u[j_x][j_y], JU_type, i_beta), B_offset);
+                B_offset += stride;
             }
         }
     }
 }
 
+void SysMatrix_computeBColumn(struct SysMatrix *A, long int j_x, long int j_y, long int i_beta, struct BColumn *col)
+{
+    computeBColumnFootprint(&A->sinoParams, &A->imgParams, A, A->beta[i_beta], A->cosBeta[i_beta], A->sinBeta[i_beta], j_x, j_y,
+        &col->i_vstart, &col->i_vstride, &col->j_u, col->buffer);
+    col->B = col->buffer;
+}
+
 
 void computeCMatrix( struct SinoParams *sinoParams, struct ImageParams *imgParams, struct SysMatrix *A)
 {
@@ -325,11 +608,16 @@ void computeCMatrix( struct SinoParams *sinoParams, struct ImageParams *imgParam
         float C_ij;
 
         long int j_u, j_z, i_w;
+        long int i_wstart, i_wstride;
         int temp_stop;
 
 
+        #pragma omp parallel for private(j_z, i_w, i_wstart, i_wstride, u_v, w_v, M, W_pw, w_d, delta_w, L_w, C_ij, temp_stop)
         for (j_u = 0; j_u <= A->N_u-1; ++j_u)
         {
+            /* entries beyond i_wstride are never used, zero them so that the file is reproducible */
+            memset(A->C[j_u], 0, coeffTypeSize(A->C_type)*imgParams->N_z*A->i_wstride_max);
+
             /* retrieve voxel center in image coordinates, u coordinate */
             u_v = j_u * A->Delta_u + (A->u_0+imgParams->Delta_xy/2);
             
@@ -345,16 +633,19 @@ void computeCMatrix( struct SinoParams *sinoParams, struct ImageParams *imgParam
                 w_v = j_z * imgParams->Delta_z + (imgParams->z_0 + imgParams->Delta_z/2);
                 
                 /* compute start coordinate of voxel footprint in detector index */
-                A->i_wstart[j_u][j_z] = (M * w_v - (sinoParams->w_d0 + sinoParams->Delta_dw/2) - W_pw/2 ) * (1/sinoParams->Delta_dw) + 0.5;   /* +0.5 for rounding works because nonnegative */
-                A->i_wstart[j_u][j_z] = _MAX_(A->i_wstart[j_u][j_z], 0);
+                i_wstart = (M * w_v - (sinoParams->w_d0 + sinoParams->Delta_dw/2) - W_pw/2 ) * (1/sinoParams->Delta_dw) + 0.5;   /* +0.5 for rounding works because nonnegative */
+                i_wstart = _MAX_(i_wstart, 0);
 
                 /* compute end coordinate of voxel footprint in detector index */
                 temp_stop = (M * w_v - (sinoParams->w_d0 + sinoParams->Delta_dw/2) + W_pw/2 ) * (1/sinoParams->Delta_dw) + 0.5;    /* +0.5 for rounding works because nonnegative */
                 temp_stop = _MIN_(temp_stop, sinoParams->N_dw-1);
 
-                A->i_wstride[j_u][j_z] = _MAX_(temp_stop - A->i_wstart[j_u][j_z] + 1, 0);
+                i_wstride = _MAX_(temp_stop - i_wstart + 1, 0);
+                i_wstart = _MIN_(i_wstart, sinoParams->N_dw);   /* footprint above the detector */
+                setIndex(A->i_wstart[j_u], A->indexStartStop_type, j_z, i_wstart);
+                setIndex(A->i_wstride[j_u], A->indexStride_type, j_z, i_wstride);
 
-                for (i_w = A->i_wstart[j_u][j_z]; i_w < A->i_wstart[j_u][j_z]+A->i_wstride[j_u][j_z]; ++i_w)
+                for (i_w = i_wstart; i_w < i_wstart+i_wstride; ++i_w)
                 {
                     w_d = (sinoParams->w_d0 + sinoParams->Delta_dw/2) + i_w * sinoParams->Delta_dw;
                     
@@ -374,11 +665,7 @@ void computeCMatrix( struct SinoParams *sinoParams, struct ImageParams *imgParam
                             * L_w;
 
                     /* store C_ij in A->C, see (17) (22) (23) for data structure*/
-                    #if ISCIJCOMPRESSED == 1
-                        A->C[j_u][j_z*A->i_wstride_max + i_w-A->i_wstart[j_u][j_z]] = (C_ij / A->C_ij_scaler) + 0.5;
-                    #else
-                        A->C[j_u][j_z*A->i_wstride_max + i_w-A->i_wstart[j_u][j_z]] = C_ij;
-                    #endif
+                    setCoeff(A->C[j_u], A->C_type, j_z*A->i_wstride_max + i_w-i_wstart, C_ij, A->C_ij_scaler);
                 }
             }
         }
@@ -386,12 +673,217 @@ void computeCMatrix( struct SinoParams *sinoParams, struct ImageParams *imgParam
 }
 
 
+/**
+ *      System matrix A of the views viewIndex[0..sinoParams->N_beta-1] of A_superset, copied without recomputation.
+ *      A keeps the parameters of A_superset (u_0, N_u, scalers, ...), so its coefficients are those of A_superset.
+ *      Views that A_superset stores with view symmetry are expanded, A has no view symmetry.
+ */
+void computeSysMatrixSubset(struct SinoParams *sinoParams, struct ImageParams *imgParams, struct SysMatrix *A, struct SysMatrix *A_superset, long int *viewIndex)
+{
+    long int j_x, j_y, i_beta, N_x, N_y, N_z;
+    long int B_offset;
+    size_t size;
+    char *column;
+    float *beta;
+    struct BColumn col;
+
+    N_x = imgParams->N_x;
+    N_y = imgParams->N_y;
+    N_z = imgParams->N_z;
+    for (i_beta = 0; i_beta < sinoParams->N_beta; ++i_beta)
+    {
+        if (viewIndex[i_beta] < 0 || viewIndex[i_beta] >= A_superset->N_betaStored*(A_superset->viewSymmetry == 0 ? 1 : 4))
+        {
+            fprintf(stderr, "ERROR in computeSysMatrixSubset: view index %ld out of range.\n", viewIndex[i_beta]);
+            exit(-1);
+        }
+    }
+
+    A->i_vstride_max = A_superset->i_vstride_max;
+    A->i_wstride_max = A_superset->i_wstride_max;
+    A->N_u = A_superset->N_u;
+    A->B_ij_max = A_superset->B_ij_max;
+    A->C_ij_max = A_superset->C_ij_max;
+    A->B_ij_scaler = A_superset->B_ij_scaler;
+    A->C_ij_scaler = A_superset->C_ij_scaler;
+    A->Delta_u = A_superset->Delta_u;
+    A->u_0 = A_superset->u_0;
+    A->u_1 = A_superset->u_1;
+    A->N_betaStored = sinoParams->N_beta;
+    A->N_xy = N_x;
+    A->viewSymmetry = 0;
+    A->isOnTheFly = A_superset->isOnTheFly;
+    A->B_type = A_superset->B_type;
+    A->C_type = A_superset->C_type;
+    A->indexStartStop_type = A_superset->indexStartStop_type;
+    A->indexStride_type = A_superset->indexStride_type;
+    A->descriptor_type = chooseDescriptorType(A, sinoParams->N_dv);
+    A->beta = NULL;
+    if (A->isOnTheFly)
+    {
+        beta = (float *) mget_spc(sinoParams->N_beta, sizeof(float));
+        for (i_beta = 0; i_beta < sinoParams->N_beta; ++i_beta)
+            beta[i_beta] = A_superset->beta[viewIndex[i_beta]];
+        setSysMatrixGeometry(A, sinoParams, imgParams, beta);
+        free(beta);
+    }
+
+    allocateSysMatrix(A, N_x, N_y, N_z, A->i_wstride_max, A->N_u);
+
+    /* C does not depend on the views */
+    memcpy(A->C[0], A_superset->C[0], A->N_u*N_z*A->i_wstride_max*coeffTypeSize(A->C_type));
+    memcpy(A->i_wstart[0], A_superset->i_wstart[0], A->N_u*N_z*indexTypeSize(A->indexStartStop_type));
+    memcpy(A->i_wstride[0], A_superset->i_wstride[0], A->N_u*N_z*indexTypeSize(A->indexStride_type));
+
+    if (A->isOnTheFly)
+        return;
+
+    size = coeffTypeSize(A->B_type);
+
+    #pragma omp parallel for private(j_y, i_beta, B_offset, col)
+    for (j_x = 0; j_x < N_x; ++j_x)
+    {
+        for (j_y = 0; j_y < N_y; ++j_y)
+        {
+            B_offset = 0;
+            for (i_beta = 0; i_beta < A->N_betaStored; ++i_beta)
+            {
+                SysMatrix_getBColumn(A_superset, j_x, j_y, viewIndex[i_beta], &col);
+                B_offset += col.i_vstride;
+            }
+            A->columnOffset[j_x*N_y + j_y] = alignBColumnBlock(A->descriptorsSize + B_offset*size);
+        }
+    }
+
+    allocateBColumnBlocks(A, N_x*N_y);
+
+    #pragma omp parallel for private(j_y, i_beta, B_offset, column, col)
+    for (j_x = 0; j_x < N_x; ++j_x)
+    {
+        for (j_y = 0; j_y < N_y; ++j_y)
+        {
+            column = A->columns + A->columnOffset[j_x*N_y + j_y];
+            B_offset = 0;
+            for (i_beta = 0; i_beta < A->N_betaStored; ++i_beta)
+            {
+                SysMatrix_getBColumn(A_superset, j_x, j_y, viewIndex[i_beta], &col);
+                memcpy(column + A->descriptorsSize + B_offset*size, col.B, col.i_vstride*size);
+                setBColumnDescriptor(A, column, i_beta, col.i_vstart, col.i_vstride, col.j_u, B_offset);
+                B_offset += col.i_vstride;
+            }
+        }
+    }
+}
+
+
+/* Offset of the next section in a SysMatrix file, rounded up to SYSMATRIX_SECTION_ALIGNMENT */
+static long int alignSysMatrixSection(long int offset)
+{
+    return ((offset + SYSMATRIX_SECTION_ALIGNMENT - 1) / SYSMATRIX_SECTION_ALIGNMENT) * SYSMATRIX_SECTION_ALIGNMENT;
+}
+
+/* Fill in the header of a SysMatrix file, including the section offsets */
+static void setSysMatrixFileHeader(struct SysMatrixFileHeader *header, struct SinoParams *sinoParams, struct ImageParams *imgParams, struct SysMatrix *A)
+{
+    long int N_x, N_y, N_z, N_columns, i_vstride_max, i_wstride_max, N_u;
+    long int offset;
+
+    N_x = imgParams->N_x;
+    N_y = imgParams->N_y;
+    N_z = imgParams->N_z;
+    N_columns = A->isOnTheFly ? 0 : N_x*N_y;   /* number of blocks in the columns section */
+    i_vstride_max = A->i_vstride_max;
+    i_wstride_max = A->i_wstride_max;
+    N_u = A->N_u;
+
+    memset(header, 0, sizeof(struct SysMatrixFileHeader));
+    memcpy(header->magic, SYSMATRIX_MAGIC, sizeof(header->magic));
+    header->version = SYSMATRIX_FILE_VERSION;
+    header->headerSize = sizeof(struct SysMatrixFileHeader);
+
+    header->N_x = N_x;
+    header->N_y = N_y;
+    header->N_z = N_z;
+    header->N_beta = sinoParams->N_beta;
+    header->N_betaStored = A->N_betaStored;
+    header->viewSymmetry = A->viewSymmetry;
+    header->isOnTheFly = A->isOnTheFly;
+    header->i_vstride_max = i_vstride_max;
+    header->i_wstride_max = i_wstride_max;
+    header->N_u = N_u;
+
+    header->B_ij_max = A->B_ij_max;
+    header->C_ij_max = A->C_ij_max;
+    header->B_ij_scaler = A->B_ij_scaler;
+    header->C_ij_scaler = A->C_ij_scaler;
+    header->Delta_u = A->Delta_u;
+    header->u_0 = A->u_0;
+    header->u_1 = A->u_1;
+
+    header->sizeof_B = coeffTypeSize(A->B_type);
+    header->sizeof_C = coeffTypeSize(A->C_type);
+    header->B_type = A->B_type;
+    header->C_type = A->C_type;
+    header->sizeof_indexStartStop = indexTypeSize(A->indexStartStop_type);
+    header->sizeof_indexStride = indexTypeSize(A->indexStride_type);
+    header->sizeof_descriptor = indexTypeSize(A->descriptor_type);
+    header->columnsSize = A->isOnTheFly ? 0 : A->columnsSize;
+
+    /* the B, i_vstart, i_vstride and j_u sections of older versions are left empty (offset 0) */
+    offset = alignSysMatrixSection(sizeof(struct SysMatrixFileHeader));
+    header->offset_columnOffset = offset;
+    offset = alignSysMatrixSection(offset + N_columns*sizeof(long int));
+    header->offset_columns = offset;
+    offset = alignSysMatrixSection(offset + header->columnsSize);
+    header->offset_C = offset;
+    offset = alignSysMatrixSection(offset + N_u*N_z*i_wstride_max*coeffTypeSize(A->C_type));
+    header->offset_i_wstart = offset;
+    offset = alignSysMatrixSection(offset + N_u*N_z*indexTypeSize(A->indexStartStop_type));
+    header->offset_i_wstride = offset;
+    offset = offset + N_u*N_z*indexTypeSize(A->indexStride_type);
+    if (A->isOnTheFly)
+    {
+        offset = alignSysMatrixSection(offset);
+        header->offset_beta = offset;
+        offset = offset + sinoParams->N_beta*sizeof(float);
+    }
+    else
+        header->offset_beta = offset;
+    header->fileSize = offset;
+}
+
+/* Write zeros to the file until position offset is reached */
+static long int padBinaryFileTo(FILE *fp, long int offset, char *fName)
+{
+    char zeros[SYSMATRIX_SECTION_ALIGNMENT];
+    long int position, n;
+    long int totsize = 0;
+
+    memset(zeros, 0, sizeof(zeros));
+    position = ftell(fp);
+    if (position > offset)
+    {
+        fprintf(stderr, "ERROR in writeSysMatrix: section overlap in file %s.\n", fName);
+        exit(-1);
+    }
+    while (position < offset)
+    {
+        n = offset - position;
+        if (n > SYSMATRIX_SECTION_ALIGNMENT)
+            n = SYSMATRIX_SECTION_ALIGNMENT;
+        totsize += keepWritingToBinaryFile(fp, zeros, n, sizeof(char), fName);
+        position += n;
+    }
+    return totsize;
+}
+
 /* write the System matrix to hard drive */
 void writeSysMatrix(char *fName, struct SinoParams *sinoParams, struct ImageParams *imgParams, struct SysMatrix *A)
 {
     FILE *fp;
     long int totsize = 0;
-    long int N_x, N_y, N_z, N_beta, i_vstride_max, i_wstride_max, N_u;
+    long int N_x, N_y, N_z, i_wstride_max, N_u;
+    struct SysMatrixFileHeader header;
     
     printf("\nWriting System Matrix to %s \n", fName);
     
@@ -403,43 +895,44 @@ void writeSysMatrix(char *fName, struct SinoParams *sinoParams, struct ImagePara
     }
     
     /**
-     *      Writing simple variables
-     *      i_vstride_max, i_wstride_max, N_u, Delta_u, u_0 and u_1
+     *      Writing the header
+     *      (dimensions, i_vstride_max, i_wstride_max, N_u, Delta_u, u_0, u_1, ... and section offsets)
      *      to file
      */
-
-    totsize += keepWritingToBinaryFile(fp, &(A->i_vstride_max),     1, sizeof(long int), fName);
-    totsize += keepWritingToBinaryFile(fp, &(A->i_wstride_max),     1, sizeof(long int), fName);
-    totsize += keepWritingToBinaryFile(fp, &(A->N_u),               1, sizeof(long int), fName);
-    totsize += keepWritingToBinaryFile(fp, &(A->B_ij_max),          1, sizeof(float), fName);
-    totsize += keepWritingToBinaryFile(fp, &(A->C_ij_max),          1, sizeof(float), fName);
-    totsize += keepWritingToBinaryFile(fp, &(A->B_ij_scaler),       1, sizeof(float), fName);
-    totsize += keepWritingToBinaryFile(fp, &(A->C_ij_scaler),       1, sizeof(float), fName);
-    totsize += keepWritingToBinaryFile(fp, &(A->Delta_u),           1, sizeof(float), fName);
-    totsize += keepWritingToBinaryFile(fp, &(A->u_0),               1, sizeof(float), fName);
-    totsize += keepWritingToBinaryFile(fp, &(A->u_1),               1, sizeof(float), fName);
+    setSysMatrixFileHeader(&header, sinoParams, imgParams, A);
+    totsize += keepWritingToBinaryFile(fp, &header, 1, sizeof(struct SysMatrixFileHeader), fName);
 
     /**
      *      Writing array variables
-     *      B, i_vstart, i_vstride, j_u, C, i_wstart and i_wstride
-     *      to file
+     *      columnOffset, columns, C, i_wstart and i_wstride
+     *      to file, each at its aligned offset
      */
     N_x = imgParams->N_x;
     N_y = imgParams->N_y;
     N_z = imgParams->N_z;
-    N_beta = sinoParams->N_beta;
-    i_vstride_max = A->i_vstride_max;
     i_wstride_max = A->i_wstride_max;
     N_u = A->N_u;
 
-    totsize += keepWritingToBinaryFile(fp, &(A->B[0][0][0]),        N_x*N_y*N_beta*i_vstride_max,   sizeof(BIJDATATYPE), fName);
-    totsize += keepWritingToBinaryFile(fp, &(A->i_vstart[0][0][0]), N_x*N_y*N_beta,                 sizeof(INDEXSTARTSTOPDATATYPE),   fName);
-    totsize += keepWritingToBinaryFile(fp, &(A->i_vstride[0][0][0]),N_x*N_y*N_beta,                 sizeof(INDEXSTRIDEDATATYPE),   fName);
-    totsize += keepWritingToBinaryFile(fp, &(A->j_u[0][0][0]),      N_x*N_y*N_beta,                 sizeof(INDEXJUDATATYPE),   fName);
+    if (!A->isOnTheFly)
+    {
+        totsize += padBinaryFileTo(fp, header.offset_columnOffset, fName);
+        totsize += keepWritingToBinaryFile(fp, A->columnOffset,         N_x*N_y,                        sizeof(long int), fName);
+        totsize += padBinaryFileTo(fp, header.offset_columns, fName);
+        totsize += keepWritingToBinaryFile(fp, A->columns,              A->columnsSize,                 sizeof(char),     fName);
+    }
+
+    totsize += padBinaryFileTo(fp, header.offset_C, fName);
+    totsize += keepWritingToBinaryFile(fp, A->C[0],                 N_u*N_z*i_wstride_max,          coeffTypeSize(A->C_type), fName);
+    totsize += padBinaryFileTo(fp, header.offset_i_wstart, fName);
+    totsize += keepWritingToBinaryFile(fp, A->i_wstart[0],    N_u*N_z,                        indexTypeSize(A->indexStartStop_type),   fName);
+    totsize += padBinaryFileTo(fp, header.offset_i_wstride, fName);
+    totsize += keepWritingToBinaryFile(fp, A->i_wstride[0],   N_u*N_z,                        indexTypeSize(A->indexStride_type),   fName);
 
-    totsize += keepWritingToBinaryFile(fp, &(A->C[0][0]),           N_u*N_z*i_wstride_max,          sizeof(CIJDATATYPE), fName);
-    totsize += keepWritingToBinaryFile(fp, &(A->i_wstart[0][0]),    N_u*N_z,                        sizeof(INDEXSTARTSTOPDATATYPE),   fName);
-    totsize += keepWritingToBinaryFile(fp, &(A->i_wstride[0][0]),   N_u*N_z,                        sizeof(INDEXSTRIDEDATATYPE),   fName);
+    if (A->isOnTheFly)
+    {
+        totsize += padBinaryFileTo(fp, header.offset_beta, fName);
+        totsize += keepWritingToBinaryFile(fp, A->beta,                 sinoParams->N_beta,             sizeof(float),   fName);
+    }
     
     printf("Total size written = %e GB\n", totsize/1e9);
 
@@ -447,23 +940,212 @@ void writeSysMatrix(char *fName, struct SinoParams *sinoParams, struct ImagePara
  
 }
 
-
+/* Check that the header of a SysMatrix file matches this build and the given geometry */
+static void checkSysMatrixFileHeader(struct SysMatrixFileHeader *header, struct SinoParams *sinoParams, struct ImageParams *imgParams, long int fileSize, char *fName)
+{
+    if (!(header->version == SYSMATRIX_FILE_VERSION && header->headerSize == (long int) sizeof(struct SysMatrixFileHeader))
+        && !(header->version == 4 && header->headerSize == (long int) offsetof(struct SysMatrixFileHeader, sizeof_descriptor))
+        && !(header->version == 3 && header->headerSize == (long int) offsetof(struct SysMatrixFileHeader, B_type))
+        && !(header->version == 2 && header->headerSize == (long int) offsetof(struct SysMatrixFileHeader, isOnTheFly))
+        && !(header->version == 1 && header->headerSize == (long int) offsetof(struct SysMatrixFileHeader, N_betaStored)))
+    {
+        fprintf(stderr, "ERROR in readSysMatrix: unsupported file version %ld in %s.\n", header->version, fName);
+        exit(-1);
+    }
+    if (header->B_type < COEFF_TYPE_UINT8 || header->B_type > COEFF_TYPE_FLOAT32
+        || header->C_type < COEFF_TYPE_UINT8 || header->C_type > COEFF_TYPE_FLOAT32
+        || header->sizeof_B != (long int) coeffTypeSize(header->B_type)
+        || header->sizeof_C != (long int) coeffTypeSize(header->C_type)
+        || indexTypeFromSize(header->sizeof_indexStartStop) < 0
+        || indexTypeFromSize(header->sizeof_indexStride) < 0
+        || (header->version < 5 && indexTypeFromSize(header->sizeof_indexJU) < 0)
+        || (header->version >= 5 && !header->isOnTheFly && indexTypeFromSize(header->sizeof_descriptor) < 0))
+    {
+        fprintf(stderr, "ERROR in readSysMatrix: data types in %s do not match this build.\n", fName);
+        exit(-1);
+    }
+    if (header->N_x != imgParams->N_x || header->N_y != imgParams->N_y || header->N_z != imgParams->N_z || header->N_beta != sinoParams->N_beta)
+    {
+        fprintf(stderr, "ERROR in readSysMatrix: dimensions in %s do not match the geometry.\n", fName);
+        exit(-1);
+    }
+    if (header->N_betaStored <= 0 || header->N_betaStored*(header->viewSymmetry == 0 ? 1 : 4) != header->N_beta
+        || (header->viewSymmetry != 0 && (header->N_x != header->N_y || header->isOnTheFly)))
+    {
+        fprintf(stderr, "ERROR in readSysMatrix: inconsistent view symmetry in %s.\n", fName);
+        exit(-1);
+    }
+    if (header->isOnTheFly && header->i_vstride_max > BCOLUMN_BUFFER_SIZE)
+    {
+        fprintf(stderr, "ERROR in readSysMatrix: i_vstride_max in %s exceeds %d in on-the-fly mode.\n", fName, BCOLUMN_BUFFER_SIZE);
+        exit(-1);
+    }
+    if (header->fileSize != fileSize)
+    {
+        fprintf(stderr, "ERROR in readSysMatrix: file %s is truncated or corrupt.\n", fName);
+        exit(-1);
+    }
+}
 
 /* read the System matrix from hard drive */
-/* Utility for reading the Sparse System Matrix */
-/* Returns 0 if no error occurs */
+/**
+ *      Files in the current format are memory mapped read-only and the arrays of A point
+ *      directly into the mapping. The pages are shared through the page cache, so several
+ *      processes reading the same file share one copy of the matrix. B columns of files before
+ *      version 5 are repacked into private memory, so those files are not shared.
+ *      Files without a header are read with readSysMatrix_legacy().
+ */
 void readSysMatrix(char *fName, struct SinoParams *sinoParams, struct ImageParams *imgParams, struct SysMatrix *A)
+{
+    int fd;
+    struct stat fileStat;
+    struct SysMatrixFileHeader header;
+    ssize_t numRead;
+    char *base;
+    long int N_x, N_y, N_z, N_beta, i_vstride_max, i_wstride_max, N_u;
+    void ***B, ***i_vstart, ***i_vstride, ***j_u;
+    int startStop_type, stride_type;
+
+    fd = open(fName, O_RDONLY);
+    if (fd < 0)
+    {
+        fprintf(stderr, "ERROR in readSysMatrix: can't open file %s.\n", fName);
+        exit(-1);
+    }
+
+    numRead = pread(fd, &header, sizeof(struct SysMatrixFileHeader), 0);
+    if (numRead != (ssize_t) sizeof(struct SysMatrixFileHeader) || memcmp(header.magic, SYSMATRIX_MAGIC, sizeof(header.magic)) != 0)
+    {
+        close(fd);
+        readSysMatrix_legacy(fName, sinoParams, imgParams, A);
+        return;
+    }
+
+    if (fstat(fd, &fileStat) != 0)
+    {
+        fprintf(stderr, "ERROR in readSysMatrix: can't stat file %s.\n", fName);
+        exit(-1);
+    }
+    /* older headers are followed by zero padding, so only the fields they lack have to be set */
+    if (header.version < 2)
+    {
+        header.N_betaStored = header.N_beta;
+        header.viewSymmetry = 0;
+    }
+    if (header.version < 3)
+    {
+        header.isOnTheFly = 0;
+        header.offset_beta = header.fileSize;
+    }
+    if (header.version < 4)
+    {
+        header.B_type = header.sizeof_B == sizeof(float) ? COEFF_TYPE_FLOAT32 : COEFF_TYPE_UINT8;
+        header.C_type = header.sizeof_C == sizeof(float) ? COEFF_TYPE_FLOAT32 : COEFF_TYPE_UINT8;
+    }
+    checkSysMatrixFileHeader(&header, sinoParams, imgParams, (long int) fileStat.st_size, fName);
+
+    base = (char *) mmap(NULL, (size_t) header.fileSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == (char *) MAP_FAILED)
+    {
+        fprintf(stderr, "ERROR in readSysMatrix: can't map file %s.\n", fName);
+        exit(-1);
+    }
+    /* start reading the whole file in the background, pages already cached by another process are not read again */
+    posix_madvise(base, (size_t) header.fileSize, POSIX_MADV_WILLNEED);
+
+    A->i_vstride_max = header.i_vstride_max;
+    A->i_wstride_max = header.i_wstride_max;
+    A->N_u = header.N_u;
+    A->B_ij_max = header.B_ij_max;
+    A->C_ij_max = header.C_ij_max;
+    A->B_ij_scaler = header.B_ij_scaler;
+    A->C_ij_scaler = header.C_ij_scaler;
+    A->Delta_u = header.Delta_u;
+    A->u_0 = header.u_0;
+    A->u_1 = header.u_1;
+    A->N_betaStored = header.N_betaStored;
+    A->N_xy = header.N_x;
+    A->viewSymmetry = header.viewSymmetry;
+    A->isOnTheFly = header.isOnTheFly;
+    A->B_type = header.B_type;
+    A->C_type = header.C_type;
+    A->indexStartStop_type = indexTypeFromSize(header.sizeof_indexStartStop);
+    A->indexStride_type = indexTypeFromSize(header.sizeof_indexStride);
+    A->beta = NULL;
+    if (A->isOnTheFly)
+        setSysMatrixGeometry(A, sinoParams, imgParams, (float *) (base + header.offset_beta));
+
+    N_x = header.N_x;
+    N_y = header.N_y;
+    N_z = header.N_z;
+    N_beta = header.N_betaStored;
+    i_vstride_max = header.i_vstride_max;
+    i_wstride_max = header.i_wstride_max;
+    N_u = header.N_u;
+
+    /**
+     *      Only the pointer arrays are allocated here.
+     *      The matrix itself stays in the mapping and is paged in on first access.
+     */
+    A->N_y = N_y;
+    A->columnOffset = NULL;
+    A->columns = NULL;
+    A->columnsSize = 0;
+    A->isColumnsMapped = 0;
+    if (!A->isOnTheFly && header.version >= 5)
+    {
+        A->descriptor_type = indexTypeFromSize(header.sizeof_descriptor);
+        A->descriptorsSize = alignBColumnBlock(N_beta*BCOLUMN_DESCRIPTOR_LENGTH*indexTypeSize(A->descriptor_type));
+        A->columnOffset = (long int *) (base + header.offset_columnOffset);
+        A->columns = base + header.offset_columns;
+        A->columnsSize = header.columnsSize;
+        A->isColumnsMapped = 1;
+    }
+    else if (!A->isOnTheFly)
+    {
+        /* older files keep B and its indices in separate sections, they are packed into allocated blocks */
+        startStop_type = A->indexStartStop_type;
+        stride_type = A->indexStride_type;
+        B =             (void***) multiwrap(base + header.offset_B,         coeffTypeSize(A->B_type), 3, N_x, N_y, N_beta*i_vstride_max);
+        i_vstart =      (void***) multiwrap(base + header.offset_i_vstart,  indexTypeSize(startStop_type), 3, N_x, N_y, N_beta);
+        i_vstride =     (void***) multiwrap(base + header.offset_i_vstride, indexTypeSize(stride_type), 3, N_x, N_y, N_beta);
+        j_u =           (void***) multiwrap(base + header.offset_j_u,       header.sizeof_indexJU, 3, N_x, N_y, N_beta);
+
+        A->descriptor_type = chooseDescriptorType(A, sinoParams->N_dv);
+        allocateBColumns(A, N_x, N_y);
+        packBColumns(A, N_x, N_y, B, i_vstart, i_vstride, j_u, startStop_type, stride_type, indexTypeFromSize(header.sizeof_indexJU));
+
+        multifree((void***)B, 2);
+        multifree((void***)i_vstart, 2);
+        multifree((void***)i_vstride, 2);
+        multifree((void***)j_u, 2);
+    }
+
+    A->C =          (void**)  multiwrap(base + header.offset_C,          coeffTypeSize(A->C_type), 2, N_u, N_z*i_wstride_max);
+    A->i_wstart =   (void**)  multiwrap(base + header.offset_i_wstart,  indexTypeSize(A->indexStartStop_type), 2, N_u, N_z);
+    A->i_wstride =  (void**)  multiwrap(base + header.offset_i_wstride, indexTypeSize(A->indexStride_type), 2, N_u, N_z);
+
+    A->isMapped = 1;
+    A->mapAddress = base;
+    A->mapLength = (size_t) header.fileSize;
+}
+
+/* read a System matrix written before the file header was introduced */
+/* Utility for reading the Sparse System Matrix */
+void readSysMatrix_legacy(char *fName, struct SinoParams *sinoParams, struct ImageParams *imgParams, struct SysMatrix *A)
 {
 
     FILE *fp;
     long int totsize = 0;
     long int N_x, N_y, N_z, N_beta, i_vstride_max, i_wstride_max, N_u;
+    void ***B, ***i_vstart, ***i_vstride, ***j_u;
 
 
     fp = fopen(fName, "r");
     if (fp == NULL)
     {
-        fprintf(stderr, "ERROR in WriteSysMatrix: can't open file %s.\n", fName);
+        fprintf(stderr, "ERROR in readSysMatrix_legacy: can't open file %s.\n", fName);
         exit(-1);
     }
     
@@ -496,22 +1178,43 @@ void readSysMatrix(char *fName, struct SinoParams *sinoParams, struct ImageParam
     i_vstride_max = A->i_vstride_max;
     i_wstride_max = A->i_wstride_max;
     N_u = A->N_u;
-
-    allocateSysMatrix(A, N_x, N_y, N_z, N_beta, i_vstride_max, i_wstride_max, N_u);
+    A->N_betaStored = N_beta;
+    A->N_xy = N_x;
+    A->viewSymmetry = 0;
+    A->isOnTheFly = 0;
+    A->B_type = COEFF_TYPE_UINT8;
+    A->C_type = COEFF_TYPE_UINT8;
+    A->indexStartStop_type = INDEX_TYPE_UINT16;
+    A->indexStride_type = INDEX_TYPE_UINT8;
+    A->descriptor_type = chooseDescriptorType(A, sinoParams->N_dv);
+    A->beta = NULL;
+
+    allocateSysMatrix(A, N_x, N_y, N_z, i_wstride_max, N_u);
 
     /**
      *      Reading array variables
      *      B, i_vstart, i_vstride, j_u, C, i_wstart and i_wstride
-     *      from file
+     *      from file. B and its indices are packed into the blocks of A->columns.
      */
-    totsize += keepReadingFromBinaryFile(fp, &(A->B[0][0][0]),     N_x*N_y*N_beta*i_vstride_max, sizeof(BIJDATATYPE), fName);
-    totsize += keepReadingFromBinaryFile(fp, &(A->i_vstart[0][0][0]), N_x*N_y*N_beta,         sizeof(INDEXSTARTSTOPDATATYPE),   fName);
-    totsize += keepReadingFromBinaryFile(fp, &(A->i_vstride[0][0][0]),N_x*N_y*N_beta,         sizeof(INDEXSTRIDEDATATYPE),   fName);
-    totsize += keepReadingFromBinaryFile(fp, &(A->j_u[0][0][0]),      N_x*N_y*N_beta,         sizeof(INDEXJUDATATYPE),   fName);
-
-    totsize += keepReadingFromBinaryFile(fp, &(A->C[0][0]),        N_u*N_z*i_wstride_max,        sizeof(CIJDATATYPE), fName);
-    totsize += keepReadingFromBinaryFile(fp, &(A->i_wstart[0][0]),    N_u*N_z,                sizeof(INDEXSTARTSTOPDATATYPE),   fName);
-    totsize += keepReadingFromBinaryFile(fp, &(A->i_wstride[0][0]),   N_u*N_z,                sizeof(INDEXSTRIDEDATATYPE),   fName);
+    B =             (void***) multialloc(coeffTypeSize(A->B_type), 3, N_x, N_y, N_beta*i_vstride_max);
+    i_vstart =      (void***) multialloc(sizeof(unsigned short), 3, N_x, N_y, N_beta);
+    i_vstride =     (void***) multialloc(sizeof(unsigned char), 3, N_x, N_y, N_beta);
+    j_u =           (void***) multialloc(sizeof(unsigned short), 3, N_x, N_y, N_beta);
+
+    totsize += keepReadingFromBinaryFile(fp, B[0][0],           N_x*N_y*N_beta*i_vstride_max, coeffTypeSize(A->B_type), fName);
+    totsize += keepReadingFromBinaryFile(fp, i_vstart[0][0],    N_x*N_y*N_beta,         sizeof(unsigned short),   fName);
+    totsize += keepReadingFromBinaryFile(fp, i_vstride[0][0],   N_x*N_y*N_beta,         sizeof(unsigned char),    fName);
+    totsize += keepReadingFromBinaryFile(fp, j_u[0][0],         N_x*N_y*N_beta,         sizeof(unsigned short),   fName);
+
+    packBColumns(A, N_x, N_y, B, i_vstart, i_vstride, j_u, INDEX_TYPE_UINT16, INDEX_TYPE_UINT8, INDEX_TYPE_UINT16);
+    multifree((void***)B, 3);
+    multifree((void***)i_vstart, 3);
+    multifree((void***)i_vstride, 3);
+    multifree((void***)j_u, 3);
+
+    totsize += keepReadingFromBinaryFile(fp, A->C[0],              N_u*N_z*i_wstride_max,        coeffTypeSize(A->C_type), fName);
+    totsize += keepReadingFromBinaryFile(fp, A->i_wstart[0],    N_u*N_z,                indexTypeSize(A->indexStartStop_type),   fName);
+    totsize += keepReadingFromBinaryFile(fp, A->i_wstride[0],   N_u*N_z,                indexTypeSize(A->indexStride_type),   fName);
     
     //printf("Total size read = %e GB\n", totsize/1e9);
 
@@ -521,41 +1224,57 @@ void readSysMatrix(char *fName, struct SinoParams *sinoParams, struct ImageParam
 
 
 
-void allocateSysMatrix(struct SysMatrix *A, long int N_x, long int N_y, long int N_z, long int N_beta, long int i_vstride_max, long int i_wstride_max, long int N_u)
+void allocateSysMatrix(struct SysMatrix *A, long int N_x, long int N_y, long int N_z, long int i_wstride_max, long int N_u)
 {
-    /*float totSizeGB;*/
-
-    /*
-    totSizeGB =\
-    (\
-    N_x * N_y * N_beta * i_vstride_max * sizeof(BIJDATATYPE) + \
-    N_x * N_y * N_beta * sizeof(INDEXSTARTSTOPDATATYPE) + \
-    N_x * N_y * N_beta * sizeof(INDEXSTRIDEDATATYPE) + \
-    N_x * N_y * N_beta * sizeof(INDEXJUDATATYPE) + \
-    N_u * N_z * i_wstride_max * sizeof(CIJDATATYPE) + \
-    N_u * N_z * sizeof(INDEXSTARTSTOPDATATYPE) + \
-    N_u * N_z * sizeof(INDEXSTRIDEDATATYPE)\
-    )\
-    /1e9;*/
-   /* printf("\tAllocating %e GB ...\n", totSizeGB);*/
-
-
-    A->B =          (BIJDATATYPE***)                multialloc(sizeof(BIJDATATYPE), 3, N_x, N_y, N_beta*i_vstride_max);
-    A->i_vstart =   (INDEXSTARTSTOPDATATYPE***)     multialloc(sizeof(INDEXSTARTSTOPDATATYPE), 3, N_x, N_y, N_beta);
-    A->i_vstride =    (INDEXSTRIDEDATATYPE***)      multialloc(sizeof(INDEXSTRIDEDATATYPE), 3, N_x, N_y, N_beta);
-    A->j_u =        (INDEXJUDATATYPE***)            multialloc(sizeof(INDEXJUDATATYPE), 3, N_x, N_y, N_beta);
-
-    A->C =          (CIJDATATYPE**)                multialloc(sizeof(CIJDATATYPE), 2, N_u, N_z*i_wstride_max);
-    A->i_wstart =   (INDEXSTARTSTOPDATATYPE**)      multialloc(sizeof(INDEXSTARTSTOPDATATYPE), 2, N_u, N_z);
-    A->i_wstride =    (INDEXSTRIDEDATATYPE**)       multialloc(sizeof(INDEXSTRIDEDATATYPE), 2, N_u, N_z);
+    /* the B column blocks are allocated by computeBMatrix or packBColumns once their sizes are known */
+    A->N_y = N_y;
+    A->columnOffset = NULL;
+    A->columns = NULL;
+    A->columnsSize = 0;
+    A->isColumnsMapped = 0;
+    if (!A->isOnTheFly)
+        allocateBColumns(A, N_x, N_y);
+
+    A->C =          (void**)  multialloc(coeffTypeSize(A->C_type), 2, N_u, N_z*i_wstride_max);
+    A->i_wstart =   (void**)  multialloc(indexTypeSize(A->indexStartStop_type), 2, N_u, N_z);
+    A->i_wstride =  (void**)  multialloc(indexTypeSize(A->indexStride_type), 2, N_u, N_z);
+
+    A->isMapped = 0;
+    A->mapAddress = NULL;
+    A->mapLength = 0;
 }
 
 void freeSysMatrix(struct SysMatrix *A)
 {
-    multifree((void***)A->B, 3);
-    multifree((void***)A->i_vstart, 3);
-    multifree((void***)A->i_vstride, 3);
-    multifree((void***)A->j_u, 3);
+    if (A->beta != NULL)
+    {
+        free(A->beta);
+        free(A->cosBeta);
+        free(A->sinBeta);
+        A->beta = NULL;
+    }
+
+    if (!A->isOnTheFly && !A->isColumnsMapped)
+    {
+        free(A->columnOffset);
+        free(A->columns);
+    }
+    A->columnOffset = NULL;
+    A->columns = NULL;
+
+    if (A->isMapped)
+    {
+        /* Pointer arrays were allocated by multiwrap, the data belongs to the mapping */
+        multifree((void**)A->C, 1);
+        multifree((void**)A->i_wstart, 1);
+        multifree((void**)A->i_wstride, 1);
+        munmap(A->mapAddress, A->mapLength);
+        A->isMapped = 0;
+        A->mapAddress = NULL;
+        A->mapLength = 0;
+        return;
+    }
+
     multifree((void**)A->C, 2);
     multifree((void**)A->i_wstart, 2);
     multifree((void**)A->i_wstride, 2);
@@ -5,7 +5,98 @@
 #include "allocate.h"
 #include "MBIRModularUtilities3D.h"
 
-void computeSysMatrix(struct SinoParams *sinoParams, struct ImageParams *imgParams, struct SysMatrix *A, struct ViewAngleList *viewAngleList);
+/**
+ *      SysMatrix file format
+ *
+ *      The file starts with struct SysMatrixFileHeader. Each array section starts at a
+ *      multiple of SYSMATRIX_SECTION_ALIGNMENT bytes, so the arrays can be memory mapped
+ *      in place. Files without the magic string are read with the legacy loader.
+ *
+ *      Version 2 appends the view symmetry fields to the header. The B section and the
+ *      (j_x,j_y,i_beta) index sections then hold only N_betaStored views.
+ *      Version 1 files are read as files without view symmetry.
+ *
+ *      Version 3 appends the on-the-fly fields. If isOnTheFly is set, the B and index sections
+ *      are empty and the N_beta view angles are stored in a last section at offset_beta.
+ *      Version 1 and 2 files are read as precomputed matrices.
+ *
+ *      Version 4 appends the coefficient types of B and C (COEFF_TYPE_*).
+ *      Older files are read as uint8 or float32 coefficients according to sizeof_B and sizeof_C.
+ *
+ *      The index types (INDEX_TYPE_*) are given by sizeof_indexStartStop, sizeof_indexStride
+ *      and sizeof_indexJU, which are 1, 2 or 4 bytes depending on the geometry.
+ *
+ *      Version 5 replaces the B, i_vstart, i_vstride and j_u sections with the packed B columns
+ *      of struct SysMatrix: a columnOffset section and a columns section. The descriptors are of
+ *      size sizeof_descriptor, i_vstart and i_vstride then only describe C (i_wstart and i_wstride).
+ *      Older files are packed into this layout when they are read.
+ */
+#define SYSMATRIX_MAGIC "MBIRSYSM"
+#define SYSMATRIX_FILE_VERSION 5
+#define SYSMATRIX_SECTION_ALIGNMENT 4096
+
+struct SysMatrixFileHeader
+{
+    char magic[8];
+    long int version;
+    long int headerSize;
+
+    /* Dimensions */
+    long int N_x;
+    long int N_y;
+    long int N_z;
+    long int N_beta;
+    long int i_vstride_max;
+    long int i_wstride_max;
+    long int N_u;
+
+    /* Scalar parameters */
+    float B_ij_max;
+    float C_ij_max;
+    float B_ij_scaler;
+    float C_ij_scaler;
+    float Delta_u;
+    float u_0;
+    float u_1;
+
+    /* Element size in bytes of B, C and the index arrays, the index sizes also give their INDEX_TYPE_* */
+    long int sizeof_B;
+    long int sizeof_C;
+    long int sizeof_indexStartStop;
+    long int sizeof_indexStride;
+    long int sizeof_indexJU;
+
+    /* Byte offset of each array section from the beginning of the file, B to j_u only before version 5 */
+    long int offset_B;
+    long int offset_i_vstart;
+    long int offset_i_vstride;
+    long int offset_j_u;
+    long int offset_C;
+    long int offset_i_wstart;
+    long int offset_i_wstride;
+
+    long int fileSize;
+
+    /* View symmetry (version 2) */
+    long int N_betaStored;
+    long int viewSymmetry;
+
+    /* On-the-fly mode (version 3) */
+    long int isOnTheFly;
+    long int offset_beta;
+
+    /* Coefficient types (version 4) */
+    long int B_type;
+    long int C_type;
+
+    /* Packed B columns (version 5) */
+    long int sizeof_descriptor;
+    long int columnsSize;
+    long int offset_columnOffset;
+    long int offset_columns;
+};
+
+void computeSysMatrix(struct SinoParams *sinoParams, struct ImageParams *imgParams, struct SysMatrix *A, struct ViewAngleList *viewAngleList, char isOnTheFly, int B_type, int C_type);
 
 void computeAMatrixParameters(struct SinoParams *sinoParams, struct ImageParams *imgParams, struct SysMatrix *A, struct ViewAngleList *viewAngleList);
 
@@ -13,12 +104,16 @@ void computeBMatrix(struct SinoParams *sinoParams, struct ImageParams *imgParams
 
 void computeCMatrix( struct SinoParams *sinoParams, struct ImageParams *imgParams, struct SysMatrix *A);
 
+void computeSysMatrixSubset(struct SinoParams *sinoParams, struct ImageParams *imgParams, struct SysMatrix *A, struct SysMatrix *A_superset, long int *viewIndex);
+
 
 void writeSysMatrix(char *fName, struct SinoParams *sinoParams, struct ImageParams *imgParams, struct SysMatrix *A);
 
 void readSysMatrix(char *fName, struct SinoParams *sinoParams, struct ImageParams *imgParams, struct SysMatrix *A);
 
+void readSysMatrix_legacy(char *fName, struct SinoParams *sinoParams, struct ImageParams *imgParams, struct SysMatrix *A);
+
 
-void allocateSysMatrix(struct SysMatrix *A, long int N_x, long int N_y, long int N_z, long int N_beta, long int i_vstride_max, long int i_wstride_max, long int N_u);
+void allocateSysMatrix(struct SysMatrix *A, long int N_x, long int N_y, long int N_z, long int i_wstride_max, long int N_u);
 
 void freeSysMatrix(struct SysMatrix *A);
\ No newline at end of file
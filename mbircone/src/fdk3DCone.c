@@ -0,0 +1,178 @@
+
+#include <math.h>
+#include <omp.h>
+#include "fdk3DCone.h"
+#include "allocate.h"
+
+/* In-place radix-2 FFT of length L (a power of 2). sign = -1: forward, sign = +1: inverse without 1/L. */
+static void fft1D(float *re, float *im, long int L, int sign)
+{
+    long int i, j, k, m, half;
+    float tr, ti, wr, wi, wr_step, wi_step, temp;
+    double angle;
+
+    /* Bit reversal permutation */
+    for (i = 1, j = 0; i < L; ++i)
+    {
+        for (k = L >> 1; j & k; k >>= 1)
+            j ^= k;
+        j ^= k;
+        if (i < j)
+        {
+            _SWAP_(re[i], re[j], temp);
+            _SWAP_(im[i], im[j], temp);
+        }
+    }
+
+    for (m = 2; m <= L; m <<= 1)
+    {
+        half = m >> 1;
+        angle = sign * 2 * PI / m;
+        wr_step = cos(angle);
+        wi_step = sin(angle);
+        for (i = 0; i < L; i += m)
+        {
+            wr = 1;
+            wi = 0;
+            for (k = 0; k < half; ++k)
+            {
+                tr = wr * re[i+k+half] - wi * im[i+k+half];
+                ti = wr * im[i+k+half] + wi * re[i+k+half];
+                re[i+k+half] = re[i+k] - tr;
+                im[i+k+half] = im[i+k] - ti;
+                re[i+k] += tr;
+                im[i+k] += ti;
+
+                temp = wr;
+                wr = wr * wr_step - wi * wi_step;
+                wi = temp * wi_step + wi * wr_step;
+            }
+        }
+    }
+}
+
+/**
+ *      Frequency response H[L] of the band-limited ramp (Ram-Lak) filter with sample spacing Delta:
+ *          h[0] = 1/(4 Delta^2), h[n] = -1/(pi n Delta)^2 for odd n, 0 for even n != 0,
+ *      times Delta for the convolution sum. The spatial kernel is used so that the DC response is right.
+ */
+static void computeRampFilter(float *H, long int L, long int N, float Delta)
+{
+    long int n;
+    float *im;
+
+    im = (float *) mget_spc(L, sizeof(float));
+    setFloatArray2Value(H, L, 0);
+    setFloatArray2Value(im, L, 0);
+
+    H[0] = 1.0 / (4 * Delta);
+    for (n = 1; n < N; n += 2)
+    {
+        H[n] = H[L-n] = -1.0 / (PI * PI * n * n * Delta);
+    }
+    fft1D(H, im, L, -1);
+
+    free((void*)im);
+}
+
+void fdkFilterSino3DCone(float *y_filt, float *y, struct SinoParams *sinoParams)
+{
+    long int N_dv, N_dw, L;
+    long int i_beta, i_v, i_w;
+    float D, v_d, w_d;
+    float *H, *re, *im;
+
+    N_dv = sinoParams->N_dv;
+    N_dw = sinoParams->N_dw;
+    D = sinoParams->u_d0 - sinoParams->u_s;
+
+    /* Zero pad to at least 2 N_dv to avoid wrap-around */
+    for (L = 1; L < 2*N_dv; L <<= 1);
+
+    H = (float *) mget_spc(L, sizeof(float));
+    computeRampFilter(H, L, N_dv, sinoParams->Delta_dv);
+
+    #pragma omp parallel private(i_v, i_w, v_d, w_d, re, im)
+    {
+        re = (float *) mget_spc(L, sizeof(float));
+        im = (float *) mget_spc(L, sizeof(float));
+
+        #pragma omp for
+        for (i_beta = 0; i_beta < sinoParams->N_beta; ++i_beta)
+        {
+            /* H is real and even, so two rows are filtered per FFT: one in re and one in im */
+            for (i_w = 0; i_w < N_dw; i_w += 2)
+            {
+                setFloatArray2Value(re, L, 0);
+                setFloatArray2Value(im, L, 0);
+
+                for (i_v = 0; i_v < N_dv; ++i_v)
+                {
+                    /* Cosine weight D / |source to detector element| */
+                    v_d = sinoParams->v_d0 + (i_v + 0.5) * sinoParams->Delta_dv;
+                    w_d = sinoParams->w_d0 + (i_w + 0.5) * sinoParams->Delta_dw;
+                    re[i_v] = y[index_3D(i_beta,i_v,i_w,N_dv,N_dw)] * D / sqrt(D*D + v_d*v_d + w_d*w_d);
+                    if (i_w+1 < N_dw)
+                    {
+                        w_d += sinoParams->Delta_dw;
+                        im[i_v] = y[index_3D(i_beta,i_v,i_w+1,N_dv,N_dw)] * D / sqrt(D*D + v_d*v_d + w_d*w_d);
+                    }
+                }
+
+                fft1D(re, im, L, -1);
+                for (i_v = 0; i_v < L; ++i_v)
+                {
+                    re[i_v] *= H[i_v] / L;
+                    im[i_v] *= H[i_v] / L;
+                }
+                fft1D(re, im, L, +1);
+
+                for (i_v = 0; i_v < N_dv; ++i_v)
+                {
+                    y_filt[index_3D(i_beta,i_v,i_w,N_dv,N_dw)] = re[i_v];
+                    if (i_w+1 < N_dw)
+                        y_filt[index_3D(i_beta,i_v,i_w+1,N_dv,N_dw)] = im[i_v];
+                }
+            }
+        }
+
+        free((void*)re);
+        free((void*)im);
+    }
+
+    free((void*)H);
+}
+
+void fdk3DCone(float *x, float *y, struct ImageParams *imgParams, struct SysMatrix *A, struct SinoParams *sinoParams)
+{
+    long int N_img, N_sino, i;
+    float *y_filt, *Ax;
+    double AxAx, Axy, scale;
+
+    N_img = imgParams->N_x*imgParams->N_y*imgParams->N_z;
+    N_sino = sinoParams->N_beta*sinoParams->N_dv*sinoParams->N_dw;
+
+    y_filt = (float *) mget_spc(N_sino, sizeof(float));
+    fdkFilterSino3DCone(y_filt, y, sinoParams);
+    backProjectlike3DCone(x, y_filt, imgParams, A, sinoParams, 3);
+    free((void*)y_filt);
+
+    /* Least squares scaling: x <- x <Ax,y> / <Ax,Ax> */
+    Ax = (float *) mget_spc(N_sino, sizeof(float));
+    forwardProject3DCone(Ax, x, imgParams, A, sinoParams);
+
+    AxAx = 0;
+    Axy = 0;
+    #pragma omp parallel for reduction(+:AxAx,Axy)
+    for (i = 0; i < N_sino; ++i)
+    {
+        AxAx += (double) Ax[i] * Ax[i];
+        Axy += (double) Ax[i] * y[i];
+    }
+    free((void*)Ax);
+
+    scale = (AxAx > 0) ? Axy / AxAx : 0;
+    #pragma omp parallel for
+    for (i = 0; i < N_img; ++i)
+        x[i] *= scale;
+}
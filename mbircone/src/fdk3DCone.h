@@ -0,0 +1,19 @@
+#ifndef FDK_3D_CONE_H
+#define FDK_3D_CONE_H
+
+#include "MBIRModularUtilities3D.h"
+
+/**
+ *      Feldkamp-Davis-Kress (FDK) style reconstruction for warm-starting ICD.
+ *
+ *      The sinogram is cosine weighted and ramp filtered along v (the in-plane detector direction),
+ *      then back projected with the system matrix, weighting each view by the squared magnification
+ *      of the voxel. The result is scaled by the least squares fit of A x to y, so the absolute
+ *      constants of the filter and backprojector do not matter.
+ */
+void fdk3DCone(float *x, float *y, struct ImageParams *imgParams, struct SysMatrix *A, struct SinoParams *sinoParams);
+
+/* Cosine weighting and ramp filtering of all rows of y, written to y_filt. Both are [N_beta][N_dv][N_dw]. */
+void fdkFilterSino3DCone(float *y_filt, float *y, struct SinoParams *sinoParams);
+
+#endif /* FDK_3D_CONE_H */
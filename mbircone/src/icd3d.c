@@ -20,7 +20,7 @@ void ICDStep3DCone(struct Sino *sino, struct Image *img, struct SysMatrix *A, st
      *       theta1_f = -e^t W A_{*,j}
      *         theta2_f = A_{*,j}^t W A _{*,j}
      */
-    computeTheta1Theta2ForwardTerm(sino, A, icdInfo, reconParams);
+    computeTheta1Theta2ForwardTerm(sino, img, A, icdInfo, reconParams);
     /**
      *             Compute prior model term of theta1 and theta2:
      *         
@@ -169,44 +169,95 @@ void extractNeighbors(struct ICDInfo3DCone *icdInfo, struct Image *img, struct R
 }
 
 /*[1]: Algorithm 2 on page 181-5*/
-void computeTheta1Theta2ForwardTerm(struct Sino *sino, struct SysMatrix *A, struct ICDInfo3DCone *icdInfo, struct ReconParams *reconParams)
+void computeTheta1Theta2ForwardTerm(struct Sino *sino, struct Image *img, struct SysMatrix *A, struct ICDInfo3DCone *icdInfo, struct ReconParams *reconParams)
 {
     /**
      *             Compute forward model term of theta1 and theta2:
      *         
      *       theta1_f = -e^t W A_{*,j}
      *         theta2_f = A_{*,j}^t W A _{*,j}
+     *
+     *       theta2_f only depends on A and W. If img->theta2Cache holds it, only theta1_f is accumulated.
+     *       Only the runs of nonzero weight of each detector row are visited.
      */
 
-    long int i_beta, i_v, i_w;
+    long int i_beta, i_v, i_w, i_wstart, i_wstride;
+    long int k_run, i_wrunstart, i_wrunstop;
     long int j_x, j_y, j_z, j_u;
     float B_ij, A_ij;
+    float *theta2Cache_j = NULL;
+    struct BColumn col;
 
     j_x = icdInfo->j_x;
     j_y = icdInfo->j_y;
     j_z = icdInfo->j_z;
 
-    for (i_beta = 0; i_beta < sino->params.N_beta; ++i_beta)
+    if (img->theta2Cache != NULL)
+        theta2Cache_j = &img->theta2Cache[index_3D(j_x,j_y,j_z,img->params.N_y,img->params.N_z)];
+
+    if (theta2Cache_j != NULL && *theta2Cache_j >= 0)
     {
-        j_u = A->j_u[j_x][j_y][i_beta];
-        for (i_v = A->i_vstart[j_x][j_y][i_beta]; i_v < A->i_vstart[j_x][j_y][i_beta]+A->i_vstride[j_x][j_y][i_beta]; ++i_v)
+        for (i_beta = 0; i_beta < sino->params.N_beta; ++i_beta)
         {
-            B_ij = A->B_ij_scaler * A->B[j_x][j_y][i_beta*A->i_vstride_max + i_v-A->i_vstart[j_x][j_y][i_beta]];
+            SysMatrix_getBColumn(A, j_x, j_y, i_beta, &col);
+            j_u = col.j_u;
+            for (i_v = col.i_vstart; i_v < col.i_vstart+col.i_vstride; ++i_v)
+            {
+                B_ij = BColumn_getB(A, &col, i_v);
 
-            for (i_w = A->i_wstart[j_u][j_z]; i_w < A->i_wstart[j_u][j_z]+A->i_wstride[j_u][j_z]; ++i_w)
+                i_wstart = SysMatrix_getWStart(A, j_u, j_z);
+                i_wstride = SysMatrix_getWStride(A, j_u, j_z);
+                for (k_run = sinoRunIndex(sino,i_beta,i_v); k_run < sinoRunIndex(sino,i_beta,i_v+1); ++k_run)
+                {
+                    i_wrunstart = _MAX_(sino->wgtRun[k_run].i_wstart, i_wstart);
+                    i_wrunstop = _MIN_(sino->wgtRun[k_run].i_wstop, i_wstart+i_wstride);
+                    for (i_w = i_wrunstart; i_w < i_wrunstop; ++i_w)
+                    {
+                        A_ij = B_ij * SysMatrix_getC(A, j_u, j_z, i_w);
+                        icdInfo->theta1_f -=        
+                                                  sinoError(sino, index_3D(i_beta,i_v,i_w,sino->params.N_dv,sino->params.N_dw))
+                                                * sinoWeight(sino, i_beta, index_3D(i_beta,i_v,i_w,sino->params.N_dv,sino->params.N_dw))
+                                                * A_ij;
+                    }
+                }
+            }
+        }
+        icdInfo->theta2_f = *theta2Cache_j;
+    }
+    else
+    {
+        for (i_beta = 0; i_beta < sino->params.N_beta; ++i_beta)
+        {
+            SysMatrix_getBColumn(A, j_x, j_y, i_beta, &col);
+            j_u = col.j_u;
+            for (i_v = col.i_vstart; i_v < col.i_vstart+col.i_vstride; ++i_v)
             {
-                A_ij = B_ij * A->C_ij_scaler * A->C[j_u][j_z*A->i_wstride_max + i_w-A->i_wstart[j_u][j_z]];
-                icdInfo->theta1_f -=        
-                                          sino->e[index_3D(i_beta,i_v,i_w,sino->params.N_dv,sino->params.N_dw)]
-                                        * sino->wgt[index_3D(i_beta,i_v,i_w,sino->params.N_dv,sino->params.N_dw)]
-                                        * A_ij;
-
-                icdInfo->theta2_f +=    
-                                          A_ij
-                                        * sino->wgt[index_3D(i_beta,i_v,i_w,sino->params.N_dv,sino->params.N_dw)]
-                                        * A_ij;
+                B_ij = BColumn_getB(A, &col, i_v);
+
+                i_wstart = SysMatrix_getWStart(A, j_u, j_z);
+                i_wstride = SysMatrix_getWStride(A, j_u, j_z);
+                for (k_run = sinoRunIndex(sino,i_beta,i_v); k_run < sinoRunIndex(sino,i_beta,i_v+1); ++k_run)
+                {
+                    i_wrunstart = _MAX_(sino->wgtRun[k_run].i_wstart, i_wstart);
+                    i_wrunstop = _MIN_(sino->wgtRun[k_run].i_wstop, i_wstart+i_wstride);
+                    for (i_w = i_wrunstart; i_w < i_wrunstop; ++i_w)
+                    {
+                        A_ij = B_ij * SysMatrix_getC(A, j_u, j_z, i_w);
+                        icdInfo->theta1_f -=        
+                                                  sinoError(sino, index_3D(i_beta,i_v,i_w,sino->params.N_dv,sino->params.N_dw))
+                                                * sinoWeight(sino, i_beta, index_3D(i_beta,i_v,i_w,sino->params.N_dv,sino->params.N_dw))
+                                                * A_ij;
+
+                        icdInfo->theta2_f +=    
+                                                  A_ij
+                                                * sinoWeight(sino, i_beta, index_3D(i_beta,i_v,i_w,sino->params.N_dv,sino->params.N_dw))
+                                                * A_ij;
+                    }
+                }
             }
         }
+        if (theta2Cache_j != NULL)
+            *theta2Cache_j = icdInfo->theta2_f;
     }
 
     if(strcmp(reconParams->weightScaler_domain,"spatiallyInvariant") == 0)
@@ -349,12 +400,16 @@ void updateErrorSinogram(struct Sino *sino, struct SysMatrix *A, struct ICDInfo3
      *             Update error sinogram
      *         
      *         e <- e - A_{*,j} * Delta_xj
+     *
+     *         Only where the weight is nonzero, see computeWeightRuns()
      */
 
 
-    long int i_beta, i_v, i_w;
+    long int i_beta, i_v, i_w, i_wstart, i_wstride, i_e;
+    long int k_run, i_wrunstart, i_wrunstop;
     long int j_x, j_y, j_z, j_u;
     float B_ij;
+    struct BColumn col;
 
     j_x = icdInfo->j_x;
     j_y = icdInfo->j_y;
@@ -362,18 +417,26 @@ void updateErrorSinogram(struct Sino *sino, struct SysMatrix *A, struct ICDInfo3
 
     for (i_beta = 0; i_beta < sino->params.N_beta; ++i_beta)
     {
-        j_u = A->j_u[j_x][j_y][i_beta];
-        for (i_v = A->i_vstart[j_x][j_y][i_beta]; i_v < A->i_vstart[j_x][j_y][i_beta]+A->i_vstride[j_x][j_y][i_beta]; ++i_v)
+        SysMatrix_getBColumn(A, j_x, j_y, i_beta, &col);
+        j_u = col.j_u;
+        for (i_v = col.i_vstart; i_v < col.i_vstart+col.i_vstride; ++i_v)
         {
-            B_ij = A->B_ij_scaler * A->B[j_x][j_y][i_beta*A->i_vstride_max + i_v-A->i_vstart[j_x][j_y][i_beta]];
+            B_ij = BColumn_getB(A, &col, i_v);
 
-            for (i_w = A->i_wstart[j_u][j_z]; i_w < A->i_wstart[j_u][j_z]+A->i_wstride[j_u][j_z]; ++i_w)
+            i_wstart = SysMatrix_getWStart(A, j_u, j_z);
+            i_wstride = SysMatrix_getWStride(A, j_u, j_z);
+            for (k_run = sinoRunIndex(sino,i_beta,i_v); k_run < sinoRunIndex(sino,i_beta,i_v+1); ++k_run)
             {
-                
-                sino->e[index_3D(i_beta,i_v,i_w,sino->params.N_dv,sino->params.N_dw)] -=     
-                                                  B_ij
-                                                * A->C_ij_scaler * A->C[j_u][j_z*A->i_wstride_max + i_w-A->i_wstart[j_u][j_z]]
-                                                * icdInfo->Delta_xj;
+                i_wrunstart = _MAX_(sino->wgtRun[k_run].i_wstart, i_wstart);
+                i_wrunstop = _MIN_(sino->wgtRun[k_run].i_wstop, i_wstart+i_wstride);
+                for (i_w = i_wrunstart; i_w < i_wrunstop; ++i_w)
+                {
+                    i_e = index_3D(i_beta,i_v,i_w,sino->params.N_dv,sino->params.N_dw);
+                    sinoSetError(sino, i_e, sinoError(sino, i_e) -
+                                                      B_ij
+                                                    * SysMatrix_getC(A, j_u, j_z, i_w)
+                                                    * icdInfo->Delta_xj);
+                }
             }
         }
     }
@@ -396,10 +459,10 @@ void resetIterationStats(struct ReconAux *reconAux)
 
 
 
-void RandomAux_ShuffleOrderXYZ(struct RandomAux *aux, struct ImageParams *params)
+void RandomAux_ShuffleOrderXYZ(struct RandomAux *aux, struct ImageParams *params, struct RandomState *rng)
 {
     fprintf(stdout, "zipline mode 0\n");
-    shuffleLongIntArray(aux->orderXYZ, params->N_x * params->N_y * params->N_z);
+    shuffleLongIntArray(aux->orderXYZ, params->N_x * params->N_y * params->N_z, rng);
 }
 
 void indexExtraction3D(long int j_xyz, long int *j_x, long int N_x, long int *j_y, long int N_y, long int *j_z, long int N_z)
@@ -447,7 +510,7 @@ float MAPCostForward(struct Sino *sino)
     /**
      *         ForwardCost =  1/2 ||e||^{2}_{W}
      */
-    long int i_beta, i_v, i_w;
+    long int i_beta, i_v, i_w, i_e;
     float cost;
 
     cost = 0;
@@ -457,9 +520,10 @@ float MAPCostForward(struct Sino *sino)
         {
             for (i_w = 0; i_w < sino->params.N_dw; ++i_w)
             {
-                cost +=   sino->e[index_3D(i_beta,i_v,i_w,sino->params.N_dv,sino->params.N_dw)]
-                        * sino->wgt[index_3D(i_beta,i_v,i_w,sino->params.N_dv,sino->params.N_dw)]
-                        * sino->e[index_3D(i_beta,i_v,i_w,sino->params.N_dv,sino->params.N_dw)];
+                i_e = index_3D(i_beta,i_v,i_w,sino->params.N_dv,sino->params.N_dw);
+                cost +=   sinoError(sino, i_e)
+                        * sinoWeight(sino, i_beta, i_e)
+                        * sinoError(sino, i_e);
             }
         }
     }
@@ -806,7 +870,7 @@ float computeRelUpdate(struct ReconAux *reconAux, struct ReconParams *reconParam
 
 
 /* * * * * * * * * * * * parallel * * * * * * * * * * * * **/
-void prepareParallelAux(struct ParallelAux *parallelAux, long int N_M_max)
+void prepareParallelAux(struct ParallelAux *parallelAux, long int N_M_max, long int N_dw)
 {
     int numThreads;
     #pragma omp parallel
@@ -819,6 +883,10 @@ void prepareParallelAux(struct ParallelAux *parallelAux, long int N_M_max)
     parallelAux->N_M_max = N_M_max;
 
     parallelAux->partialTheta = (struct PartialTheta**) multialloc(sizeof(struct PartialTheta), 2, numThreads, N_M_max);
+    parallelAux->wProfile = (float**) multialloc(sizeof(float), 2, numThreads, N_dw);
+    parallelAux->wProfile2 = (float**) multialloc(sizeof(float), 2, numThreads, N_dw);
+    parallelAux->eRow = (float**) multialloc(sizeof(float), 2, numThreads, N_dw);
+    parallelAux->wRow = (float**) multialloc(sizeof(float), 2, numThreads, N_dw);
 
     parallelAux->j_u = mget_spc(numThreads, sizeof(long int));
     parallelAux->i_v = mget_spc(numThreads, sizeof(long int));
@@ -828,11 +896,22 @@ void prepareParallelAux(struct ParallelAux *parallelAux, long int N_M_max)
     parallelAux->i_w = mget_spc(numThreads, sizeof(long int));
     parallelAux->A_ij = mget_spc(numThreads, sizeof(float));
 
+    parallelAux->icdInfo = NULL;
+    parallelAux->reconAux = NULL;
+    parallelAux->columnState = NULL;
+    parallelAux->errorSinoRowLocks = NULL;
 }
 
 void freeParallelAux(struct ParallelAux *parallelAux)
 {
+    int threadID;
+    int i_lock;
+
     multifree((void**)parallelAux->partialTheta, 2);
+    multifree((void**)parallelAux->wProfile, 2);
+    multifree((void**)parallelAux->wProfile2, 2);
+    multifree((void**)parallelAux->eRow, 2);
+    multifree((void**)parallelAux->wRow, 2);
 
     free((void*)parallelAux->j_u);
     free((void*)parallelAux->i_v);
@@ -842,13 +921,34 @@ void freeParallelAux(struct ParallelAux *parallelAux)
     free((void*)parallelAux->i_w);
     free((void*)parallelAux->A_ij);
 
+    if (parallelAux->icdInfo != NULL)
+        multifree((void**)parallelAux->icdInfo, 2);
+    if (parallelAux->reconAux != NULL)
+    {
+        for (threadID = 0; threadID < parallelAux->numThreads; ++threadID)
+        {
+            free((void*)parallelAux->reconAux[threadID].NHICD_numUpdatedVoxels);
+            free((void*)parallelAux->reconAux[threadID].NHICD_totalValueChange);
+            free((void*)parallelAux->reconAux[threadID].NHICD_isPartialZiplineHot);
+        }
+        free((void*)parallelAux->reconAux);
+    }
+    if (parallelAux->columnState != NULL)
+        free((void*)parallelAux->columnState);
+    if (parallelAux->errorSinoRowLocks != NULL)
+    {
+        for (i_lock = 0; i_lock < ERRORSINO_ROW_LOCKS; ++i_lock)
+            omp_destroy_lock(&parallelAux->errorSinoRowLocks[i_lock]);
+        free((void*)parallelAux->errorSinoRowLocks);
+    }
+
 }
 
 void ICDStep3DConeGroup(struct Sino *sino, struct Image *img, struct SysMatrix *A, struct ICDInfo3DCone *icdInfo, struct ReconParams *reconParams, struct RandomZiplineAux *randomZiplineAux, struct ParallelAux *parallelAux, struct ReconAux *reconAux)
 {
     if (randomZiplineAux->N_M>0)
     {
-        computeTheta1Theta2ForwardTermGroup(sino, A, icdInfo, randomZiplineAux, parallelAux, reconParams);
+        computeTheta1Theta2ForwardTermGroup(sino, img, A, icdInfo, randomZiplineAux, parallelAux, reconParams);
 
         if(reconParams->prox_mode)
             computeTheta1Theta2PriorTermProxMapGroup(icdInfo, reconParams, randomZiplineAux);
@@ -857,30 +957,237 @@ void ICDStep3DConeGroup(struct Sino *sino, struct Image *img, struct SysMatrix *
         
         computeDeltaXjAndUpdateGroup(icdInfo, randomZiplineAux, reconParams, img, reconAux);
 
-        updateErrorSinogramGroup(sino, A, icdInfo, randomZiplineAux);
+        updateErrorSinogramGroup(sino, A, icdInfo, randomZiplineAux, parallelAux);
     }
 
 }
 
-void computeTheta1Theta2ForwardTermGroup(struct Sino *sino, struct SysMatrix *A, struct ICDInfo3DCone *icdInfo, struct RandomZiplineAux *randomZiplineAux, struct ParallelAux *parallelAux, struct ReconParams *reconParams)
+/* w-range [*i_wmin, *i_wmax) covered by the footprints of the zipline members in column j_u */
+static void computeMembersWRange(struct SysMatrix *A, long int j_u, struct ICDInfo3DCone *icdInfo, long int N_M, long int N_dw, long int *i_wmin, long int *i_wmax)
+{
+    long int k_M, j_z;
+
+    *i_wmin = N_dw;
+    *i_wmax = 0;
+    for (k_M = 0; k_M < N_M; ++k_M)
+    {
+        j_z = icdInfo[k_M].j_z;
+        if (SysMatrix_getWStride(A, j_u, j_z) == 0)
+            continue;
+        *i_wmin = _MIN_(*i_wmin, SysMatrix_getWStart(A, j_u, j_z));
+        *i_wmax = _MAX_(*i_wmax, SysMatrix_getWStart(A, j_u, j_z) + SysMatrix_getWStride(A, j_u, j_z));
+    }
+}
+
+/* 1 if theta2_f of all members is in img->theta2Cache */
+static char isGroupTheta2Cached(struct Image *img, struct ICDInfo3DCone *icdInfo, long int N_M)
+{
+    long int k_M;
+
+    if (img->theta2Cache == NULL)
+        return 0;
+    for (k_M = 0; k_M < N_M; ++k_M)
+    {
+        if (img->theta2Cache[index_3D(icdInfo[k_M].j_x,icdInfo[k_M].j_y,icdInfo[k_M].j_z,img->params.N_y,img->params.N_z)] < 0)
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ *      accumulateTheta1Theta2View() for a sinogram with constant weight w = sino->wgtValue, where every row hit by
+ *      the column is read whole. The weight is taken out of the row sums, ew = sum_i_v B_ij e, and
+ *      wBB = w sum_i_v B_ij^2 is the same for all channels, so theta2 needs only the C footprint.
+ */
+static void accumulateTheta1Theta2ViewConstantWeight(struct Sino *sino, struct SysMatrix *A, struct ICDInfo3DCone *icdInfo, long int N_M, long int i_beta, char isTheta2Cached,
+    struct BColumn *col, long int i_wmin, long int i_wmax, float *ew, float *eRow, struct PartialTheta *partialTheta)
+{
+    long int i_v, q;
+    long int j_z, j_u;
+    long int i_wstart, i_wstride;
+    float B_ij, C_ij, sumBB, t1, t2;
+    const void *C_row;
+    long int k_M;
+    long int N_dw;
+
+    N_dw = sino->params.N_dw;
+    j_u = col->j_u;
+
+    memset(ew, 0, (i_wmax - i_wmin)*sizeof(float));
+    sumBB = 0;
+    for (i_v = col->i_vstart; i_v < col->i_vstart+col->i_vstride; ++i_v)
+    {
+        B_ij = BColumn_getB(A, col, i_v);
+        simd_rowAxpy(ew, getCoeffRow(sino->e, sino->eType, 1, sinoRowIndex(sino,i_beta,i_v)*N_dw + i_wmin, i_wmax - i_wmin, eRow), B_ij, i_wmax - i_wmin);
+        sumBB += B_ij * B_ij;
+    }
+
+    for (k_M = 0; k_M < N_M; ++k_M)
+    {
+        j_z = icdInfo[k_M].j_z;
+        C_row = SysMatrix_getCRow(A, j_u, j_z);
+        i_wstart = SysMatrix_getWStart(A, j_u, j_z) - i_wmin;
+        i_wstride = SysMatrix_getWStride(A, j_u, j_z);
+
+        t1 = 0;
+        t2 = 0;
+        for (q = 0; q < i_wstride; ++q)
+        {
+            C_ij = A->C_ij_scaler * getCoeff(C_row, A->C_type, q);
+            t1 += C_ij * ew[i_wstart + q];
+            if (!isTheta2Cached)
+                t2 += C_ij * C_ij;
+        }
+        partialTheta[k_M].t1 -= sino->wgtValue * t1;
+        partialTheta[k_M].t2 += sino->wgtValue * sumBB * t2;
+    }
+}
+
+/**
+ *      Forward model terms of the members in view i_beta, added to partialTheta[k_M].
+ *      ew, wBB, eRow and wRow are row buffers of length N_dw. A compact error sinogram and compact weights
+ *      are decoded into eRow and wRow one run at a time, so all sums are in float32.
+ */
+static void accumulateTheta1Theta2View(struct Sino *sino, struct SysMatrix *A, struct ICDInfo3DCone *icdInfo, long int N_M, long int i_beta, char isTheta2Cached,
+    float *ew, float *wBB, float *eRow, float *wRow, struct PartialTheta *partialTheta)
+{
+    long int i_v, q;
+    long int j_x, j_y, j_z, j_u;
+    long int i_wmin, i_wmax, i_wstart, i_wstride;
+    long int k_run, i_wrunstart, i_wrunstop, rowIndex;
+    float B_ij, C_ij, t1, t2, wScale;
+    const float *e_run, *w_run;
+    struct BColumn col;
+    const void *C_row;
+    long int k_M;
+    long int N_dw;
+
+    N_dw = sino->params.N_dw;
+    j_x = icdInfo[0].j_x;
+    j_y = icdInfo[0].j_y;
+
+    SysMatrix_getBColumn(A, j_x, j_y, i_beta, &col);
+    j_u = col.j_u;
+    /* Skip the view if the rows hit by the column have zero weight */
+    if (sinoRunIndex(sino,i_beta,col.i_vstart) == sinoRunIndex(sino,i_beta,col.i_vstart+col.i_vstride))
+        return;
+    computeMembersWRange(A, j_u, icdInfo, N_M, N_dw, &i_wmin, &i_wmax);
+    if (i_wmin >= i_wmax)
+        return;
+
+    if (sino->wgt == NULL)
+    {
+        accumulateTheta1Theta2ViewConstantWeight(sino, A, icdInfo, N_M, i_beta, isTheta2Cached, &col, i_wmin, i_wmax, ew, eRow, partialTheta);
+        return;
+    }
+
+    /* Combine the detector rows hit by the column, only on the runs of nonzero weight */
+    memset(ew, 0, (i_wmax - i_wmin)*sizeof(float));
+    if (!isTheta2Cached)
+        memset(wBB, 0, (i_wmax - i_wmin)*sizeof(float));
+    wScale = sinoWeightScale(sino, i_beta);
+
+    for (i_v = col.i_vstart; i_v < col.i_vstart+col.i_vstride; ++i_v)
+    {
+        B_ij = BColumn_getB(A, &col, i_v);
+        rowIndex = sinoRowIndex(sino,i_beta,i_v)*N_dw;
+
+        for (k_run = sinoRunIndex(sino,i_beta,i_v); k_run < sinoRunIndex(sino,i_beta,i_v+1); ++k_run)
+        {
+            i_wrunstart = _MAX_(sino->wgtRun[k_run].i_wstart, i_wmin);
+            i_wrunstop = _MIN_(sino->wgtRun[k_run].i_wstop, i_wmax);
+            if (i_wrunstart >= i_wmax)
+                break;
+            if (i_wrunstart >= i_wrunstop)
+                continue;
+
+            e_run = getCoeffRow(sino->e, sino->eType, 1, rowIndex + i_wrunstart, i_wrunstop - i_wrunstart, eRow);
+            w_run = getCoeffRow(sino->wgt, sino->wgtType, wScale, rowIndex + i_wrunstart, i_wrunstop - i_wrunstart, wRow);
+            if (isTheta2Cached)
+                simd_rowAccumulateEW(&ew[i_wrunstart - i_wmin], e_run, w_run, B_ij, i_wrunstop - i_wrunstart);
+            else
+                simd_rowAccumulateEW_WBB(&ew[i_wrunstart - i_wmin], &wBB[i_wrunstart - i_wmin], e_run, w_run, B_ij, i_wrunstop - i_wrunstart);
+        }
+    }
+
+    /* Loop through all the members along zip line */
+    for (k_M = 0; k_M < N_M; ++k_M)
+    {
+        j_z = icdInfo[k_M].j_z;
+        C_row = SysMatrix_getCRow(A, j_u, j_z);
+        i_wstart = SysMatrix_getWStart(A, j_u, j_z) - i_wmin;
+        i_wstride = SysMatrix_getWStride(A, j_u, j_z);
+
+        t1 = 0;
+        t2 = 0;
+        for (q = 0; q < i_wstride; ++q)
+        {
+            C_ij = A->C_ij_scaler * getCoeff(C_row, A->C_type, q);
+            t1 += C_ij * ew[i_wstart + q];
+            if (!isTheta2Cached)
+                t2 += C_ij * C_ij * wBB[i_wstart + q];
+        }
+        partialTheta[k_M].t1 -= t1;
+        partialTheta[k_M].t2 += t2;
+    }
+}
+
+/* Read or fill the theta2 cache and apply the weight scaler */
+static void finishTheta1Theta2ForwardTermGroup(struct Sino *sino, struct Image *img, struct ICDInfo3DCone *icdInfo, long int N_M, char isTheta2Cached, struct ReconParams *reconParams)
+{
+    long int k_M;
+    long int j_xyz;
+
+    if (img->theta2Cache != NULL)
+    {
+        for (k_M = 0; k_M < N_M; ++k_M)
+        {
+            j_xyz = index_3D(icdInfo[k_M].j_x,icdInfo[k_M].j_y,icdInfo[k_M].j_z,img->params.N_y,img->params.N_z);
+            if (isTheta2Cached)
+                icdInfo[k_M].theta2_f = img->theta2Cache[j_xyz];
+            else
+                img->theta2Cache[j_xyz] = icdInfo[k_M].theta2_f;
+        }
+    }
+
+    if(strcmp(reconParams->weightScaler_domain,"spatiallyInvariant") == 0)
+    {
+        for (k_M = 0; k_M < N_M; ++k_M)
+        {
+            icdInfo[k_M].theta1_f /= sino->params.weightScaler_value;
+            icdInfo[k_M].theta2_f /= sino->params.weightScaler_value;
+        }
+    }
+    else
+    {
+        fprintf(stderr, "ERROR in computeTheta1Theta2ForwardTerm: can't recongnize weightScaler_domain.\n");
+        exit(-1);
+    }
+}
+
+void computeTheta1Theta2ForwardTermGroup(struct Sino *sino, struct Image *img, struct SysMatrix *A, struct ICDInfo3DCone *icdInfo, struct RandomZiplineAux *randomZiplineAux, struct ParallelAux *parallelAux, struct ReconParams *reconParams)
 {
     /**
      *             Compute forward model term of theta1 and theta2 for all members:
      *         
      *       theta1_f = -e^t W A_{*,j}
      *         theta2_f = A_{*,j}^t W A _{*,j}
+     *
+     *       In each view, the detector rows hit by the column are first combined over i_v
+     *       (ew = sum_i_v B_ij e w and wBB = sum_i_v B_ij^2 w) on the w-range of all members.
+     *       Each member then only needs a short dot product with its C footprint.
+     *       Detector channels outside the runs of nonzero weight (sino->wgtRun) are skipped.
+     *
+     *       If theta2_f of all members is in img->theta2Cache, only theta1_f is accumulated.
      */
 
-    long int i_beta, i_v, i_w;
-    long int j_x, j_y, j_z, j_u;
-    float B_ij, A_ij;
+    long int i_beta;
     long int N_M, k_M;
     int threadID;
+    char isTheta2Cached;
 
     N_M = randomZiplineAux->N_M;
-    j_x = (icdInfo[0]).j_x;
-    j_y = (icdInfo[0]).j_y;
-
+    isTheta2Cached = isGroupTheta2Cached(img, icdInfo, N_M);
 
     for (threadID = 0; threadID < parallelAux->numThreads; ++threadID)
     {
@@ -891,40 +1198,15 @@ void computeTheta1Theta2ForwardTermGroup(struct Sino *sino, struct SysMatrix *A,
         }
     }
 
-    #pragma omp parallel private(threadID, j_u, i_v, B_ij, k_M, j_z, i_w, A_ij)
+    #pragma omp parallel private(threadID)
     {
         threadID = omp_get_thread_num();
 
         #pragma omp for
         for (i_beta = 0; i_beta < sino->params.N_beta; ++i_beta)
         {
-            j_u = A->j_u[j_x][j_y][i_beta];
-            for (i_v = A->i_vstart[j_x][j_y][i_beta]; i_v < A->i_vstart[j_x][j_y][i_beta]+A->i_vstride[j_x][j_y][i_beta]; ++i_v)
-            {
-                B_ij = A->B_ij_scaler * A->B[j_x][j_y][i_beta*A->i_vstride_max + i_v-A->i_vstart[j_x][j_y][i_beta]];
-
-
-                /* Loop through all the members along zip line */
-                for (k_M = 0; k_M < N_M; ++k_M)
-                {
-                    j_z = icdInfo[k_M].j_z;
-                    for (i_w = A->i_wstart[j_u][j_z]; i_w < A->i_wstart[j_u][j_z]+A->i_wstride[j_u][j_z]; ++i_w)
-                    {
-                        A_ij = B_ij * A->C_ij_scaler * A->C[j_u][j_z*A->i_wstride_max + i_w-A->i_wstart[j_u][j_z]];
-                        
-                        parallelAux->partialTheta[threadID][k_M].t1 -=     
-                                                                          sino->e[index_3D(i_beta,i_v,i_w,sino->params.N_dv,sino->params.N_dw)]
-                                                                        * sino->wgt[index_3D(i_beta,i_v,i_w,sino->params.N_dv,sino->params.N_dw)]
-                                                                        * A_ij;
-
-                        parallelAux->partialTheta[threadID][k_M].t2 +=    
-                                                                          A_ij
-                                                                        * sino->wgt[index_3D(i_beta,i_v,i_w,sino->params.N_dv,sino->params.N_dw)]
-                                                                        * A_ij;
-
-                    }
-                }
-            }
+            accumulateTheta1Theta2View(sino, A, icdInfo, N_M, i_beta, isTheta2Cached, parallelAux->wProfile[threadID], parallelAux->wProfile2[threadID],
+                                       parallelAux->eRow[threadID], parallelAux->wRow[threadID], parallelAux->partialTheta[threadID]);
         }
     }
 
@@ -938,20 +1220,7 @@ void computeTheta1Theta2ForwardTermGroup(struct Sino *sino, struct SysMatrix *A,
         }
     }
 
-    if(strcmp(reconParams->weightScaler_domain,"spatiallyInvariant") == 0)
-    {
-        for (k_M = 0; k_M < N_M; ++k_M)
-        {
-            icdInfo[k_M].theta1_f /= sino->params.weightScaler_value;
-            icdInfo[k_M].theta2_f /= sino->params.weightScaler_value;
-        }
-    }
-    else
-    {
-        fprintf(stderr, "ERROR in computeTheta1Theta2ForwardTerm: can't recongnize weightScaler_domain.\n");
-        exit(-1);
-    }
-
+    finishTheta1Theta2ForwardTermGroup(sino, img, icdInfo, N_M, isTheta2Cached, reconParams);
 }
 
 void computeTheta1Theta2PriorTermQGGMRFGroup(struct ICDInfo3DCone *icdInfo, struct ReconParams *reconParams, struct RandomZiplineAux *randomZiplineAux)
@@ -966,46 +1235,116 @@ void computeTheta1Theta2PriorTermQGGMRFGroup(struct ICDInfo3DCone *icdInfo, stru
     }
 }
 
-void updateErrorSinogramGroup(struct Sino *sino, struct SysMatrix *A, struct ICDInfo3DCone *icdInfo, struct RandomZiplineAux *randomZiplineAux)
+/* e[k .. k+n-1] <- e[k .. k+n-1] - B_ij * profile[0 .. n-1] for a compact error sinogram, decoded into eRow and stored back */
+static void subtractCompactErrorSinoRun(struct Sino *sino, long int k, long int n, float B_ij, const float *profile, float *eRow)
 {
-    /**
-     *             Update error sinogram
-     *         
-     *         e <- e - A_{*,j} * Delta_xj
-     */
-    
-    long int N_M, k_M;
-
+    getCoeffRow(sino->e, sino->eType, 1, k, n, eRow);
+    simd_rowAxpy(eRow, profile, -B_ij, n);
+    setCoeffRow(sino->e, sino->eType, 1, k, n, eRow);
+}
 
-    long int i_beta, i_v, i_w;
+/**
+ *      e <- e - A_{*,j} * Delta_xj in view i_beta, on the runs of nonzero weight of the detector rows.
+ *      The w-profile sum_j C_ij Delta_xj of all members is built once in profile (length N_dw)
+ *      and subtracted from each detector row hit by the column with weight B_ij.
+ *      A compact error sinogram is updated in float32 in the row buffer eRow (length N_dw).
+ *      With isAtomic, other threads may update the same rows concurrently. A float32 error sinogram is then
+ *      updated with atomics, and a compact one under the lock rowLocks[row % ERRORSINO_ROW_LOCKS] of each row.
+ */
+static void updateErrorSinogramView(struct Sino *sino, struct SysMatrix *A, struct ICDInfo3DCone *icdInfo, long int N_M, long int i_beta, float *profile, float *eRow, char isAtomic, omp_lock_t *rowLocks)
+{
+    long int i_v, q;
     long int j_x, j_y, j_z, j_u;
-    float B_ij;
-
-    N_M = randomZiplineAux->N_M;
+    long int i_wmin, i_wmax, i_wstart, i_wstride;
+    long int k_run, i_wrunstart, i_wrunstop, rowIndex;
+    long int N_dw;
+    float B_ij, val;
+    float *e_row;
+    struct BColumn col;
+    const void *C_row;
+    long int k_M;
+    omp_lock_t *rowLock;
+
+    N_dw = sino->params.N_dw;
     j_x = icdInfo[0].j_x;
     j_y = icdInfo[0].j_y;
 
-    #pragma omp parallel for private(j_u, i_v, B_ij, k_M, j_z, i_w)
-    for (i_beta = 0; i_beta < sino->params.N_beta; ++i_beta)
+    SysMatrix_getBColumn(A, j_x, j_y, i_beta, &col);
+    j_u = col.j_u;
+    /* The error sinogram is only kept up to date where the weight is nonzero */
+    if (sinoRunIndex(sino,i_beta,col.i_vstart) == sinoRunIndex(sino,i_beta,col.i_vstart+col.i_vstride))
+        return;
+    computeMembersWRange(A, j_u, icdInfo, N_M, N_dw, &i_wmin, &i_wmax);
+    if (i_wmin >= i_wmax)
+        return;
+
+    memset(profile, 0, (i_wmax - i_wmin)*sizeof(float));
+    for (k_M = 0; k_M < N_M; ++k_M)
     {
-        j_u = A->j_u[j_x][j_y][i_beta];
-        for (i_v = A->i_vstart[j_x][j_y][i_beta]; i_v < A->i_vstart[j_x][j_y][i_beta]+A->i_vstride[j_x][j_y][i_beta]; ++i_v)
-        {
-            B_ij = A->B_ij_scaler * A->B[j_x][j_y][i_beta*A->i_vstride_max + i_v-A->i_vstart[j_x][j_y][i_beta]];
+        j_z = icdInfo[k_M].j_z;
+        C_row = SysMatrix_getCRow(A, j_u, j_z);
+        i_wstart = SysMatrix_getWStart(A, j_u, j_z) - i_wmin;
+        i_wstride = SysMatrix_getWStride(A, j_u, j_z);
+        val = A->C_ij_scaler * icdInfo[k_M].Delta_xj;
+        for (q = 0; q < i_wstride; ++q)
+            profile[i_wstart + q] += val * getCoeff(C_row, A->C_type, q);
+    }
+
+    for (i_v = col.i_vstart; i_v < col.i_vstart+col.i_vstride; ++i_v)
+    {
+        B_ij = BColumn_getB(A, &col, i_v);
+        rowIndex = sinoRowIndex(sino,i_beta,i_v)*N_dw;
+        e_row = (float *) sino->e + rowIndex;
+
+        /* 16 bit entries have no atomic update, so a compact row shared with other threads is updated under its lock */
+        rowLock = (isAtomic && sino->eType != COEFF_TYPE_FLOAT32) ? &rowLocks[sinoRowIndex(sino,i_beta,i_v) % ERRORSINO_ROW_LOCKS] : NULL;
+        if (rowLock != NULL)
+            omp_set_lock(rowLock);
 
-            for (k_M = 0; k_M < N_M; ++k_M)
+        for (k_run = sinoRunIndex(sino,i_beta,i_v); k_run < sinoRunIndex(sino,i_beta,i_v+1); ++k_run)
+        {
+            i_wrunstart = _MAX_(sino->wgtRun[k_run].i_wstart, i_wmin);
+            i_wrunstop = _MIN_(sino->wgtRun[k_run].i_wstop, i_wmax);
+            if (i_wrunstart >= i_wmax)
+                break;
+            if (i_wrunstart >= i_wrunstop)
+                continue;
+
+            if (sino->eType != COEFF_TYPE_FLOAT32)
+                subtractCompactErrorSinoRun(sino, rowIndex + i_wrunstart, i_wrunstop - i_wrunstart, B_ij, &profile[i_wrunstart - i_wmin], eRow);
+            else if (isAtomic)
             {
-                j_z = icdInfo[k_M].j_z;
-                for (i_w = A->i_wstart[j_u][j_z]; i_w < A->i_wstart[j_u][j_z]+A->i_wstride[j_u][j_z]; ++i_w)
+                for (q = i_wrunstart; q < i_wrunstop; ++q)
                 {
-                    
-                    sino->e[index_3D(i_beta,i_v,i_w,sino->params.N_dv,sino->params.N_dw)] -=     
-                                                      B_ij
-                                                    * A->C_ij_scaler * A->C[j_u][j_z*A->i_wstride_max + i_w-A->i_wstart[j_u][j_z]]
-                                                    * icdInfo[k_M].Delta_xj;
+                    #pragma omp atomic
+                    e_row[q] -= B_ij * profile[q - i_wmin];
                 }
             }
+            else
+                simd_rowAxpy(&e_row[i_wrunstart], &profile[i_wrunstart - i_wmin], -B_ij, i_wrunstop - i_wrunstart);
         }
+
+        if (rowLock != NULL)
+            omp_unset_lock(rowLock);
+    }
+}
+
+void updateErrorSinogramGroup(struct Sino *sino, struct SysMatrix *A, struct ICDInfo3DCone *icdInfo, struct RandomZiplineAux *randomZiplineAux, struct ParallelAux *parallelAux)
+{
+    /**
+     *             Update error sinogram
+     *         
+     *         e <- e - A_{*,j} * Delta_xj
+     */
+    long int i_beta;
+    long int N_M;
+
+    N_M = randomZiplineAux->N_M;
+
+    #pragma omp parallel for
+    for (i_beta = 0; i_beta < sino->params.N_beta; ++i_beta)
+    {
+        updateErrorSinogramView(sino, A, icdInfo, N_M, i_beta, parallelAux->wProfile[omp_get_thread_num()], parallelAux->eRow[omp_get_thread_num()], 0, NULL);
     }
 }
 
@@ -1025,6 +1364,269 @@ void computeTheta1Theta2PriorTermProxMapGroup(struct ICDInfo3DCone *icdInfo, str
 }
 
 
+
+/* * * * * * * * * * * * multi-column * * * * * * * * * * * * **/
+
+/**
+ *      Per-thread state for updating several columns at the same time (zipLineMode 4).
+ *      Each thread gets its own zipline members and its own copy of reconAux with separate
+ *      NHICD arrays and iteration statistics.
+ */
+void prepareParallelAuxColumns(struct ParallelAux *parallelAux, long int numZiplines, long int N_x, long int N_y)
+{
+    int threadID;
+    int i_lock;
+
+    parallelAux->columnState = (char*) mget_spc(N_x*N_y, sizeof(char));
+    parallelAux->errorSinoRowLocks = (omp_lock_t*) mget_spc(ERRORSINO_ROW_LOCKS, sizeof(omp_lock_t));
+    for (i_lock = 0; i_lock < ERRORSINO_ROW_LOCKS; ++i_lock)
+        omp_init_lock(&parallelAux->errorSinoRowLocks[i_lock]);
+    parallelAux->icdInfo = (struct ICDInfo3DCone**) multialloc(sizeof(struct ICDInfo3DCone), 2, parallelAux->numThreads, parallelAux->N_M_max);
+    parallelAux->reconAux = (struct ReconAux*) mget_spc(parallelAux->numThreads, sizeof(struct ReconAux));
+    for (threadID = 0; threadID < parallelAux->numThreads; ++threadID)
+    {
+        parallelAux->reconAux[threadID].NHICD_numUpdatedVoxels = (long int*) mget_spc(numZiplines, sizeof(long int));
+        parallelAux->reconAux[threadID].NHICD_totalValueChange = (float*) mget_spc(numZiplines, sizeof(float));
+        parallelAux->reconAux[threadID].NHICD_isPartialZiplineHot = (int*) mget_spc(numZiplines, sizeof(int));
+        /* Each thread draws from its own sequence */
+        RandomState_seed(&parallelAux->reconAux[threadID].rng, threadID+1);
+    }
+}
+
+/* Copy the settings of reconAux to each thread and zero the per-thread statistics. Each thread keeps its own rng. */
+void resetIterationStatsColumns(struct ParallelAux *parallelAux, struct ReconAux *reconAux)
+{
+    int threadID;
+    struct ReconAux *threadAux;
+    long int *NHICD_numUpdatedVoxels;
+    float *NHICD_totalValueChange;
+    int *NHICD_isPartialZiplineHot;
+    struct RandomState rng;
+
+    for (threadID = 0; threadID < parallelAux->numThreads; ++threadID)
+    {
+        threadAux = &parallelAux->reconAux[threadID];
+        NHICD_numUpdatedVoxels = threadAux->NHICD_numUpdatedVoxels;
+        NHICD_totalValueChange = threadAux->NHICD_totalValueChange;
+        NHICD_isPartialZiplineHot = threadAux->NHICD_isPartialZiplineHot;
+        rng = threadAux->rng;
+
+        *threadAux = *reconAux;
+        threadAux->NHICD_numUpdatedVoxels = NHICD_numUpdatedVoxels;
+        threadAux->NHICD_totalValueChange = NHICD_totalValueChange;
+        threadAux->NHICD_isPartialZiplineHot = NHICD_isPartialZiplineHot;
+        threadAux->rng = rng;
+        resetIterationStats(threadAux);
+    }
+}
+
+/* Add the per-thread statistics to reconAux */
+void reduceIterationStatsColumns(struct ParallelAux *parallelAux, struct ReconAux *reconAux)
+{
+    int threadID;
+
+    for (threadID = 0; threadID < parallelAux->numThreads; ++threadID)
+    {
+        reconAux->TotalValueChange += parallelAux->reconAux[threadID].TotalValueChange;
+        reconAux->TotalVoxelValue += parallelAux->reconAux[threadID].TotalVoxelValue;
+        reconAux->NumUpdatedVoxels += parallelAux->reconAux[threadID].NumUpdatedVoxels;
+    }
+}
+
+/* Start an iteration of the column schedule. Columns outside the mask count as done. */
+void resetColumnSchedule(struct ParallelAux *parallelAux, long int N_x, long int N_y)
+{
+    long int j_x, j_y;
+
+    for (j_x = 0; j_x < N_x; ++j_x)
+        for (j_y = 0; j_y < N_y; ++j_y)
+            parallelAux->columnState[j_x*N_y + j_y] = isInsideMask(j_x, j_y, N_x, N_y) ? COLUMN_PENDING : COLUMN_DONE;
+    parallelAux->i_orderFirst = 0;
+    parallelAux->numColumnsReleased = 0;
+}
+
+/**
+ *      Claim the first pending column of orderXY with no busy column within a distance of 2 in j_x and j_y.
+ *      Closer columns share image neighbors or NHICD statistics, so they must not be updated at the same time.
+ *      Skipped columns stay pending and are claimed as soon as their neighbors are done, which keeps the
+ *      update order close to the random order of orderXY (with one thread it is exactly that order).
+ *      Returns the index j_xy of the claimed column, COLUMN_NONE_FREE if all pending columns wait for a neighbor,
+ *      or COLUMN_ALL_CLAIMED. Must be called inside the critical section columnSchedule.
+ */
+long int claimColumn(struct ParallelAux *parallelAux, const int *orderXY, long int N_x, long int N_y)
+{
+    long int i_order, j_xy, j_x, j_y, jj_x, jj_y;
+    char isFree;
+    char *columnState = parallelAux->columnState;
+
+    while (parallelAux->i_orderFirst < N_x*N_y && columnState[orderXY[parallelAux->i_orderFirst]] != COLUMN_PENDING)
+        ++parallelAux->i_orderFirst;
+    if (parallelAux->i_orderFirst == N_x*N_y)
+        return COLUMN_ALL_CLAIMED;
+
+    for (i_order = parallelAux->i_orderFirst; i_order < N_x*N_y; ++i_order)
+    {
+        j_xy = orderXY[i_order];
+        if (columnState[j_xy] != COLUMN_PENDING)
+            continue;
+
+        indexExtraction2D(j_xy, &j_x, N_x, &j_y, N_y);
+        isFree = 1;
+        for (jj_x = _MAX_(j_x-2, 0); jj_x <= _MIN_(j_x+2, N_x-1) && isFree; ++jj_x)
+            for (jj_y = _MAX_(j_y-2, 0); jj_y <= _MIN_(j_y+2, N_y-1); ++jj_y)
+                if (columnState[jj_x*N_y + jj_y] == COLUMN_BUSY)
+                    isFree = 0;
+
+        if (isFree)
+        {
+            columnState[j_xy] = COLUMN_BUSY;
+            return j_xy;
+        }
+    }
+    return COLUMN_NONE_FREE;
+}
+
+/**
+ *      Zipline update run entirely by the calling thread threadID, for use inside a parallel region
+ *      where other threads update other columns. The error sinogram is updated with atomics, since
+ *      the sinogram footprints of any two columns may overlap.
+ */
+void ICDStep3DConeColumn(struct Sino *sino, struct Image *img, struct SysMatrix *A, struct ICDInfo3DCone *icdInfo, struct ReconParams *reconParams, struct RandomZiplineAux *randomZiplineAux, struct ParallelAux *parallelAux, int threadID, struct ReconAux *reconAux)
+{
+    long int k_M;
+
+    if (randomZiplineAux->N_M>0)
+    {
+        computeTheta1Theta2ForwardTermColumn(sino, img, A, icdInfo, randomZiplineAux, parallelAux, threadID, reconParams);
+
+        if(reconParams->prox_mode)
+            computeTheta1Theta2PriorTermProxMapGroup(icdInfo, reconParams, randomZiplineAux);
+        else
+        {
+            for (k_M = 0; k_M < randomZiplineAux->N_M; ++k_M)
+                computeTheta1Theta2PriorTermQGGMRF(&icdInfo[k_M], reconParams);
+        }
+
+        computeDeltaXjAndUpdateGroup(icdInfo, randomZiplineAux, reconParams, img, reconAux);
+
+        updateErrorSinogramColumn(sino, A, icdInfo, randomZiplineAux, parallelAux, threadID);
+    }
+}
+
+void computeTheta1Theta2ForwardTermColumn(struct Sino *sino, struct Image *img, struct SysMatrix *A, struct ICDInfo3DCone *icdInfo, struct RandomZiplineAux *randomZiplineAux, struct ParallelAux *parallelAux, int threadID, struct ReconParams *reconParams)
+{
+    long int i_beta;
+    long int N_M, k_M;
+    char isTheta2Cached;
+    struct PartialTheta *partialTheta;
+
+    N_M = randomZiplineAux->N_M;
+    isTheta2Cached = isGroupTheta2Cached(img, icdInfo, N_M);
+    partialTheta = parallelAux->partialTheta[threadID];
+
+    for (k_M = 0; k_M < N_M; ++k_M)
+    {
+        partialTheta[k_M].t1 = 0;
+        partialTheta[k_M].t2 = 0;
+    }
+
+    for (i_beta = 0; i_beta < sino->params.N_beta; ++i_beta)
+    {
+        accumulateTheta1Theta2View(sino, A, icdInfo, N_M, i_beta, isTheta2Cached, parallelAux->wProfile[threadID], parallelAux->wProfile2[threadID],
+                                   parallelAux->eRow[threadID], parallelAux->wRow[threadID], partialTheta);
+    }
+
+    for (k_M = 0; k_M < N_M; ++k_M)
+    {
+        icdInfo[k_M].theta1_f += partialTheta[k_M].t1;
+        icdInfo[k_M].theta2_f += partialTheta[k_M].t2;
+    }
+
+    finishTheta1Theta2ForwardTermGroup(sino, img, icdInfo, N_M, isTheta2Cached, reconParams);
+}
+
+void updateErrorSinogramColumn(struct Sino *sino, struct SysMatrix *A, struct ICDInfo3DCone *icdInfo, struct RandomZiplineAux *randomZiplineAux, struct ParallelAux *parallelAux, int threadID)
+{
+    long int i_beta;
+
+    for (i_beta = 0; i_beta < sino->params.N_beta; ++i_beta)
+    {
+        updateErrorSinogramView(sino, A, icdInfo, randomZiplineAux->N_M, i_beta, parallelAux->wProfile[threadID], parallelAux->eRow[threadID], parallelAux->numThreads > 1, parallelAux->errorSinoRowLocks);
+    }
+}
+
+
+/* * * * * * * * * * * * theta2 cache * * * * * * * * * * * * **/
+
+void computeTheta2Cache(struct Sino *sino, struct Image *img, struct SysMatrix *A)
+{
+    /**
+     *             Fill img->theta2Cache for all voxels inside the mask that are not cached yet
+     *         
+     *         theta2Cache_j = A_{*,j}^t W A _{*,j}
+     *
+     *         Each thread computes whole (j_x,j_y) columns, so B_ij is decoded once for all j_z.
+     */
+
+    long int i_beta, i_v, i_w, i_wstart, i_wstride;
+    long int j_xy, j_x, j_y, j_z, j_u;
+    long int N_x, N_y, N_z;
+    float B_ij, A_ij;
+    float *theta2Cache_col;
+    char isColumnCached;
+    struct BColumn col;
+
+    N_x = img->params.N_x;
+    N_y = img->params.N_y;
+    N_z = img->params.N_z;
+
+    #pragma omp parallel for schedule(dynamic) private(j_x, j_y, j_z, j_u, i_beta, i_v, i_w, i_wstart, i_wstride, B_ij, A_ij, theta2Cache_col, isColumnCached, col)
+    for (j_xy = 0; j_xy < N_x*N_y; ++j_xy)
+    {
+        j_x = j_xy / N_y;
+        j_y = j_xy % N_y;
+        if (!isInsideMask(j_x, j_y, N_x, N_y))
+            continue;
+
+        theta2Cache_col = &img->theta2Cache[index_3D(j_x,j_y,0,N_y,N_z)];
+        isColumnCached = 1;
+        for (j_z = 0; j_z < N_z; ++j_z)
+        {
+            if (theta2Cache_col[j_z] < 0)
+                isColumnCached = 0;
+        }
+        if (isColumnCached)
+            continue;
+
+        for (j_z = 0; j_z < N_z; ++j_z)
+            theta2Cache_col[j_z] = 0;
+
+        for (i_beta = 0; i_beta < sino->params.N_beta; ++i_beta)
+        {
+            SysMatrix_getBColumn(A, j_x, j_y, i_beta, &col);
+            j_u = col.j_u;
+            for (i_v = col.i_vstart; i_v < col.i_vstart+col.i_vstride; ++i_v)
+            {
+                B_ij = BColumn_getB(A, &col, i_v);
+
+                for (j_z = 0; j_z < N_z; ++j_z)
+                {
+                    i_wstart = SysMatrix_getWStart(A, j_u, j_z);
+                    i_wstride = SysMatrix_getWStride(A, j_u, j_z);
+                    for (i_w = i_wstart; i_w < i_wstart+i_wstride; ++i_w)
+                    {
+                        A_ij = B_ij * SysMatrix_getC(A, j_u, j_z, i_w);
+                        theta2Cache_col[j_z] +=
+                                                  A_ij
+                                                * sinoWeight(sino, i_beta, index_3D(i_beta,i_v,i_w,sino->params.N_dv,sino->params.N_dw))
+                                                * A_ij;
+                    }
+                }
+            }
+        }
+    }
+}
+
 /* * * * * * * * * * * * time aux ICD * * * * * * * * * * * * **/
 
 void speedAuxICD_reset(struct SpeedAuxICD *speedAuxICD)
@@ -1057,12 +1659,12 @@ void speedAuxICD_computeSpeed(struct SpeedAuxICD *speedAuxICD)
 
 /* * * * * * * * * * * * NHICD * * * * * * * * * * * * **/
 
-int NHICD_isVoxelHot(struct ReconParams *reconParams, struct Image *img, long int j_x, long int j_y, long int j_z, float lastChangeThreshold)
+int NHICD_isVoxelHot(struct ReconParams *reconParams, struct Image *img, long int j_x, long int j_y, long int j_z, float lastChangeThreshold, struct RandomState *rng)
 {
     if(img->lastChange[j_x][j_y][j_z] > lastChangeThreshold)
         return 1;
 
-    if(bernoulli(reconParams->NHICD_random/100)==1)
+    if(bernoulli(reconParams->NHICD_random/100, rng)==1)
         return 1;
 
     return 0;
@@ -1146,7 +1748,7 @@ void updateNHICDStats(struct ReconAux *reconAux, long int j_x, long int j_y, str
             }
 
 
-            img->timeToChange[j_x][j_y][indexZiplines] = almostUniformIntegerRV(mean_timeToChange, sigma_timeToChange);
+            img->timeToChange[j_x][j_y][indexZiplines] = almostUniformIntegerRV(mean_timeToChange, sigma_timeToChange, &reconAux->rng);
         }
 
     }
@@ -11,7 +11,7 @@ void prepareICDInfo(long int j_x, long int j_y, long int j_z, struct ICDInfo3DCo
 
 void extractNeighbors( struct ICDInfo3DCone *icdInfo, struct Image *img, struct ReconParams *reconParams);
 
-void computeTheta1Theta2ForwardTerm(struct Sino *sino, struct SysMatrix *A, struct ICDInfo3DCone *icdInfo, struct ReconParams *reconParams);
+void computeTheta1Theta2ForwardTerm(struct Sino *sino, struct Image *img, struct SysMatrix *A, struct ICDInfo3DCone *icdInfo, struct ReconParams *reconParams);
 
 void computeTheta1Theta2PriorTermQGGMRF(struct ICDInfo3DCone *icdInfo, struct ReconParams *reconParams);
 
@@ -26,7 +26,7 @@ void updateIterationStats(struct ReconAux *reconAux, struct ICDInfo3DCone *icdIn
 void resetIterationStats(struct ReconAux *reconAux);
 
 
-void RandomAux_ShuffleOrderXYZ(struct RandomAux *aux, struct ImageParams *params);
+void RandomAux_ShuffleOrderXYZ(struct RandomAux *aux, struct ImageParams *params, struct RandomState *rng);
 
 void indexExtraction3D(long int j_xyz, long int *j_x, long int N_x, long int *j_y, long int N_y, long int *j_z, long int N_z);
 
@@ -60,20 +60,42 @@ void disp_iterationInfo(struct ReconAux *reconAux, struct ReconParams *reconPara
 float computeRelUpdate(struct ReconAux *reconAux, struct ReconParams *reconParams, struct Image *img);
 
 /* * * * * * * * * * * * parallel * * * * * * * * * * * * **/
-void prepareParallelAux(struct ParallelAux *parallelAux, long int N_M_max);
+void prepareParallelAux(struct ParallelAux *parallelAux, long int N_M_max, long int N_dw);
 
 void freeParallelAux(struct ParallelAux *parallelAux);
 
 void ICDStep3DConeGroup(struct Sino *sino, struct Image *img, struct SysMatrix *A, struct ICDInfo3DCone *icdInfo, struct ReconParams *reconParams, struct RandomZiplineAux *randomZiplineAux, struct ParallelAux *parallelAux, struct ReconAux *reconAux);
 
-void computeTheta1Theta2ForwardTermGroup(struct Sino *sino, struct SysMatrix *A, struct ICDInfo3DCone *icdInfo, struct RandomZiplineAux *randomZiplineAux, struct ParallelAux *parallelAux, struct ReconParams *reconParams);
+void computeTheta1Theta2ForwardTermGroup(struct Sino *sino, struct Image *img, struct SysMatrix *A, struct ICDInfo3DCone *icdInfo, struct RandomZiplineAux *randomZiplineAux, struct ParallelAux *parallelAux, struct ReconParams *reconParams);
 
 void computeTheta1Theta2PriorTermQGGMRFGroup(struct ICDInfo3DCone *icdInfo, struct ReconParams *reconParams, struct RandomZiplineAux *randomZiplineAux);
 
-void updateErrorSinogramGroup(struct Sino *sino, struct SysMatrix *A, struct ICDInfo3DCone *icdInfo, struct RandomZiplineAux *randomZiplineAux);
+void updateErrorSinogramGroup(struct Sino *sino, struct SysMatrix *A, struct ICDInfo3DCone *icdInfo, struct RandomZiplineAux *randomZiplineAux, struct ParallelAux *parallelAux);
 
 void computeTheta1Theta2PriorTermProxMapGroup(struct ICDInfo3DCone *icdInfo, struct ReconParams *reconParams, struct RandomZiplineAux *randomZiplineAux);
 
+/* * * * * * * * * * * * multi-column * * * * * * * * * * * * **/
+
+void prepareParallelAuxColumns(struct ParallelAux *parallelAux, long int numZiplines, long int N_x, long int N_y);
+
+void resetIterationStatsColumns(struct ParallelAux *parallelAux, struct ReconAux *reconAux);
+
+void reduceIterationStatsColumns(struct ParallelAux *parallelAux, struct ReconAux *reconAux);
+
+void resetColumnSchedule(struct ParallelAux *parallelAux, long int N_x, long int N_y);
+
+long int claimColumn(struct ParallelAux *parallelAux, const int *orderXY, long int N_x, long int N_y);
+
+void ICDStep3DConeColumn(struct Sino *sino, struct Image *img, struct SysMatrix *A, struct ICDInfo3DCone *icdInfo, struct ReconParams *reconParams, struct RandomZiplineAux *randomZiplineAux, struct ParallelAux *parallelAux, int threadID, struct ReconAux *reconAux);
+
+void computeTheta1Theta2ForwardTermColumn(struct Sino *sino, struct Image *img, struct SysMatrix *A, struct ICDInfo3DCone *icdInfo, struct RandomZiplineAux *randomZiplineAux, struct ParallelAux *parallelAux, int threadID, struct ReconParams *reconParams);
+
+void updateErrorSinogramColumn(struct Sino *sino, struct SysMatrix *A, struct ICDInfo3DCone *icdInfo, struct RandomZiplineAux *randomZiplineAux, struct ParallelAux *parallelAux, int threadID);
+
+/* * * * * * * * * * * * theta2 cache * * * * * * * * * * * * **/
+
+void computeTheta2Cache(struct Sino *sino, struct Image *img, struct SysMatrix *A);
+
 /* * * * * * * * * * * * time aux ICD * * * * * * * * * * * * **/
 
 void speedAuxICD_reset(struct SpeedAuxICD *speedAuxICD);
@@ -84,7 +106,7 @@ void speedAuxICD_computeSpeed(struct SpeedAuxICD *speedAuxICD);
 
 /* * * * * * * * * * * * NHICD * * * * * * * * * * * * **/
 
-int NHICD_isVoxelHot(struct ReconParams *reconParams, struct Image *img, long int j_x, long int j_y, long int j_z, float lastChangeThreshold);
+int NHICD_isVoxelHot(struct ReconParams *reconParams, struct Image *img, long int j_x, long int j_y, long int j_z, float lastChangeThreshold, struct RandomState *rng);
 
 int NHICD_activatePartialUpdate(struct ReconParams *reconParams, float relativeWeightedForwardError);
 
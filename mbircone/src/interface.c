@@ -4,17 +4,19 @@
 #include "interface.h"
 #include "computeSysMatrix.h"
 #include "recon3DCone.h"
+#include "fdk3DCone.h"
+#include "multires3DCone.h"
 
 
 void AmatrixComputeToFile(float *angles, 
     struct SinoParams sinoParams, struct ImageParams imgParams, 
-    char *Amatrix_fname, char verbose)
+    char *Amatrix_fname, char isOnTheFly, int B_type, int C_type, char verbose)
 {
     struct SysMatrix A;
     struct ViewAngleList viewAngleList;
 
     viewAngleList.beta = angles;
-    computeSysMatrix(&sinoParams, &imgParams, &A, &viewAngleList);
+    computeSysMatrix(&sinoParams, &imgParams, &A, &viewAngleList, isOnTheFly, B_type, C_type);
     
     if(verbose){
         printSysMatrixParams(&A);
@@ -25,102 +27,348 @@ void AmatrixComputeToFile(float *angles,
     freeSysMatrix(&A);
 
 }
+
+/*
+ * Writes the system matrix of a subset of the views of the system matrix in superset_fname,
+ * without recomputing it from the geometry. View i_beta of the subset is view viewIndex[i_beta] of the superset.
+ * supersetSinoParams and sinoParams differ only in N_beta.
+ */
+void AmatrixSubsetToFile(char *superset_fname, long int *viewIndex,
+    struct SinoParams supersetSinoParams, struct SinoParams sinoParams, struct ImageParams imgParams,
+    char *Amatrix_fname, char verbose)
+{
+    struct SysMatrix A_superset, A;
+
+    readSysMatrix(superset_fname, &supersetSinoParams, &imgParams, &A_superset);
+    computeSysMatrixSubset(&sinoParams, &imgParams, &A, &A_superset, viewIndex);
+    freeSysMatrix(&A_superset);
+
+    if(verbose){
+        printSysMatrixParams(&A);
+    }
+
+    writeSysMatrix(Amatrix_fname, &sinoParams, &imgParams, &A);
+
+    freeSysMatrix(&A);
+}
+
 /*
  * This function initializes C variables related to qGGMRF reconstruction, read sysmatrix from disk, and invoke MBIR3DCone() function to perform qGGMRF recon or prox map estimation in place.
  * This function is invoked by recon_cy() function in interface_cy.pyx.
  * 
+ * The arrays are views of caller owned arrays in any layout (see struct FloatArray3DView), indexed as the
+ * C arrays [N_x][N_y][N_z] and [N_beta][N_dv][N_dw]. They are converted to the C layout here, so the caller
+ * does not have to transpose or copy them.
+ *
  * Input Variables:
- * x: pointer to the 1D initial image array as well as the recon image array. This array will be modified in-place in ICD iterations.
- * y: pointer to 1D sinogram array. This array will not be modified by C code.
- * wght: pointer to 1D sinogram weight array. This array will not be modified by C code.
- * proxmap_input: pointer to 1D proximal map input array. Will only be accessed when imgParams->prox_mode is True.
+ * x: view of the reconstructed image. Written once the reconstruction is done, may be the same array as x_init.
+ * x_init: view of the initial image. Not modified.
+ * y: view of the sinogram. Not modified.
+ * wght: view of the sinogram weights. Not modified. A broadcast scalar (all strides 0) gives constant weights, which are not stored.
+ *      Otherwise they are stored as reconParams.weightType, see struct Sino.
+ * proxmap_input: view of the proximal map input image. data is NULL if imgParams->prox_mode is False.
  * sinoParams: struct to store sinogram params. See MBIRModularUtilities3D.h for struct definition.
  * imgParams: struct to store recon image params. See MBIRModularUtilities3D.h for struct definition.
  * reconParams: struct to store reconstruction related hyperparams. See MBIRModularUtilities3D.h for struct definition.
+ *      The weights and the error sinogram are stored as reconParams.weightType and reconParams.errorSinoType.
  * Amatrix_fname: pointer to sysmatrix filename string.
  *
  * Return Variables: None.
  */
-void recon(float *x, float *y, float *wght, float *proxmap_input,
+void recon(struct FloatArray3DView x, struct FloatArray3DView x_init, struct FloatArray3DView y, struct FloatArray3DView wght,
+    struct FloatArray3DView proxmap_input,
     struct SinoParams sinoParams, struct ImageParams imgParams, struct ReconParams reconParams, 
     char *Amatrix_fname)
 {
-    struct Sino sino;
-    struct Image img;
-    struct SysMatrix A;
-    int i;
+    char binViews = 0;
 
-    /* Set img and sino params inside data structure */
-    copyImgParams(&imgParams, &img.params);
-    copySinoParams(&sinoParams, &sino.params);
+    /* A reconstruction at a single resolution */
+    multiresRecon(x, x_init, y, wght, proxmap_input, 1, &sinoParams, &imgParams, &reconParams, &binViews, &Amatrix_fname);
+}
 
-    /* Perform normalizations on parameters*/
-    computeSecondaryReconParams(&reconParams, &img.params);
-    
-    /* Read system matrix from disk */
-    readSysMatrix(Amatrix_fname, &sino.params, &img.params, &A);
-    
-    /* 'x' is reconstructed in place, so if proximal map is the same array, make a local copy */
-    if(proxmap_input == x)
+/*
+ * Multiresolution reconstruction, see MBIR3DConeMultires().
+ * 
+ * Input Variables:
+ * x, x_init, y, wght, proxmap_input: views as in recon(), at the finest resolution.
+ * numLevels: number of resolution levels.
+ * sinoParams, imgParams, reconParams: arrays of the params of each level, level 0 is the finest.
+ * binViews: binViews[l] is 1 if the views of level l-1 are binned in pairs for level l. binViews[0] is not used.
+ * Amatrix_fnames: sysmatrix filename of each level.
+ *
+ * Return Variables: None.
+ */
+void multiresRecon(struct FloatArray3DView x, struct FloatArray3DView x_init, struct FloatArray3DView y, struct FloatArray3DView wght,
+    struct FloatArray3DView proxmap_input,
+    int numLevels, struct SinoParams *sinoParams, struct ImageParams *imgParams, struct ReconParams *reconParams,
+    char *binViews, char **Amatrix_fnames)
+{
+    struct MultiresLevel *levels;
+    int l;
+
+    levels = (struct MultiresLevel *) mget_spc(numLevels, sizeof(struct MultiresLevel));
+    for (l = 0; l < numLevels; ++l)
     {
-        img.proxMapInput = (float *) mget_spc((size_t)img.params.N_x*img.params.N_y*img.params.N_z,sizeof(float));
-        for(i=0; i<(size_t)img.params.N_x*img.params.N_y*img.params.N_z; i++)
-            img.proxMapInput[i] = proxmap_input[i];
+        /* Set img and sino params inside data structure */
+        copyImgParams(&imgParams[l], &levels[l].img.params);
+        copySinoParams(&sinoParams[l], &levels[l].sino.params);
+
+        /* Perform normalizations on parameters*/
+        levels[l].reconParams = reconParams[l];
+        computeSecondaryReconParams(&levels[l].reconParams, &levels[l].img.params);
+
+        levels[l].binViews = binViews[l];
+        levels[l].Amatrix_fname = Amatrix_fnames[l];
     }
-    else
-        img.proxMapInput = proxmap_input;
-    
-    img.vox = x;
-    sino.vox = y;
-    sino.wgt = wght;
-    /* Allocate error sinogram */
-    sino.e = (float*)allocateSinoData3DCone(&sino.params, sizeof(float));
-    
 
-    /* Allocate other image data */
-    img.lastChange = (float***) multialloc(sizeof(float), 3, img.params.N_x, img.params.N_y, reconParams.numZiplines);
-    img.timeToChange = (unsigned char***) multialloc(sizeof(unsigned char), 3, img.params.N_x, img.params.N_y, reconParams.numZiplines);
+    MBIR3DConeMultires(&x, &x_init, &y, &wght, &proxmap_input, levels, numLevels);
 
-    applyMask(img.vox, img.params.N_x, img.params.N_y, img.params.N_z);
+    free((void*)levels);
+}
 
-     /* Initialize error sinogram e = y - Ax */
-    forwardProject3DCone( sino.e, img.vox, &img.params, &A, &sino.params); /* e = Ax */
-    floatArray_z_equals_aX_plus_bY(&sino.e[0], 1.0, &sino.vox[0], -1.0, &sino.e[0], sino.params.N_beta*sino.params.N_dv*sino.params.N_dw); /* e = 1.0 * y + (-1.0) * e */
+/* Views in the arguments are as in recon(): caller owned arrays, indexed as the C arrays */
+void forwardProject(struct FloatArray3DView y, struct FloatArray3DView x, 
+    struct SinoParams sinoParams, struct ImageParams imgParams, 
+    char *Amatrix_fname)
+{
+    
+    struct SysMatrix A;
+    float *x_c, *y_c;
 
-    /* Initialize other image data */
-    setFloatArray2Value(&img.lastChange[0][0][0], img.params.N_x*img.params.N_y*reconParams.numZiplines, 0.0);
-    setUCharArray2Value(&img.timeToChange[0][0][0], img.params.N_x*img.params.N_y*reconParams.numZiplines, 0);
+    /* Read system matrix from disk */
+    readSysMatrix(Amatrix_fname, &sinoParams, &imgParams, &A);
+
+    x_c = (float *) mget_spc((size_t)imgParams.N_x*imgParams.N_y*imgParams.N_z, sizeof(float));
+    y_c = (float *) allocateSinoData3DCone(&sinoParams, sizeof(float));
+    floatArray3DView_z_equals_aX_plus_bY(x_c, 1.0, &x, 0, NULL, imgParams.N_x, imgParams.N_y, imgParams.N_z);
+    forwardProject3DCone(y_c, x_c, &imgParams, &A, &sinoParams);
+    floatArray3DView_copyFrom(&y, y_c, sinoParams.N_beta, sinoParams.N_dv, sinoParams.N_dw);
 
-    /* 
-    Reconstruct 
-    */
-    MBIR3DCone(&img, &sino, &reconParams, &A);
     freeSysMatrix(&A);
-    
-    /* Free 2D pointer array for 3D data */
+    free((void*)x_c);
+    free((void*)y_c);
+
     // printf("Done free_2D\n");
 
-    /* Free allocated data */
-    multifree((void***)img.lastChange, 3);
-    multifree((void***)img.timeToChange, 3);
-    free((void*)sino.e);
-    // printf("Done mem_free_3D\n");
+}
+
+void backProject(struct FloatArray3DView x, struct FloatArray3DView y, 
+    struct SinoParams sinoParams, struct ImageParams imgParams, 
+    char *Amatrix_fname, char mode)
+{
+    
+    struct SysMatrix A;
+    float *x_c, *y_c;
+
+    /* Read system matrix from disk */
+    readSysMatrix(Amatrix_fname, &sinoParams, &imgParams, &A);
+
+    x_c = (float *) mget_spc((size_t)imgParams.N_x*imgParams.N_y*imgParams.N_z, sizeof(float));
+    y_c = (float *) allocateSinoData3DCone(&sinoParams, sizeof(float));
+    floatArray3DView_z_equals_aX_plus_bY(y_c, 1.0, &y, 0, NULL, sinoParams.N_beta, sinoParams.N_dv, sinoParams.N_dw);
+    backProjectlike3DCone(x_c, y_c, &imgParams, &A, &sinoParams, mode);
+    floatArray3DView_copyFrom(&x, x_c, imgParams.N_x, imgParams.N_y, imgParams.N_z);
 
+    freeSysMatrix(&A);
+    free((void*)x_c);
+    free((void*)y_c);
 }
 
-void forwardProject(float *y, float *x, 
+void fdkRecon(struct FloatArray3DView x, struct FloatArray3DView y, 
     struct SinoParams sinoParams, struct ImageParams imgParams, 
     char *Amatrix_fname)
 {
     
     struct SysMatrix A;
+    float *x_c, *y_c;
 
     /* Read system matrix from disk */
     readSysMatrix(Amatrix_fname, &sinoParams, &imgParams, &A);
-    forwardProject3DCone(y, x, &imgParams, &A, &sinoParams);
+
+    x_c = (float *) mget_spc((size_t)imgParams.N_x*imgParams.N_y*imgParams.N_z, sizeof(float));
+    y_c = (float *) allocateSinoData3DCone(&sinoParams, sizeof(float));
+    floatArray3DView_z_equals_aX_plus_bY(y_c, 1.0, &y, 0, NULL, sinoParams.N_beta, sinoParams.N_dv, sinoParams.N_dw);
+    fdk3DCone(x_c, y_c, &imgParams, &A, &sinoParams);
+    floatArray3DView_copyFrom(&x, x_c, imgParams.N_x, imgParams.N_y, imgParams.N_z);
 
     freeSysMatrix(&A);
+    free((void*)x_c);
+    free((void*)y_c);
+}
 
-    // printf("Done free_2D\n");
+/*
+ * Resizes the image in[N_0_in][N_1_in][N_2_in] to out[N_0_out][N_1_out][N_2_out].
+ * Images that shrink along every axis are box averaged, see resizeImageBox(), and other images are
+ * resized by trilinear interpolation, see resizeImageTrilinear(). Both treat the three axes alike,
+ * so the views can index the axes in any order.
+ *
+ * Input Variables:
+ * out: view of the resized image.
+ * in: view of the image to resize. Not modified.
+ * N_0_out, N_1_out, N_2_out, N_0_in, N_1_in, N_2_in: sizes of the images along the axes of the views.
+ */
+void resizeImage(struct FloatArray3DView out, struct FloatArray3DView in,
+    long int N_0_out, long int N_1_out, long int N_2_out, long int N_0_in, long int N_1_in, long int N_2_in)
+{
+    if (N_0_out <= N_0_in && N_1_out <= N_1_in && N_2_out <= N_2_in)
+        resizeImageBox(&out, N_0_out, N_1_out, N_2_out, &in, N_0_in, N_1_in, N_2_in);
+    else
+        resizeImageTrilinear(&out, N_0_out, N_1_out, N_2_out, &in, N_0_in, N_1_in, N_2_in);
+}
+
+/*
+ * Creates a context for repeated reconstructions with the same geometry, sinogram and weights.
+ * The sysmatrix is read once and the error sinogram is kept between calls to reconWithContext().
+ * 
+ * Input Variables:
+ * y: view of the sinogram, as in recon(). Must stay valid until destroyReconContext() is called. Not modified.
+ * wght: view of the sinogram weights, as in recon(). Copied into the context as reconParams.weightType, unless it is a broadcast scalar. Not modified.
+ * sinoParams, imgParams, reconParams: as in recon().
+ * Amatrix_fname: pointer to sysmatrix filename string.
+ *
+ * Return Variables: pointer to the new context. Release it with destroyReconContext().
+ */
+struct ReconContext *createReconContext(struct FloatArray3DView y, struct FloatArray3DView wght,
+    struct SinoParams sinoParams, struct ImageParams imgParams, struct ReconParams reconParams,
+    char *Amatrix_fname)
+{
+    struct ReconContext *ctx;
+    long int N_xyz;
+    float relError;
+
+    ctx = (struct ReconContext *) mget_spc(1, sizeof(struct ReconContext));
+
+    copyImgParams(&imgParams, &ctx->imgParams);
+    copySinoParams(&sinoParams, &ctx->sino.params);
+    ctx->reconParams = reconParams;
+    computeSecondaryReconParams(&ctx->reconParams, &ctx->imgParams);
+    N_xyz = ctx->imgParams.N_x*ctx->imgParams.N_y*ctx->imgParams.N_z;
+
+    readSysMatrix(Amatrix_fname, &ctx->sino.params, &ctx->imgParams, &ctx->A);
+
+    ctx->sino.vox = y;
+    ctx->sino.wgt = NULL;
+    ctx->sino.wgtType = ctx->reconParams.weightType;
+    ctx->sino.wgtScale = NULL;
+    ctx->sino.wgtValue = 0;
+    if(FloatArray3DView_isConstant(&wght))
+        ctx->sino.wgtValue = *wght.data;
+    else
+    {
+        ctx->sino.wgt = allocateSinoData3DCone(&ctx->sino.params, coeffTypeSize(ctx->sino.wgtType));
+        if(ctx->sino.wgtType != COEFF_TYPE_FLOAT32)
+            ctx->sino.wgtScale = (float *) mget_spc(ctx->sino.params.N_beta, sizeof(float));
+        relError = setSinoWeights(&ctx->sino, &wght);
+        if(ctx->reconParams.isCheckSinoPrecision && ctx->sino.wgtType != COEFF_TYPE_FLOAT32)
+            printf("Relative error of the compact weights against float32: %e\n", relError);
+    }
+    ctx->sino.eType = ctx->reconParams.errorSinoType;
+    ctx->sino.e = allocateSinoData3DCone(&ctx->sino.params, coeffTypeSize(ctx->sino.eType));
+    ctx->x = (float *) mget_spc((size_t)N_xyz, sizeof(float));
+    ctx->proxMapInput = NULL;
+    if(ctx->reconParams.prox_mode)
+        ctx->proxMapInput = (float *) mget_spc((size_t)N_xyz, sizeof(float));
+    ctx->x_e = (float *) mget_spc((size_t)N_xyz, sizeof(float));
+    ctx->isErrorSinoValid = 0;
+
+    ctx->lastChange = (float***) multialloc(sizeof(float), 3, ctx->imgParams.N_x, ctx->imgParams.N_y, ctx->reconParams.numZiplines);
+    ctx->timeToChange = (unsigned char***) multialloc(sizeof(unsigned char), 3, ctx->imgParams.N_x, ctx->imgParams.N_y, ctx->reconParams.numZiplines);
+
+    /* A and W do not change, so theta2 cached by one call stays valid for the next */
+    ctx->theta2Cache = NULL;
+    if(ctx->reconParams.theta2CacheMode != 0)
+    {
+        ctx->theta2Cache = (float *) mget_spc((size_t)N_xyz, sizeof(float));
+        setFloatArray2Value(ctx->theta2Cache, N_xyz, -1);
+    }
+
+    return ctx;
+}
+
+/*
+ * Same as recon(), but uses the sysmatrix, sinogram, weights and reconstruction parameters stored in ctx.
+ * Instead of recomputing e = y - Ax, the error sinogram of the previous call is updated with A applied to
+ * the difference between x and the previous reconstruction. Voxels that did not change are skipped.
+ * 
+ * Input Variables:
+ * ctx: context from createReconContext().
+ * x, x_init, proxmap_input: views as in recon(). proxmap_input.data is only read when prox_mode is True.
+ *
+ * Return Variables: None.
+ */
+void reconWithContext(struct ReconContext *ctx, struct FloatArray3DView x, struct FloatArray3DView x_init, struct FloatArray3DView proxmap_input)
+{
+    struct Image img;
+    struct ReconParams reconParams;
+    long int j, N_xyz;
+
+    N_xyz = ctx->imgParams.N_x*ctx->imgParams.N_y*ctx->imgParams.N_z;
+    copyImgParams(&ctx->imgParams, &img.params);
+    reconParams = ctx->reconParams;
+
+    /* The buffers of ctx hold the C layout copies of the images */
+    floatArray3DView_z_equals_aX_plus_bY(ctx->x, 1.0, &x_init, 0, NULL, img.params.N_x, img.params.N_y, img.params.N_z);
+    img.proxMapInput = NULL;
+    if(ctx->proxMapInput != NULL && proxmap_input.data != NULL)
+    {
+        floatArray3DView_z_equals_aX_plus_bY(ctx->proxMapInput, 1.0, &proxmap_input, 0, NULL, img.params.N_x, img.params.N_y, img.params.N_z);
+        img.proxMapInput = ctx->proxMapInput;
+    }
+
+    img.vox = ctx->x;
+    img.lastChange = ctx->lastChange;
+    img.timeToChange = ctx->timeToChange;
+    img.theta2Cache = ctx->theta2Cache;
+
+    applyMask(img.vox, img.params.N_x, img.params.N_y, img.params.N_z);
+
+    if(ctx->isErrorSinoValid)
+    {
+        /* e = e - A(x - x_e), where x_e is the image e was last computed for */
+        for(j=0; j<N_xyz; j++)
+            ctx->x_e[j] = img.vox[j] - ctx->x_e[j];
+        subtractForwardProject3DCone(&ctx->sino, ctx->x_e, &img.params, &ctx->A);
+    }
+    else
+    {
+        /* Initialize error sinogram e = y - Ax */
+        computeErrorSino3DCone(&ctx->sino, img.vox, &img.params, &ctx->A);
+        ctx->isErrorSinoValid = 1;
+    }
+
+    setFloatArray2Value(&img.lastChange[0][0][0], img.params.N_x*img.params.N_y*reconParams.numZiplines, 0.0);
+    setUCharArray2Value(&img.timeToChange[0][0][0], img.params.N_x*img.params.N_y*reconParams.numZiplines, 0);
+
+    /* 
+    Reconstruct 
+    */
+    MBIR3DCone(&img, &ctx->sino, &reconParams, &ctx->A);
+
+    /* e now corresponds to the reconstructed image */
+    for(j=0; j<N_xyz; j++)
+        ctx->x_e[j] = img.vox[j];
+
+    floatArray3DView_copyFrom(&x, img.vox, img.params.N_x, img.params.N_y, img.params.N_z);
+}
+
+void destroyReconContext(struct ReconContext *ctx)
+{
+    if(ctx == NULL)
+        return;
 
+    freeSysMatrix(&ctx->A);
+    multifree((void***)ctx->lastChange, 3);
+    multifree((void***)ctx->timeToChange, 3);
+    if(ctx->sino.wgt != NULL)
+        free((void*)ctx->sino.wgt);
+    if(ctx->sino.wgtScale != NULL)
+        free((void*)ctx->sino.wgtScale);
+    free((void*)ctx->sino.e);
+    free((void*)ctx->x);
+    if(ctx->proxMapInput != NULL)
+        free((void*)ctx->proxMapInput);
+    free((void*)ctx->x_e);
+    if(ctx->theta2Cache != NULL)
+        free((void*)ctx->theta2Cache);
+    free((void*)ctx);
 }
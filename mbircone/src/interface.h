@@ -3,14 +3,62 @@
 
 void AmatrixComputeToFile(float *angles, 
     struct SinoParams sinoParams, struct ImageParams imgParams, 
+    char *Amatrix_fname, char isOnTheFly, int B_type, int C_type, char verbose);
+
+void AmatrixSubsetToFile(char *superset_fname, long int *viewIndex,
+    struct SinoParams supersetSinoParams, struct SinoParams sinoParams, struct ImageParams imgParams,
     char *Amatrix_fname, char verbose);
 
-void recon(float *x, float *y, float *wght, float *proxmap_input,
+void recon(struct FloatArray3DView x, struct FloatArray3DView x_init, struct FloatArray3DView y, struct FloatArray3DView wght,
+    struct FloatArray3DView proxmap_input,
     struct SinoParams sinoParams, struct ImageParams imgParams, struct ReconParams reconParams, 
     char *Amatrix_fname);
 
-void forwardProject(float *y, float *x, 
+void multiresRecon(struct FloatArray3DView x, struct FloatArray3DView x_init, struct FloatArray3DView y, struct FloatArray3DView wght,
+    struct FloatArray3DView proxmap_input,
+    int numLevels, struct SinoParams *sinoParams, struct ImageParams *imgParams, struct ReconParams *reconParams,
+    char *binViews, char **Amatrix_fnames);
+
+void forwardProject(struct FloatArray3DView y, struct FloatArray3DView x, 
+    struct SinoParams sinoParams, struct ImageParams imgParams, 
+    char *Amatrix_fname);
+
+void backProject(struct FloatArray3DView x, struct FloatArray3DView y, 
+    struct SinoParams sinoParams, struct ImageParams imgParams, 
+    char *Amatrix_fname, char mode);
+
+void fdkRecon(struct FloatArray3DView x, struct FloatArray3DView y, 
     struct SinoParams sinoParams, struct ImageParams imgParams, 
     char *Amatrix_fname);
 
+void resizeImage(struct FloatArray3DView out, struct FloatArray3DView in,
+    long int N_0_out, long int N_1_out, long int N_2_out, long int N_0_in, long int N_1_in, long int N_2_in);
+
+/*
+ * State kept between repeated reconstructions with the same geometry, sinogram and weights,
+ * e.g. the proximal map calls in MACE.
+ */
+struct ReconContext
+{
+    struct Sino sino;                   /* sino.vox is a view of the caller owned sinogram, sino.wgt a copy of the weights or NULL if constant */
+    struct ImageParams imgParams;
+    struct ReconParams reconParams;     /* after computeSecondaryReconParams() */
+    struct SysMatrix A;
+    float *x;                           /* [N_x][N_y][N_z] image being reconstructed */
+    float *proxMapInput;                /* [N_x][N_y][N_z] C layout copy of the proximal map input, NULL if not prox_mode */
+    float *x_e;                         /* image that sino.e = y - A x_e currently corresponds to */
+    float ***lastChange;
+    unsigned char ***timeToChange;
+    float *theta2Cache;                 /* kept across calls; NULL if theta2CacheMode is 0 */
+    char isErrorSinoValid;              /* 0 until sino.e has been computed once */
+};
+
+struct ReconContext *createReconContext(struct FloatArray3DView y, struct FloatArray3DView wght,
+    struct SinoParams sinoParams, struct ImageParams imgParams, struct ReconParams reconParams,
+    char *Amatrix_fname);
+
+void reconWithContext(struct ReconContext *ctx, struct FloatArray3DView x, struct FloatArray3DView x_init, struct FloatArray3DView proxmap_input);
+
+void destroyReconContext(struct ReconContext *ctx);
+
 #endif /* _CY_INTERFACE_H_ */
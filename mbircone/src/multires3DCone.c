@@ -0,0 +1,197 @@
+#include <stdio.h>
+#include <omp.h>
+#include "multires3DCone.h"
+#include "recon3DCone.h"
+#include "computeSysMatrix.h"
+#include "allocate.h"
+
+/**
+ *      Takes the arrays of all levels from arena. Called once with a counting arena to get the size.
+ *      Constant weights wght are not stored at any level that keeps them constant when binned.
+ */
+static void MultiresLevels_allocate(struct MultiresLevel *levels, int numLevels, struct FloatArray3DView *wght, struct Arena *arena)
+{
+    struct MultiresLevel *level;
+    long int N_xyz, N_sino, N_x, N_y, numZiplines;
+    float *lastChange;
+    unsigned char *timeToChange;
+    char isWeightConstant = 0;
+    int l;
+
+    for (l = 0; l < numLevels; ++l)
+    {
+        level = &levels[l];
+        N_x = level->img.params.N_x;
+        N_y = level->img.params.N_y;
+        numZiplines = level->reconParams.numZiplines;
+        N_xyz = N_x*N_y*level->img.params.N_z;
+        N_sino = level->sino.params.N_beta*level->sino.params.N_dv*level->sino.params.N_dw;
+
+        level->img.vox = (float *) Arena_get(arena, N_xyz, sizeof(float));
+        level->img.proxMapInput = level->reconParams.prox_mode ? (float *) Arena_get(arena, N_xyz, sizeof(float)) : NULL;
+        level->img.theta2Cache = NULL;
+        lastChange = (float *) Arena_get(arena, N_x*N_y*numZiplines, sizeof(float));
+        timeToChange = (unsigned char *) Arena_get(arena, N_x*N_y*numZiplines, sizeof(unsigned char));
+
+        /* The measured sinogram of level 0 belongs to the caller */
+        if (l > 0)
+            level->sino.vox = FloatArray3DView_contiguous((float *) Arena_get(arena, N_sino, sizeof(float)), level->sino.params.N_dv, level->sino.params.N_dw);
+
+        /* Binning sums 4 or 8 weights, except for an odd last view when views are binned */
+        if (l == 0)
+        {
+            isWeightConstant = FloatArray3DView_isConstant(wght);
+            level->sino.wgtValue = isWeightConstant ? *wght->data : 0;
+        }
+        else
+        {
+            isWeightConstant = isWeightConstant && (!level->binViews || levels[l-1].sino.params.N_beta % 2 == 0);
+            level->sino.wgtValue = isWeightConstant ? levels[l-1].sino.wgtValue * (level->binViews ? 8 : 4) : 0;
+        }
+        level->sino.wgtType = level->reconParams.weightType;
+        level->sino.wgt = isWeightConstant ? NULL : Arena_get(arena, N_sino, coeffTypeSize(level->sino.wgtType));
+        level->sino.wgtScale = NULL;
+        if (!isWeightConstant && level->sino.wgtType != COEFF_TYPE_FLOAT32)
+            level->sino.wgtScale = (float *) Arena_get(arena, level->sino.params.N_beta, sizeof(float));
+        level->sino.eType = level->reconParams.errorSinoType;
+        level->sino.e = Arena_get(arena, N_sino, coeffTypeSize(level->sino.eType));
+
+        if (arena->base != NULL)
+        {
+            level->img.lastChange = (float ***) multiwrap(lastChange, sizeof(float), 3, N_x, N_y, numZiplines);
+            level->img.timeToChange = (unsigned char ***) multiwrap(timeToChange, sizeof(unsigned char), 3, N_x, N_y, numZiplines);
+        }
+    }
+}
+
+void binSino2x(struct Sino *sino_lr, struct Sino *sino, char binViews)
+{
+    long int i_beta_lr, i_v_lr, i_w_lr, i_beta, i_beta_stop, i_v, i_w;
+    float wy, w, weight;
+    float *wgtView;
+
+    #pragma omp parallel private(i_v_lr, i_w_lr, i_beta, i_beta_stop, i_v, i_w, wy, w, weight, wgtView)
+    {
+        /* Binned weights of a view, stored in the type of sino_lr->wgt once the view is done */
+        wgtView = (float *) mget_spc(sino_lr->params.N_dv*sino_lr->params.N_dw, sizeof(float));
+
+        #pragma omp for
+        for (i_beta_lr = 0; i_beta_lr < sino_lr->params.N_beta; ++i_beta_lr)
+        {
+            i_beta_stop = binViews ? _MIN_(2*i_beta_lr+2, sino->params.N_beta) : i_beta_lr+1;
+
+            for (i_v_lr = 0; i_v_lr < sino_lr->params.N_dv; ++i_v_lr)
+            for (i_w_lr = 0; i_w_lr < sino_lr->params.N_dw; ++i_w_lr)
+            {
+                wy = w = 0;
+                for (i_beta = binViews ? 2*i_beta_lr : i_beta_lr; i_beta < i_beta_stop; ++i_beta)
+                for (i_v = 2*i_v_lr; i_v < 2*i_v_lr+2; ++i_v)
+                for (i_w = 2*i_w_lr; i_w < 2*i_w_lr+2; ++i_w)
+                {
+                    weight = sinoWeight(sino, i_beta, index_3D(i_beta, i_v, i_w, sino->params.N_dv, sino->params.N_dw));
+                    w += weight;
+                    wy += weight * *FloatArray3DView_at(&sino->vox, i_beta, i_v, i_w);
+                }
+
+                *FloatArray3DView_at(&sino_lr->vox, i_beta_lr, i_v_lr, i_w_lr) = (w > 0) ? wy / w : 0;
+                wgtView[i_v_lr*sino_lr->params.N_dw + i_w_lr] = w;
+            }
+
+            if (sino_lr->wgt != NULL)
+                setSinoViewWeights(sino_lr, i_beta_lr, wgtView);
+        }
+
+        free((void*)wgtView);
+    }
+}
+
+/* Trilinear resizing of the image arr of level src to the image arr of level dest */
+static void resizeLevelImage(float *arr_dest, struct MultiresLevel *dest, float *arr_src, struct MultiresLevel *src)
+{
+    struct FloatArray3DView in, out;
+
+    in = FloatArray3DView_contiguous(arr_src, src->img.params.N_y, src->img.params.N_z);
+    out = FloatArray3DView_contiguous(arr_dest, dest->img.params.N_y, dest->img.params.N_z);
+    resizeImageTrilinear(&out, dest->img.params.N_x, dest->img.params.N_y, dest->img.params.N_z, &in, src->img.params.N_x, src->img.params.N_y, src->img.params.N_z);
+}
+
+void MBIR3DConeMultires(struct FloatArray3DView *x, struct FloatArray3DView *x_init, struct FloatArray3DView *y, struct FloatArray3DView *wght,
+    struct FloatArray3DView *proxMapInput, struct MultiresLevel *levels, int numLevels)
+{
+    struct Arena arena = {NULL, 0, 0};
+    struct MultiresLevel *level;
+    struct SysMatrix A;
+    long int N_x, N_y, N_z;
+    float relError;
+    int l;
+
+    /* All arrays of all levels come from one allocation */
+    MultiresLevels_allocate(levels, numLevels, wght, &arena);
+    Arena_allocate(&arena, arena.used);
+    MultiresLevels_allocate(levels, numLevels, wght, &arena);
+
+    /* Sinogram and weights of each level, binned from the level before */
+    levels[0].sino.vox = *y;
+    if (levels[0].sino.wgt != NULL)
+    {
+        relError = setSinoWeights(&levels[0].sino, wght);
+        if (levels[0].reconParams.isCheckSinoPrecision && levels[0].sino.wgtType != COEFF_TYPE_FLOAT32)
+            printf("Relative error of the compact weights against float32: %e\n", relError);
+    }
+    for (l = 1; l < numLevels; ++l)
+        binSino2x(&levels[l].sino, &levels[l-1].sino, levels[l].binViews);
+
+    /**
+     *      Initial and proximal map input images of each level, resized from the level before.
+     *      The initial images of all but the coarsest level are replaced by the reconstruction of the level below.
+     */
+    N_x = levels[0].img.params.N_x;
+    N_y = levels[0].img.params.N_y;
+    N_z = levels[0].img.params.N_z;
+    floatArray3DView_z_equals_aX_plus_bY(levels[0].img.vox, 1.0, x_init, 0, NULL, N_x, N_y, N_z);
+    if (levels[0].img.proxMapInput != NULL)
+        floatArray3DView_z_equals_aX_plus_bY(levels[0].img.proxMapInput, 1.0, proxMapInput, 0, NULL, N_x, N_y, N_z);
+    for (l = 1; l < numLevels; ++l)
+    {
+        resizeLevelImage(levels[l].img.vox, &levels[l], levels[l-1].img.vox, &levels[l-1]);
+        if (levels[l].img.proxMapInput != NULL)
+            resizeLevelImage(levels[l].img.proxMapInput, &levels[l], levels[l-1].img.proxMapInput, &levels[l-1]);
+    }
+
+    for (l = numLevels-1; l >= 0; --l)
+    {
+        level = &levels[l];
+        N_x = level->img.params.N_x;
+        N_y = level->img.params.N_y;
+        N_z = level->img.params.N_z;
+
+        if (l < numLevels-1)
+            resizeLevelImage(level->img.vox, level, levels[l+1].img.vox, &levels[l+1]);
+
+        if (level->reconParams.verbosity >= 1 && numLevels > 1)
+            printf("Reconstructing at resolution level %d of %d, size (slices, rows, cols)=(%ld, %ld, %ld).\n", numLevels-l, numLevels, N_z, N_x, N_y);
+
+        /* Read system matrix from disk */
+        readSysMatrix(level->Amatrix_fname, &level->sino.params, &level->img.params, &A);
+
+        applyMask(level->img.vox, N_x, N_y, N_z);
+
+        /* Initialize error sinogram e = y - Ax */
+        computeErrorSino3DCone(&level->sino, level->img.vox, &level->img.params, &A);
+
+        setFloatArray2Value(&level->img.lastChange[0][0][0], N_x*N_y*level->reconParams.numZiplines, 0.0);
+        setUCharArray2Value(&level->img.timeToChange[0][0][0], N_x*N_y*level->reconParams.numZiplines, 0);
+
+        MBIR3DCone(&level->img, &level->sino, &level->reconParams, &A);
+        freeSysMatrix(&A);
+    }
+
+    floatArray3DView_copyFrom(x, levels[0].img.vox, levels[0].img.params.N_x, levels[0].img.params.N_y, levels[0].img.params.N_z);
+
+    for (l = 0; l < numLevels; ++l)
+    {
+        multifree((void *) levels[l].img.lastChange, 2);
+        multifree((void *) levels[l].img.timeToChange, 2);
+    }
+    Arena_free(&arena);
+}
@@ -0,0 +1,38 @@
+#ifndef MULTIRES_3D_CONE_H
+#define MULTIRES_3D_CONE_H
+
+#include "MBIRModularUtilities3D.h"
+
+/**
+ *      One resolution level of a multiresolution reconstruction. Level 0 is the finest, each following
+ *      level has half the image resolution of the level before it and a sinogram binned from its sinogram.
+ *      The sino and img params, reconParams, binViews and Amatrix_fname are set by the caller,
+ *      MBIR3DConeMultires() sets the arrays.
+ */
+struct MultiresLevel
+{
+    struct Sino sino;
+    struct Image img;
+    struct ReconParams reconParams;     /* after computeSecondaryReconParams() */
+    char binViews;                      /* the views of the level before are binned in pairs */
+    char *Amatrix_fname;
+};
+
+/**
+ *      Reconstructs at the coarsest level first, then at each finer level starting from the trilinear
+ *      interpolation of the level below. The sinograms and images of all levels are kept in one allocation.
+ *      The arguments are views as in recon(), at the resolution of level 0. proxMapInput->data is only read in prox_mode.
+ */
+void MBIR3DConeMultires(struct FloatArray3DView *x, struct FloatArray3DView *x_init, struct FloatArray3DView *y, struct FloatArray3DView *wght,
+    struct FloatArray3DView *proxMapInput, struct MultiresLevel *levels, int numLevels);
+
+/**
+ *      Bins sino by 2 along v and w, and in pairs of views if binViews, into sino_lr.
+ *      The view angles and parameters of sino_lr are those of _utils.bin_sinoparams_2x().
+ *      Each binned entry is the weighted mean of its entries and its weight is the sum of their weights.
+ *      An odd last v or w index is dropped and an odd last view is kept alone.
+ *      sino_lr->wgt is NULL if the binned weights are constant, and then only the sinogram is binned.
+ */
+void binSino2x(struct Sino *sino_lr, struct Sino *sino, char binViews);
+
+#endif /* MULTIRES_3D_CONE_H */
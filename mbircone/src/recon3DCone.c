@@ -2,6 +2,7 @@
 #include <math.h>
 #include <time.h>
 #include <omp.h>
+#include <sched.h>
 #include "recon3DCone.h"
 #include "allocate.h"
 
@@ -13,7 +14,7 @@ void MBIR3DCone(struct Image *img, struct Sino *sino, struct ReconParams *reconP
     long int j_xy, j_x, j_y, j_z;
     long int j_xyz;
     long int N_x, N_y, N_z;
-    long int N_beta, N_dv, N_dw;
+    long int N_dw;
     long int k_G, N_G;
     long int numZiplines;
     long int numVoxelsInMask;
@@ -31,9 +32,13 @@ void MBIR3DCone(struct Image *img, struct Sino *sino, struct ReconParams *reconP
     float ticToc_computeLastChangeThreshold;
 
     char stopFlag = 0;
+    char isTheta2CacheOwner = 0;
     struct ICDInfo3DCone *icdInfoArray;            /* Only used when using zip line option*/
     struct ICDInfo3DCone icdInfo;                /* Only used when not using zip line option*/
     struct ParallelAux parallelAux;
+    struct RandomZiplineAux columnZiplineAux;    /* Only used when using multi-column option*/
+    int threadID;
+    long int numColumnsReleased, numColumnsReleasedSeen;
 
     /* Hardcoded stuff */
     int subsampleFactor = 10;
@@ -56,8 +61,6 @@ void MBIR3DCone(struct Image *img, struct Sino *sino, struct ReconParams *reconP
     N_x = img->params.N_x;
     N_y = img->params.N_y;
     N_z = img->params.N_z;
-    N_beta = sino->params.N_beta;
-    N_dv = sino->params.N_dv;
     N_dw = sino->params.N_dw;
     numZiplines = reconParams->numZiplines;
 
@@ -81,9 +84,11 @@ void MBIR3DCone(struct Image *img, struct Sino *sino, struct ReconParams *reconP
 
 
 
-    srand(0);
+    /* Same seed for every call, so a reconstruction is reproducible */
+    RandomState_seed(&reconAux.rng, 0);
 
     numVoxelsInMask = computeNumVoxelsInImageMask(img);
+    computeMeasuredSinoNormsSquared(sino, &weightedNormSquared_y, &normSquared_y);
 
     if (reconParams->verbosity>0){
         printImgParams(&img->params);
@@ -108,7 +113,28 @@ void MBIR3DCone(struct Image *img, struct Sino *sino, struct ReconParams *reconP
      */
     /*printReconParams(reconParams);*/
     /*omp_set_num_threads(reconParams->numThreads);*/
-    prepareParallelAux(&parallelAux, reconAux.N_M_max);
+    prepareParallelAux(&parallelAux, reconAux.N_M_max, N_dw);
+    if (reconParams->zipLineMode == 4)
+        prepareParallelAuxColumns(&parallelAux, numZiplines, N_x, N_y);
+
+    /**
+     *         Runs of nonzero weight, so the ICD updates skip detector channels with zero weight
+     */
+    computeWeightRuns(sino);
+
+    /**
+     *         Theta2 cache
+     *         Holds A_{*,j}^t W A_{*,j} without weightScaler, so it stays valid when weightScaler_value changes.
+     *         A cache passed in img->theta2Cache (e.g. from a reconstruction context) is used and kept.
+     */
+    if (reconParams->theta2CacheMode != 0 && img->theta2Cache == NULL)
+    {
+        img->theta2Cache = (float *) mget_spc(N_x*N_y*N_z, sizeof(float));
+        setFloatArray2Value(img->theta2Cache, N_x*N_y*N_z, -1);
+        isTheta2CacheOwner = 1;
+    }
+    if (reconParams->theta2CacheMode == 2)
+        computeTheta2Cache(sino, img, A);
 
 
     /**
@@ -131,13 +157,16 @@ void MBIR3DCone(struct Image *img, struct Sino *sino, struct ReconParams *reconP
         switch(reconParams->zipLineMode)
         {
             case 0: /* off */
-            RandomAux_ShuffleOrderXYZ(&img->randomAux, &img->params);
+            RandomAux_ShuffleOrderXYZ(&img->randomAux, &img->params, &reconAux.rng);
             break;
             case 1: /* conventional zipline */
-            RandomZiplineAux_ShuffleGroupIndices_FixedDistance(&img->randomZiplineAux, &img->params);
+            RandomZiplineAux_ShuffleGroupIndices_FixedDistance(&img->randomZiplineAux, &img->params, &reconAux.rng);
             break;
             case 2: /* randomized zipline */
-            RandomZiplineAux_ShuffleGroupIndices(&img->randomZiplineAux, &img->params);
+            RandomZiplineAux_ShuffleGroupIndices(&img->randomZiplineAux, &img->params, &reconAux.rng);
+            break;
+            case 4: /* randomized zipline over several columns in parallel */
+            RandomZiplineAux_ShuffleGroupIndices(&img->randomZiplineAux, &img->params, &reconAux.rng);
             break;
             default:
             printf("Error: zipLineMode unknown\n");
@@ -164,7 +193,7 @@ void MBIR3DCone(struct Image *img, struct Sino *sino, struct ReconParams *reconP
                  *         ICD Zipline
                  */
                 /********************************************************************************************/
-                    RandomZiplineAux_shuffleOrderXY(&img->randomZiplineAux, &img->params);
+                    RandomZiplineAux_shuffleOrderXY(&img->randomZiplineAux, &img->params, &reconAux.rng);
 
                     for (j_xy = 0; j_xy < N_x*N_y; ++j_xy)
                     {
@@ -202,6 +231,80 @@ void MBIR3DCone(struct Image *img, struct Sino *sino, struct ReconParams *reconP
             }
 
 
+            if(reconParams->zipLineMode == 4)
+            {
+                /********************************************************************************************/
+                /**
+                 *         ICD Zipline over several columns in parallel
+                 *         Each thread claims the next free column of the random order and updates it. A column is free
+                 *         if no column within a distance of 2 is being updated, so no thread reads or writes the
+                 *         image neighborhood of another thread's column.
+                 *         The error sinogram is shared and updated with atomics, or under per-row locks if it is compact.
+                 */
+                /********************************************************************************************/
+                RandomZiplineAux_shuffleOrderXY(&img->randomZiplineAux, &img->params, &reconAux.rng);
+                resetIterationStatsColumns(&parallelAux, &reconAux);
+                resetColumnSchedule(&parallelAux, N_x, N_y);
+
+                #pragma omp parallel private(threadID, columnZiplineAux, j_xy, j_x, j_y, k_G, numColumnsReleased, numColumnsReleasedSeen)
+                {
+                    threadID = omp_get_thread_num();
+                    columnZiplineAux = img->randomZiplineAux;
+
+                    while (1)
+                    {
+                        #pragma omp critical (columnSchedule)
+                        {
+                            j_xy = claimColumn(&parallelAux, img->randomZiplineAux.orderXY, N_x, N_y);
+                            numColumnsReleasedSeen = parallelAux.numColumnsReleased;
+                        }
+                        if (j_xy == COLUMN_ALL_CLAIMED)
+                            break;
+                        if (j_xy == COLUMN_NONE_FREE)
+                        {
+                            /* Wait outside the critical section until another thread finishes a column */
+                            do
+                            {
+                                sched_yield();
+                                #pragma omp atomic read
+                                numColumnsReleased = parallelAux.numColumnsReleased;
+                            } while (numColumnsReleased == numColumnsReleasedSeen);
+                            continue;
+                        }
+
+                        indexExtraction2D(j_xy, &j_x, N_x, &j_y, N_y);
+                        NHICD_checkPartialZiplinesHot(&parallelAux.reconAux[threadID], j_x, j_y, reconParams, img);
+
+                        for (k_G = 0; k_G < N_G; ++k_G)
+                        {
+                            columnZiplineAux.k_G = k_G;
+                            prepareICDInfoRandGroup(j_x, j_y, &columnZiplineAux, parallelAux.icdInfo[threadID], img, reconParams, &parallelAux.reconAux[threadID]);
+
+                            ICDStep3DConeColumn(sino, img, A, parallelAux.icdInfo[threadID], reconParams, &columnZiplineAux, &parallelAux, threadID, &parallelAux.reconAux[threadID]);
+
+                            updateIterationStatsGroup(&parallelAux.reconAux[threadID], parallelAux.icdInfo[threadID], &columnZiplineAux, img, reconParams);
+                        }
+                        updateNHICDStats(&parallelAux.reconAux[threadID], j_x, j_y, img, reconParams);
+
+                        #pragma omp critical (columnSchedule)
+                        {
+                            parallelAux.columnState[j_xy] = COLUMN_DONE;
+                            #pragma omp atomic
+                            parallelAux.numColumnsReleased++;
+                        }
+                    }
+                }
+
+                if (timer_hasPassed(&timer_icd_loop, OUTPUT_REFRESH_TIME))
+                {
+                    speedAuxICD_computeSpeed(&speedAuxICD);
+                }
+
+                reduceIterationStatsColumns(&parallelAux, &reconAux);
+                speedAuxICD_update(&speedAuxICD, reconAux.NumUpdatedVoxels);
+            }
+
+
             if(reconParams->zipLineMode == 0)
             {
                 /********************************************************************************************/
@@ -220,7 +323,7 @@ void MBIR3DCone(struct Image *img, struct Sino *sino, struct ReconParams *reconP
                      *         Prepare icdInfo
                      */
                     indexExtraction3D(img->randomAux.orderXYZ[j_xyz], &j_x, N_x, &j_y, N_y, &j_z, N_z);
-                    if (isInsideMask(j_x, j_y, N_x, N_y) && (!reconAux.NHICD_isPartialUpdateActive || NHICD_isVoxelHot(reconParams, img, j_x, j_y, j_z, reconAux.lastChangeThreshold)))
+                    if (isInsideMask(j_x, j_y, N_x, N_y) && (!reconAux.NHICD_isPartialUpdateActive || NHICD_isVoxelHot(reconParams, img, j_x, j_y, j_z, reconAux.lastChangeThreshold, &reconAux.rng)))
                     {
                         prepareICDInfo(j_x, j_y, j_z, &icdInfo, img, &reconAux, reconParams);
 
@@ -247,16 +350,18 @@ void MBIR3DCone(struct Image *img, struct Sino *sino, struct ReconParams *reconP
         /**
          *      Iteration Info
          */
-        weightedNormSquared_e = computeSinogramWeightedNormSquared(sino, sino->e);
-        weightedNormSquared_y = computeSinogramWeightedNormSquared(sino, sino->vox);
+        weightedNormSquared_e = computeErrorSinoWeightedNormSquared(sino);
         if (weightedNormSquared_y>0.0) 
             reconAux.relativeWeightedForwardError = sqrt(weightedNormSquared_e / weightedNormSquared_y);
         else
             reconAux.relativeWeightedForwardError = sqrt(weightedNormSquared_e);
 
-        normSquared_e = computeNormSquaredFloatArray(&sino->e[0], N_beta*N_dv*N_dw);
-        normSquared_y = computeNormSquaredFloatArray(&sino->vox[0], N_beta*N_dv*N_dw);
-        reconAux.relativeUnweightedForwardError = sqrt(normSquared_e / normSquared_y);
+        /* Both norms are over the entries with nonzero weight, since e is not updated elsewhere */
+        normSquared_e = computeErrorSinoLiveNormSquared(sino);
+        if (normSquared_y>0.0)
+            reconAux.relativeUnweightedForwardError = sqrt(normSquared_e / normSquared_y);
+        else
+            reconAux.relativeUnweightedForwardError = sqrt(normSquared_e);
 
 
         reconAux.NHICD_isPartialUpdateActive = NHICD_activatePartialUpdate(reconParams, reconAux.relativeWeightedForwardError);
@@ -334,6 +439,19 @@ void MBIR3DCone(struct Image *img, struct Sino *sino, struct ReconParams *reconP
     RandomAux_free(&img->randomAux);
 
     freeParallelAux(&parallelAux);
+    freeWeightRuns(sino);
+
+    if (isTheta2CacheOwner)
+    {
+        free((void*)img->theta2Cache);
+        img->theta2Cache = NULL;
+    }
+
+    /**
+     *         Accuracy check of a compact error sinogram against e = y - Ax in float32
+     */
+    if (reconParams->isCheckSinoPrecision && sino->eType != COEFF_TYPE_FLOAT32)
+        printf("Relative error of the compact error sinogram against float32: %e\n", computeErrorSinoRelativeError(sino, img->vox, &img->params, A));
 
 
 
@@ -0,0 +1,86 @@
+#include "simdKernels.h"
+
+
+SIMD_TARGET_CLONES
+void simd_rowAxpy(float *restrict y, const float *restrict x, float a, long int n)
+{
+    long int i;
+
+    #pragma omp simd
+    for (i = 0; i < n; ++i)
+        y[i] += a * x[i];
+}
+
+SIMD_TARGET_CLONES
+void simd_rowAccumulateEW(float *restrict ew, const float *restrict e, const float *restrict w, float B, long int n)
+{
+    long int i;
+
+    #pragma omp simd
+    for (i = 0; i < n; ++i)
+        ew[i] += B * e[i] * w[i];
+}
+
+SIMD_TARGET_CLONES
+void simd_rowAccumulateEW_WBB(float *restrict ew, float *restrict wBB, const float *restrict e, const float *restrict w, float B, long int n)
+{
+    long int i;
+    float BB = B * B;
+
+    #pragma omp simd
+    for (i = 0; i < n; ++i)
+    {
+        ew[i] += B * e[i] * w[i];
+        wBB[i] += BB * w[i];
+    }
+}
+
+SIMD_TARGET_CLONES
+void simd_rowDecodeUint8(float *restrict y, const uint8_t *restrict x, float a, long int n)
+{
+    long int i;
+
+    #pragma omp simd
+    for (i = 0; i < n; ++i)
+        y[i] = a * x[i];
+}
+
+SIMD_TARGET_CLONES
+void simd_rowDecodeHalf(float *restrict y, const uint16_t *restrict x, float a, long int n)
+{
+    long int i;
+
+    #pragma omp simd
+    for (i = 0; i < n; ++i)
+        y[i] = a * halfToFloat(x[i]);
+}
+
+SIMD_TARGET_CLONES
+void simd_rowDecodeBfloat16(float *restrict y, const uint16_t *restrict x, float a, long int n)
+{
+    long int i;
+
+    #pragma omp simd
+    for (i = 0; i < n; ++i)
+        y[i] = a * bfloat16ToFloat(x[i]);
+}
+
+SIMD_TARGET_CLONES
+void simd_rowEncodeHalf(uint16_t *restrict y, const float *restrict x, float a, long int n)
+{
+    long int i;
+
+    #pragma omp simd
+    for (i = 0; i < n; ++i)
+        y[i] = floatToHalf(a * x[i]);
+}
+
+SIMD_TARGET_CLONES
+void simd_rowEncodeBfloat16(uint16_t *restrict y, const float *restrict x, float a, long int n)
+{
+    long int i;
+
+    #pragma omp simd
+    for (i = 0; i < n; ++i)
+        y[i] = floatToBfloat16(a * x[i]);
+}
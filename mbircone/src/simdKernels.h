@@ -0,0 +1,110 @@
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+
+/**
+ *      Detector row kernels used by the projector and the zipline ICD updates.
+ *
+ *      In view i_beta, a voxel column (j_x,j_y) hits a few detector rows i_v with weights B_ij,
+ *      and all of these rows see the same w-profile, which only depends on j_u and the voxels of
+ *      the column. The callers build that profile once and hand contiguous row segments to the
+ *      kernels below. A single w-footprint is only 2-3 detector elements long, whereas a row
+ *      segment covers the whole column and is long enough to fill the vector registers.
+ *
+ *      With gcc on x86-64 Linux, AVX-512, AVX2 and default versions of each kernel are compiled
+ *      and the version for the CPU is selected at load time.
+ */
+#if defined(__GNUC__) && !defined(__clang__) && !defined(__INTEL_COMPILER) && defined(__x86_64__) && defined(__linux__)
+#define SIMD_TARGET_CLONES __attribute__((target_clones("avx512f","avx2","default")))
+#else
+#define SIMD_TARGET_CLONES
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ *      IEEE half precision (float16) and bfloat16 values stored as 16 bit integers, used for compact sinogram storage.
+ *      The conversions round to nearest even and use only integer operations and selects, so the row loops vectorize.
+ */
+static inline float halfToFloat(uint16_t h)
+{
+    uint32_t u;
+    float f;
+
+    /* Exponent and mantissa in place, then rescale the exponent bias; exact also for subnormals */
+    u = (uint32_t)(h & 0x7fff) << 13;
+    memcpy(&f, &u, sizeof(f));
+    f *= 0x1p112f;
+    memcpy(&u, &f, sizeof(u));
+    if ((h & 0x7c00) == 0x7c00)
+        u |= 0x7f800000;    /* Inf and NaN */
+    u |= (uint32_t)(h & 0x8000) << 16;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+static inline uint16_t floatToHalf(float f)
+{
+    uint32_t u, sign, o;
+    const uint32_t denormMagicBits = ((127 - 15) + (23 - 10) + 1) << 23;
+    float denormMagic, g;
+
+    memcpy(&u, &f, sizeof(u));
+    sign = u & 0x80000000u;
+    u ^= sign;
+
+    if (u >= (uint32_t)(127 + 16) << 23)
+        o = (u > 0x7f800000u) ? 0x7e00 : 0x7c00;    /* NaN, or Inf for overflow */
+    else if (u < (uint32_t)113 << 23)
+    {
+        /* Subnormal or zero half: the float addition does the rounding */
+        memcpy(&denormMagic, &denormMagicBits, sizeof(denormMagic));
+        memcpy(&g, &u, sizeof(g));
+        g += denormMagic;
+        memcpy(&o, &g, sizeof(o));
+        o -= denormMagicBits;
+    }
+    else
+        o = (u + ((uint32_t)(15 - 127) << 23) + 0xfff + ((u >> 13) & 1)) >> 13;
+
+    return (uint16_t)(o | (sign >> 16));
+}
+
+static inline float bfloat16ToFloat(uint16_t b)
+{
+    uint32_t u = (uint32_t) b << 16;
+    float f;
+
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+static inline uint16_t floatToBfloat16(float f)
+{
+    uint32_t u;
+
+    memcpy(&u, &f, sizeof(u));
+    if ((u & 0x7fffffff) > 0x7f800000)
+        return (uint16_t)((u >> 16) | 0x40);    /* quiet NaN */
+    return (uint16_t)((u + 0x7fff + ((u >> 16) & 1)) >> 16);
+}
+
+/* y[i] += a * x[i] */
+void simd_rowAxpy(float *y, const float *x, float a, long int n);
+
+/* ew[i] += B * e[i] * w[i] */
+void simd_rowAccumulateEW(float *ew, const float *e, const float *w, float B, long int n);
+
+/* ew[i] += B * e[i] * w[i] and wBB[i] += B * B * w[i] */
+void simd_rowAccumulateEW_WBB(float *ew, float *wBB, const float *e, const float *w, float B, long int n);
+
+/* y[i] = a * x[i], decoding compact sinogram rows */
+void simd_rowDecodeUint8(float *y, const uint8_t *x, float a, long int n);
+void simd_rowDecodeHalf(float *y, const uint16_t *x, float a, long int n);
+void simd_rowDecodeBfloat16(float *y, const uint16_t *x, float a, long int n);
+
+/* y[i] = a * x[i], encoding compact sinogram rows */
+void simd_rowEncodeHalf(uint16_t *y, const float *x, float a, long int n);
+void simd_rowEncodeBfloat16(uint16_t *y, const float *x, float a, long int n);
+
+#endif /* SIMD_KERNELS_H */
@@ -17,8 +17,10 @@ PACKAGE_DIR = "mbircone"
 
 SRC_FILES = [PACKAGE_DIR + '/src/allocate.c', PACKAGE_DIR + '/src/MBIRModularUtilities3D.c',
              PACKAGE_DIR + '/src/icd3d.c', PACKAGE_DIR + '/src/recon3DCone.c',
-             PACKAGE_DIR + '/src/computeSysMatrix.c',
-             PACKAGE_DIR + '/src/interface.c', PACKAGE_DIR + '/interface_cy_c.pyx']
+             PACKAGE_DIR + '/src/computeSysMatrix.c', PACKAGE_DIR + '/src/simdKernels.c',
+             PACKAGE_DIR + '/src/fdk3DCone.c', PACKAGE_DIR + '/src/multires3DCone.c',
+             PACKAGE_DIR + '/src/interface.c',
+             PACKAGE_DIR + '/interface_cy_c.pyx']
 
 
 compiler_str = os.environ.get('CC')